@@ -22,6 +22,7 @@ THE SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "mstsfile.h"
 #include "activity.h"
 
@@ -253,3 +254,81 @@ void Activity::saveConsist(MSTSFileNode* list)
 		w= t;
 	}
 }
+
+ActivityEventEngine activityEvents;
+
+ActivityEventEngine::ActivityEventEngine()
+{
+	cellSize= 512;
+}
+
+void ActivityEventEngine::clear()
+{
+	timeHeap= {};
+	grid.clear();
+	pending.clear();
+}
+
+//	adds an event, x and y are the route coordinates of location events
+//	events without a time are location events
+void ActivityEventEngine::add(Event* event, double x, double y)
+{
+	pending.insert(event);
+	if (event->time > 0) {
+		timeHeap.push(TimeEntry(event->time,event));
+		return;
+	}
+	double r= event->radius;
+	int64_t i0= (int64_t)floor((x-r)/cellSize);
+	int64_t i1= (int64_t)floor((x+r)/cellSize);
+	int64_t j0= (int64_t)floor((y-r)/cellSize);
+	int64_t j1= (int64_t)floor((y+r)/cellSize);
+	for (int64_t i=i0; i<=i1; i++)
+		for (int64_t j=j0; j<=j1; j++)
+			grid[cellKey(i,j)].push_back(LocationEntry{event,x,y});
+}
+
+//	finds the events that fire at time with the player at position
+//	position is NULL if there is no player train
+//	fired events are removed and returned in fired
+void ActivityEventEngine::update(double time, const double* position,
+  bool stopped, std::vector<Event*>& fired)
+{
+	while (timeHeap.size()>0 && timeHeap.top().first<time) {
+		Event* event= timeHeap.top().second;
+		timeHeap.pop();
+		if (pending.erase(event))
+			fired.push_back(event);
+	}
+	if (position == NULL)
+		return;
+	Grid::iterator i= grid.find(cellKey(
+	  (int64_t)floor(position[0]/cellSize),
+	  (int64_t)floor(position[1]/cellSize)));
+	if (i == grid.end())
+		return;
+	std::vector<LocationEntry>& entries= i->second;
+	for (int j=0; j<entries.size(); ) {
+		LocationEntry& entry= entries[j];
+		Event* event= entry.event;
+		bool remove= pending.find(event) == pending.end();
+		if (!remove) {
+			double dx= entry.x - position[0];
+			double dy= entry.y - position[1];
+			if (dx*dx+dy*dy<=event->radius*event->radius &&
+			  (!event->onStop || stopped)) {
+				pending.erase(event);
+				fired.push_back(event);
+				remove= true;
+			}
+		}
+		if (remove) {
+			entries[j]= entries.back();
+			entries.pop_back();
+		} else {
+			j++;
+		}
+	}
+	if (entries.size() == 0)
+		grid.erase(i);
+}
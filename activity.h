@@ -22,6 +22,13 @@ THE SOFTWARE.
 #ifndef ACTIVITY_H
 #define ACTIVITY_H
 
+#include <stdint.h>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "mstsfile.h"
 
 struct Wagon {
@@ -78,4 +85,34 @@ struct Activity {
 	void clear();
 };
 
+//	decides when activity events fire
+//	time events are kept in a heap ordered by trigger time and location
+//	events in a grid of cells covering their trigger circles, so each
+//	update only looks at the heap top and the cell the player is in
+class ActivityEventEngine {
+	typedef std::pair<int,Event*> TimeEntry;
+	std::priority_queue<TimeEntry,std::vector<TimeEntry>,
+	  std::greater<TimeEntry> > timeHeap;
+	struct LocationEntry {
+		Event* event;
+		double x;
+		double y;
+	};
+	typedef std::unordered_map<int64_t,std::vector<LocationEntry> > Grid;
+	Grid grid;
+	std::unordered_set<Event*> pending;
+	double cellSize;
+	int64_t cellKey(int64_t i, int64_t j) {
+		return (int64_t)(((uint64_t)i<<32) ^ (j&0xffffffff));
+	};
+ public:
+	ActivityEventEngine();
+	void clear();
+	void add(Event* event, double x, double y);
+	void update(double time, const double* position, bool stopped,
+	  std::vector<Event*>& fired);
+	int size() { return pending.size(); };
+};
+extern ActivityEventEngine activityEvents;
+
 #endif
@@ -30,6 +30,7 @@ using namespace std;
 #include <string>
 
 #include "airbrake.h"
+#include "snapshot.h"
 
 AirBrake::AirBrake(string brakeValve)
 {
@@ -97,6 +98,27 @@ void AirBrake::setPrevOpen(bool open)
 		pipes[i]->setPrevOpen(open);
 };
 
+//	saves or restores tank pressures and valve settings
+//	hose connections are restored with the train
+void AirBrake::snapshot(SnapshotFile& f)
+{
+	int n= tanks.size();
+	f.io(n);
+	if (n != tanks.size()) {
+		f.fail("air brake tank count");
+		return;
+	}
+	for (int i=0; i<n; i++)
+		f.io(tanks[i]->pressure);
+	for (int i=0; i<pipes.size(); i++) {
+		f.io(pipes[i]->airSpeed);
+		f.io(pipes[i]->airFlow);
+	}
+	f.io(valveState);
+	f.io(retainerControl);
+	f.io(cutOut);
+}
+
 void AirBrake::incRetainer()
 {
 	if (retainerControl < valve->retainerSettings.size()-1)
@@ -162,6 +184,21 @@ EngAirBrake::EngAirBrake(float maxEqRes, string brakeValve) :
 	}
 }
 
+void EngAirBrake::snapshot(SnapshotFile& f)
+{
+	AirBrake::snapshot(f);
+	f.io(autoControl);
+	f.io(indControl);
+	f.io(pumpOn);
+	f.io(engCutOut);
+	f.io(mainRes->pressure);
+	f.io(eqRes->pressure);
+	f.io(airFlow);
+	f.io(pumpOnThreshold);
+	f.io(pumpOffThreshold);
+	f.io(feedThreshold);
+}
+
 void EngAirBrake::setMaxEqResPressure(float maxEqRes)
 {
 	pumpOnThreshold= maxEqRes+20;
@@ -32,6 +32,7 @@ THE SOFTWARE.
 #include "brakevalve.h"
 
 class AirBrake;
+class SnapshotFile;
 
 //	air brake state information
 class AirBrake {
@@ -59,6 +60,7 @@ class AirBrake {
 	void setPrevOpen(bool v);
 	bool getNextOpen() { return nextOpen; };
 	bool getPrevOpen() { return prevOpen; };
+	int getNumTanks() { return tanks.size(); };
 	void setCutOut(bool v) { cutOut= v; };
 	bool getCutOut() { return cutOut; };
 	void setRetainer(int v) {
@@ -113,6 +115,7 @@ class AirBrake {
 //	virtual void applyDeltas();
 	virtual void updateAirSpeeds(float dt);
 	virtual void updatePressures(float dt);
+	virtual void snapshot(SnapshotFile& f);
 	static AirBrake* create(bool engine, float maxEqRes,
 	  std::string brakeValve);
 };
@@ -159,6 +162,7 @@ class EngAirBrake : public AirBrake {
 //	virtual void calcDeltas(float dt);
 //	virtual void applyDeltas();
 	virtual void updatePressures(float dt);
+	virtual void snapshot(SnapshotFile& f);
 };
 
 #endif
@@ -0,0 +1,683 @@
+//	benchmarks for core simulation and file loading code
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <vsg/all.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <zlib.h>
+
+using namespace std;
+
+#include "track.h"
+#include "train.h"
+#include "railcar.h"
+#include "airbrake.h"
+#include "mstsfile.h"
+#include "mstsbfile.h"
+#include "mstsace.h"
+#include "mstsshape.h"
+#include "mstsroute.h"
+#include "locoeng.h"
+#include "jobs.h"
+
+static double minTime= .5;
+static string filter;
+static string benchDir;
+static string textureDir;
+static int nFailed= 0;
+
+//	calls f repeatedly for at least minTime seconds and prints
+//	one JSON line with the average time per call
+template <class F> void runBench(const char* name, int size, F f)
+{
+	if (filter.size()>0 && strstr(name,filter.c_str())==NULL)
+		return;
+	f();
+	auto start= std::chrono::steady_clock::now();
+	int n= 0;
+	double t= 0;
+	do {
+		f();
+		n++;
+		t= std::chrono::duration<double>(
+		  std::chrono::steady_clock::now()-start).count();
+	} while (t < minTime);
+	printf("{\"bench\":\"%s\",\"size\":%d,\"iterations\":%d,"
+	  "\"usPerIter\":%.3f}\n",name,size,n,1e6*t/n);
+	fflush(stdout);
+}
+
+//	makes a straight mainline with nEdges edges of 100m and a gentle grade
+Track* makeMainline(int nEdges)
+{
+	Track* track= new Track;
+	Track::Vertex* prev= track->addVertex(Track::VT_SIMPLE,0,0,0);
+	for (int i=1; i<=nEdges; i++) {
+		Track::Vertex* v= track->addVertex(Track::VT_SIMPLE,
+		  100*i,2*sin(.01*i),.002*i);
+		track->addEdge(Track::ET_STRAIGHT,prev,i==1?0:1,v,0);
+		prev= v;
+	}
+	return track;
+}
+
+//	makes a switch ladder with nTracks yard tracks of 300m
+//	each switch diverges to one stub ended yard track
+Track* makeYard(int nTracks)
+{
+	Track* track= new Track;
+	Track::Vertex* prev= track->addVertex(Track::VT_SIMPLE,0,0,0);
+	int n= 0;
+	for (int i=0; i<nTracks; i++) {
+		Track::Vertex* sw= track->addVertex(Track::VT_SWITCH,
+		  20*(i+1),0,0);
+		track->addEdge(Track::ET_STRAIGHT,prev,n,sw,0);
+		Track::Vertex* end= track->addVertex(Track::VT_SIMPLE,
+		  20*(i+1)+300,5*(i+1),0);
+		track->addEdge(Track::ET_STRAIGHT,sw,2,end,0);
+		prev= sw;
+		n= 1;
+	}
+	Track::Vertex* end= track->addVertex(Track::VT_SIMPLE,
+	  20*(nTracks+1)+300,0,0);
+	track->addEdge(Track::ET_STRAIGHT,prev,n,end,0);
+	return track;
+}
+
+//	makes a train of nCars freight cars with air brakes on track
+//	the first car has the engineer's brake valve
+Train* makeTrain(Track* track, int nCars, vsg::Group* root)
+{
+	static RailCarDef* def= NULL;
+	if (def == NULL) {
+		def= new RailCarDef;
+		def->name= "benchcar";
+		def->axles= 2;
+		def->mass0= def->mass1= 30e3;
+		def->maxBForce= 30e3;
+		def->length= 15;
+		def->parts.push_back(RailCarPart(2,5,.45));
+		def->parts.push_back(RailCarPart(2,-5,.45));
+		def->parts.push_back(RailCarPart(-1,0,0));
+		for (auto& part: def->parts)
+			part.model= vsg::MatrixTransform::create();
+	}
+	Train* train= new Train;
+	for (int i=0; i<nCars; i++) {
+		RailCarInst* car= new RailCarInst(def,root,90);
+		if (i == 0) {
+			delete car->airBrake;
+			car->airBrake= AirBrake::create(true,90,"K");
+		}
+		car->setLoad(0);
+		car->prev= train->lastCar;
+		if (train->lastCar == NULL)
+			train->firstCar= car;
+		else
+			train->lastCar->next= car;
+		train->lastCar= car;
+	}
+	float len= nCars*def->length;
+	track->findLocation(len+100,0,0,&train->location);
+	train->location.edge->occupied++;
+	train->endLocation= train->location;
+	train->endLocation.move(-len,1,-1);
+	train->connectAirHoses();
+	if (train->engAirBrake != NULL)
+		train->engAirBrake->setEqResPressure(90);
+	float x= 0;
+	for (RailCarInst* car=train->firstCar; car!=NULL; car=car->next) {
+		car->setLocation(x-car->def->length/2,&train->location);
+		x-= car->def->length;
+		car->airBrake->setCylPressure(0);
+		car->airBrake->setAuxResPressure(90);
+		car->airBrake->setPipePressure(90);
+		car->airBrake->setEmergResPressure(90);
+	}
+	train->calcPerf();
+	return train;
+}
+
+//	makes a steam engine set up the way an MSTS eng file for a 2-8-2
+//	would set it up
+SteamEngine* makeSteamEngine()
+{
+	SteamEngine* e= new SteamEngine;
+	e->setNumCylinders(2);
+	e->setCylStroke(30);
+	e->setCylDiameter(26);
+	e->setWheelDiameter(63);
+	e->setBoilerVolume(300);
+	e->setMaxBoilerPressure(200);
+	e->setIdealFireMass(1500);
+	e->setAuxSteamUsage(500);
+	e->setSafetyUsage(20000);
+	e->setSafetyDrop(5);
+	e->setMaxBoilerOutput(45000);
+	e->setExhaustLimit(45000);
+	return e;
+}
+
+//	writes text as a little endian UTF-16 file in benchDir
+string writeUnicodeFile(const char* name, const string& text)
+{
+	string path= benchDir+"/"+name;
+	FILE* out= fopen(path.c_str(),"w");
+	fputc(0xff,out);
+	fputc(0xfe,out);
+	for (int i=0; i<text.size(); i++) {
+		fputc(text[i],out);
+		fputc(0,out);
+	}
+	fclose(out);
+	return path;
+}
+
+//	writes an MSTS unicode text file with nObjects world file entries
+string makeTextFile(const char* name, int nObjects)
+{
+	string text= "SIMISA@@@@@@@@@@JINX0w0t______\r\n\r\nTr_Worldfile (\r\n";
+	char buf[300];
+	for (int i=0; i<nObjects; i++) {
+		snprintf(buf,sizeof(buf),"\tStatic (\r\n\t\tUiD ( %d )\r\n"
+		  "\t\tFileName ( object%d.s )\r\n"
+		  "\t\tPosition ( %.3f %.3f %.3f )\r\n"
+		  "\t\tQDirection ( 0 %.5f 0 %.5f )\r\n"
+		  "\t\tVDbId ( 4294967294 )\r\n\t)\r\n",
+		  i,i%50,(i*37)%2048-1024.,.01*i,(i*91)%2048-1024.,
+		  sin(.1*i),cos(.1*i));
+		text+= buf;
+	}
+	text+= ")\r\n";
+	return writeUnicodeFile(name,text);
+}
+
+//	writes an MSTS unicode text shape file with one textured grid of
+//	n by n squares, the shape a simple model would have after export
+string makeShapeFile(const char* name, const char* image, int n)
+{
+	int np= (n+1)*(n+1);
+	int nt= 2*n*n;
+	string text= "SIMISA@@@@@@@@@@JINX0s1t______\r\n\r\nshape (\r\n"
+	  "\tshape_header ( 00000000 00000000 )\r\n"
+	  "\tvolumes ( 1 vol_sphere ( vector ( 0 0 0 ) 20 ) )\r\n"
+	  "\tshader_names ( 1 named_shader ( TexDiff ) )\r\n"
+	  "\ttexture_filter_names ( 1 named_filter_mode ( MipLinear ) )\r\n";
+	char buf[300];
+	snprintf(buf,sizeof(buf),"\tpoints ( %d\r\n",np);
+	text+= buf;
+	for (int i=0; i<=n; i++) {
+		for (int j=0; j<=n; j++) {
+			snprintf(buf,sizeof(buf),
+			  "\t\tpoint ( %.3f %.3f %.3f )\r\n",
+			  20.*i/n-10,sin(.3*i)*cos(.2*j),20.*j/n-10);
+			text+= buf;
+		}
+	}
+	snprintf(buf,sizeof(buf),"\t)\r\n\tuv_points ( %d\r\n",np);
+	text+= buf;
+	for (int i=0; i<=n; i++) {
+		for (int j=0; j<=n; j++) {
+			snprintf(buf,sizeof(buf),"\t\tuv_point ( %.4f %.4f )\r\n",
+			  (double)i/n,(double)j/n);
+			text+= buf;
+		}
+	}
+	text+= "\t)\r\n\tnormals ( 1 vector ( 0 1 0 ) )\r\n"
+	  "\tsort_vectors ( 0 )\r\n\tcolours ( 0 )\r\n"
+	  "\tmatrices ( 1 matrix MAIN ( 1 0 0 0 1 0 0 0 1 0 0 0 ) )\r\n";
+	snprintf(buf,sizeof(buf),"\timages ( 1 image ( %s ) )\r\n",image);
+	text+= buf;
+	text+= "\ttextures ( 1 texture ( 0 0 0 ff000000 ) )\r\n"
+	  "\tlight_materials ( 0 )\r\n"
+	  "\tlight_model_cfgs ( 1 light_model_cfg ( 00000000\r\n"
+	  "\t\tuv_ops ( 1 uv_op_copy ( 1 0 ) ) ) )\r\n"
+	  "\tvtx_states ( 1 vtx_state ( 00000000 0 -5 0 00000002 ) )\r\n"
+	  "\tprim_states ( 1 prim_state ( 00000000 0\r\n"
+	  "\t\ttex_idxs ( 1 0 ) 0 0 0 0 1 ) )\r\n"
+	  "\tlod_controls ( 1 lod_control (\r\n"
+	  "\tdistance_levels_header ( 0 )\r\n"
+	  "\tdistance_levels ( 1 distance_level (\r\n"
+	  "\tdistance_level_header ( dlevel_selection ( 2000 )"
+	  " hierarchy ( 1 -1 ) )\r\n"
+	  "\tsub_objects ( 1 sub_object (\r\n"
+	  "\tsub_object_header ( 00000400 -1 -1 000001d2 000001c4\r\n"
+	  "\t\tgeometry_info ( 0 0 0 0 0 0 geometry_nodes ( 0 )"
+	  " geometry_node_map ( 0 ) )\r\n"
+	  "\t\tsubobject_shaders ( 1 0 )"
+	  " subobject_light_cfgs ( 1 0 ) 0 )\r\n";
+	snprintf(buf,sizeof(buf),"\tvertices ( %d\r\n",np);
+	text+= buf;
+	for (int i=0; i<np; i++) {
+		snprintf(buf,sizeof(buf),"\t\tvertex ( 00000000 %d 0 ffffffff"
+		  " ff000000 vertex_uvs ( 1 %d ) )\r\n",i,i);
+		text+= buf;
+	}
+	snprintf(buf,sizeof(buf),"\t)\r\n"
+	  "\tvertex_sets ( 1 vertex_set ( 0 0 %d ) )\r\n"
+	  "\tprimitives ( 2 prim_state_idx ( 0 )\r\n"
+	  "\tindexed_trilist (\r\n\tvertex_idxs ( %d\r\n",np,3*nt);
+	text+= buf;
+	for (int i=0; i<n; i++) {
+		for (int j=0; j<n; j++) {
+			int v= i*(n+1)+j;
+			snprintf(buf,sizeof(buf),"\t\t%d %d %d %d %d %d\r\n",
+			  v,v+1,v+n+1,v+1,v+n+2,v+n+1);
+			text+= buf;
+		}
+	}
+	snprintf(buf,sizeof(buf),"\t)\r\n\tnormal_idxs ( %d\r\n",nt);
+	text+= buf;
+	for (int i=0; i<nt; i++)
+		text+= "\t\t0 3\r\n";
+	snprintf(buf,sizeof(buf),"\t)\r\n\tflags ( %d\r\n",nt);
+	text+= buf;
+	for (int i=0; i<nt; i++)
+		text+= "\t\t00000000\r\n";
+	text+= "\t) ) ) ) ) ) ) ) )\r\n)\r\n";
+	return writeUnicodeFile(name,text);
+}
+
+//	writes a compressed MSTS binary file containing nInts integers
+string makeBinaryFile(const char* name, int nInts)
+{
+	vector<int> data(nInts);
+	for (int i=0; i<nInts; i++)
+		data[i]= (i*2654435761u)>>(i%24);
+	uLongf size= compressBound(4*nInts);
+	vector<Bytef> cdata(size);
+	compress2(&cdata[0],&size,(const Bytef*)&data[0],4*nInts,6);
+	string path= benchDir+"/"+name;
+	FILE* out= fopen(path.c_str(),"w");
+	int len= 4*nInts;
+	fwrite("SIMISA@F",1,8,out);
+	fwrite(&len,4,1,out);
+	fwrite("@@@@",1,4,out);
+	fwrite(&cdata[0],1,size,out);
+	fclose(out);
+	return path;
+}
+
+//	writes an uncompressed ace file, with mipmaps unless mipmaps is false
+string makeACEFile(const char* name, int size, int colors,
+  bool mipmaps=true)
+{
+	string path= benchDir+"/"+name;
+	FILE* out= fopen(path.c_str(),"w");
+	fwrite("SIMISA@@@@@@@@@@",1,16,out);
+	int header[6]= { 1, mipmaps?01:0, size, size, 14, colors };
+	fwrite(header,4,6,out);
+	int dataStart= 168+16*colors+4;
+	while (ftell(out) < 168+16*colors)
+		fputc(0,out);
+	int offset= dataStart-16;
+	fwrite(&offset,4,1,out);
+	for (int w=size; w>=4 && (mipmaps||w==size); w/=2) {
+		int rsz= 3*w;
+		if (colors > 3)
+			rsz+= w<8 ? 1 : w/8;
+		if (colors > 4)
+			rsz+= w;
+		for (int j=0; j<w; j++)
+			for (int k=0; k<rsz; k++)
+				fputc((j*k+w)&0xff,out);
+	}
+	fclose(out);
+	return path;
+}
+
+//	makes a route with a 3x3 block of tiles with rolling terrain
+MSTSRoute* makeTerrainRoute()
+{
+	std::filesystem::create_directories(benchDir+"/ROUTES/bench");
+	MSTSRoute* route= new MSTSRoute(benchDir.c_str(),"bench");
+	route->centerTX= 0;
+	route->centerTZ= 0;
+	for (int tx=-1; tx<=1; tx++) {
+		for (int tz=-1; tz<=1; tz++) {
+			MSTSRoute::Tile* tile= new MSTSRoute::Tile(tx,tz);
+			tile->floor= 100;
+			tile->scale= .01;
+			tile->terrain= new MSTSRoute::Terrain;
+			for (int i=0; i<256; i++) {
+				for (int j=0; j<256; j++) {
+					double x= 2048*tx + 8*(j-128);
+					double z= 2048*tz + 8*(128-i);
+					tile->terrain->y[i][j]= (unsigned short)
+					  (5000+2000*sin(x/300)*cos(z/450));
+					tile->terrain->f[i][j]= 0;
+				}
+			}
+			memset(tile->patches,0,sizeof(tile->patches));
+			route->tileMap[route->tileID(tx,tz)]= tile;
+		}
+	}
+	return route;
+}
+
+int main(int argc, char** argv)
+{
+	vsg::CommandLine arguments(&argc,argv);
+	arguments.read("--time",minTime);
+	arguments.read("--filter",filter);
+	benchDir= std::filesystem::temp_directory_path().string()+
+	  "/vsgts-bench";
+	arguments.read("--dir",benchDir);
+	arguments.read("--textures",textureDir);
+	aceCompression= false;
+	int nJobThreads= 0;
+	arguments.read("--jobs",nJobThreads);
+	if (arguments.errors())
+		return arguments.writeErrorMessages(std::cerr);
+	jobSystem.start(nJobThreads);
+	std::filesystem::create_directories(benchDir);
+
+	for (int n: { 1000, 10000 }) {
+		Track* track= makeMainline(n);
+		Track::Location loc(track->vertexList.front());
+		runBench("findSPT.mainline",n,[&]() {
+			track->findSPT(loc);
+		});
+		int i= 0;
+		Track::Location loc2;
+		runBench("findLocation.mainline",n,[&]() {
+			i= (i+7919)%n;
+			track->findLocation(100*i+3,1,0,&loc2);
+		});
+		delete track;
+	}
+	for (int n: { 100, 1000, 5000 }) {
+		Track* track= makeYard(n);
+		Track::Location loc(track->vertexList.front());
+		runBench("findSPT.yard",n,[&]() {
+			track->findSPT(loc);
+		});
+		runBench("findSPT.yard.penalty",n,[&]() {
+			track->findSPT(loc,100,1000);
+		});
+		delete track;
+	}
+
+	auto root= vsg::Group::create();
+	for (int n: { 20, 100, 200 }) {
+		Track* track= makeMainline(1000);
+		Train* train= makeTrain(track,n,root);
+		for (RailCarInst* car=train->firstCar; car!=NULL; car=car->next)
+			car->speed= 10;
+		train->bControl= .3;
+		runBench("Train::move",n,[&]() {
+			train->move(1/60.);
+			if (train->speed < 1)
+				for (RailCarInst* car=train->firstCar;
+				  car!=NULL; car=car->next)
+					car->speed= 10;
+		});
+		runBench("calcCouplerForces",n,[&]() {
+			train->calcCouplerForces(1/60.);
+		});
+		runBench("airBrakeSubSteps",n,[&]() {
+			float dt= 1/60.;
+			int m= (int)(dt/.005)+1;
+			float dt1= dt/m;
+			for (int i=0; i<m; i++) {
+				for (RailCarInst* car=train->firstCar; car!=NULL;
+				  car=car->next)
+					car->airBrake->updateAirSpeeds(dt1);
+				for (RailCarInst* car=train->firstCar; car!=NULL;
+				  car=car->next)
+					car->airBrake->updatePressures(dt1);
+			}
+		});
+		delete train;
+		delete track;
+	}
+
+	{
+		//	compares the baked steam engine curves with exact
+		//	evaluation over their whole range
+		//	a baked value further than bake's error limit from the
+		//	exact value, or a batch value different from the single
+		//	lookup, is a failure
+		SteamEngine* engine= makeSteamEngine();
+		SteamEngine::CurveList curves;
+		engine->getCurves(curves);
+		int n= 10000;
+		vector<float> xs(n);
+		vector<float> ys(n);
+		for (auto& c: curves) {
+			Spline<float>& baked= *c.second;
+			if (baked.size() < 2)
+				continue;
+			Spline<float> exact= baked;
+			exact.unbake();
+			string name= string("Spline.error.")+c.first;
+			float x0= baked.getMinX();
+			float dx= (baked.getMaxX()-x0)/(n-1);
+			float maxError= 0;
+			float maxY= 0;
+			for (int i=0; i<n; i++)
+				xs[i]= x0+i*dx;
+			baked.evaluate(&xs[0],&ys[0],n);
+			int nBatchDiff= 0;
+			for (int i=0; i<n; i++) {
+				float y= exact(xs[i]);
+				float e= fabs(baked(xs[i])-y);
+				if (maxError < e)
+					maxError= e;
+				if (maxY < fabs(y))
+					maxY= fabs(y);
+				if (ys[i] != baked(xs[i]))
+					nBatchDiff++;
+			}
+			if (baked.isBaked() && maxError>baked.getBakeError()) {
+				fprintf(stderr,"%s: error %g above %g\n",
+				  name.c_str(),maxError,baked.getBakeError());
+				nFailed++;
+			}
+			if (nBatchDiff > 0) {
+				fprintf(stderr,"%s: %d batch values differ\n",
+				  name.c_str(),nBatchDiff);
+				nFailed++;
+			}
+			if (filter.size()==0 ||
+			  strstr(name.c_str(),filter.c_str())!=NULL) {
+				printf("{\"bench\":\"%s\",\"size\":%d,"
+				  "\"baked\":%s,\"maxError\":%g,"
+				  "\"maxRelError\":%g}\n",name.c_str(),n,
+				  baked.isBaked()?"true":"false",maxError,
+				  maxY>0?maxError/maxY:maxError);
+				fflush(stdout);
+			}
+			float sum= 0;
+			name= string("Spline.exact.")+c.first;
+			runBench(name.c_str(),n,[&]() {
+				for (int i=0; i<n; i++)
+					sum+= exact(xs[i]);
+			});
+			name= string("Spline.baked.")+c.first;
+			runBench(name.c_str(),n,[&]() {
+				for (int i=0; i<n; i++)
+					sum+= baked(xs[i]);
+			});
+			name= string("Spline.batch.")+c.first;
+			runBench(name.c_str(),n,[&]() {
+				baked.evaluate(&xs[0],&ys[0],n);
+				sum+= ys[n-1];
+			});
+			if (sum == 12345)
+				fprintf(stderr,"%f\n",sum);
+		}
+		delete engine;
+	}
+
+	for (int n: { 100, 2000 }) {
+		string path= makeTextFile("bench.w",n);
+		runBench("MSTSFile::readFile",n,[&]() {
+			MSTSFile file;
+			file.readFile(path.c_str());
+		});
+	}
+	{
+		makeACEFile("benchshape.ace",256,3);
+		for (int n: { 16, 128 }) {
+			string path= makeShapeFile("bench.s","benchshape.ace",n);
+			runBench("MSTSShape::readFile",2*n*n,[&]() {
+				MSTSShape shape;
+				shape.readFile(path.c_str());
+			});
+			MSTSShape shape;
+			shape.readFile(path.c_str());
+			runBench("MSTSShape::createModel",2*n*n,[&]() {
+				shape.createModel(1,10,false,true);
+			});
+		}
+	}
+	for (int n: { 10000, 1000000 }) {
+		string path= makeBinaryFile("bench.t",n);
+		runBench("MSTSBFile",n,[&]() {
+			MSTSBFile reader;
+			if (reader.open(path.c_str()))
+				return;
+			for (int i=0; i<n; i++)
+				reader.getInt();
+		});
+	}
+	for (int n: { 256, 1024 }) {
+		string path= makeACEFile("bench3.ace",n,3);
+		runBench("readMSTSACE.rgb",n,[&]() {
+			readMSTSACE(path.c_str());
+		});
+		path= makeACEFile("bench4.ace",n,4);
+		runBench("readMSTSACE.rgba",n,[&]() {
+			readMSTSACE(path.c_str());
+		});
+		path= makeACEFile("bench5.ace",n,5);
+		runBench("readMSTSACE.alpha",n,[&]() {
+			readMSTSACE(path.c_str());
+		});
+		path= makeACEFile("benchnm.ace",n,4,false);
+		runBench("readMSTSACE.nomip",n,[&]() {
+			readMSTSACE(path.c_str());
+		});
+	}
+	for (int colors=3; colors<=5; colors++) {
+		int w= 1024;
+		vector<uint8_t> row(5*w);
+		vector<uint8_t> pixels(4*w);
+		for (int i=0; i<row.size(); i++)
+			row[i]= i*31;
+		char name[40];
+		snprintf(name,sizeof(name),"decodeACERow.%d",colors);
+		runBench(name,w,[&]() {
+			for (int j=0; j<w; j++)
+				decodeACERow(&row[0],w,colors,&pixels[0]);
+		});
+	}
+	for (int n: { 256, 1024 }) {
+		runBench("makeACEMipmaps",n,[&]() {
+			int size= n*n*4;
+			int nMipmaps= 1;
+			uint8_t* data= (uint8_t*) malloc(size);
+			memset(data,128,size);
+			data= makeACEMipmaps(data,n,n,4,nMipmaps,size);
+			free(data);
+		});
+	}
+	{
+		MSTSRoute* route= makeTerrainRoute();
+		MSTSRoute::Tile* tile= route->findTile(0,0);
+		MSTSRoute::Tile* t12= route->findTile(0,-1);
+		MSTSRoute::Tile* t21= route->findTile(1,0);
+		MSTSRoute::Tile* t22= route->findTile(1,-1);
+		runBench("TerrainSampler",256,[&]() {
+			delete new MSTSRoute::TerrainSampler(route,tile);
+		});
+		float sum= 0;
+		runBench("terrainSamples.getAltitude",256,[&]() {
+			for (int i=0; i<=256; i++) {
+				for (int j=0; j<=256; j++) {
+					sum+= route->getAltitude(i,j,
+					  tile,t12,t21,t22);
+					sum+= route->getAltitude(i+1,j+1,
+					  tile,t12,t21,t22);
+					sum+= route->getAltitude(i,j+1,
+					  tile,t12,t21,t22);
+					sum+= route->getAltitude(i+1,j,
+					  tile,t12,t21,t22);
+					sum+= route->getNormal(i,j,
+					  tile,t12,t21,t22).z;
+				}
+			}
+		});
+		runBench("terrainSamples.sampler",256,[&]() {
+			MSTSRoute::TerrainSampler* sampler=
+			  new MSTSRoute::TerrainSampler(route,tile);
+			for (int i=0; i<=256; i++) {
+				for (int j=0; j<=256; j++) {
+					sum+= sampler->getAltitude(i,j);
+					sum+= sampler->getAltitude(i+1,j+1);
+					sum+= sampler->getAltitude(i,j+1);
+					sum+= sampler->getAltitude(i+1,j);
+					sum+= sampler->getNormal(i,j).z;
+				}
+			}
+			delete sampler;
+		});
+		runBench("makePatch.tile",256,[&]() {
+			MSTSRoute::TerrainSampler* sampler=
+			  new MSTSRoute::TerrainSampler(route,tile);
+			for (int i=0; i<16; i++)
+				for (int j=0; j<16; j++)
+					route->makePatch(&tile->patches[i*16+j],
+					  i*16,j*16,tile,t12,t21,t22,sampler);
+			delete sampler;
+		});
+		if (sum == 12345)
+			fprintf(stderr,"%f\n",sum);
+		delete route;
+	}
+	if (textureDir.size() > 0) {
+		vector<string> paths;
+		for (auto& entry:
+		  std::filesystem::directory_iterator(textureDir)) {
+			string ext= entry.path().extension().string();
+			if (ext==".ace" || ext==".ACE")
+				paths.push_back(entry.path().string());
+		}
+		runBench("readMSTSACE.route",paths.size(),[&]() {
+			for (auto& path: paths)
+				readMSTSACE(path.c_str());
+		});
+	}
+	if (nFailed > 0) {
+		fprintf(stderr,"%d checks failed\n",nFailed);
+		return 1;
+	}
+	return 0;
+}
@@ -32,6 +32,7 @@ THE SOFTWARE.
 #include "mstsroute.h"
 #include "train.h"
 #include "listener.h"
+#include "pick.h"
 
 vsg::LookAt* myLookAt= nullptr;
 
@@ -151,6 +152,7 @@ void CameraController::apply(vsg::KeyPressEvent& keyPress)
 		setPitch(-90);
 		keyPress.handled= true;
 	} else if (keyPress.keyBase=='1' && myRailCar && myRailCar->def->inside.size()>0) {
+		myRailCar->validatePose();
 		follow= myRailCar->model;
 		auto& inside= myRailCar->def->inside[0];
 		followOffset= inside.position;
@@ -204,30 +206,46 @@ void CameraController::apply(vsg::ButtonPressEvent& buttonPress)
 	if (buttonPress.handled || buttonPress.mask!=vsg::BUTTON_MASK_3)
 		return;
 	buttonPress.handled= true;
-	auto intersector= vsg::LineSegmentIntersector::create(*camera,buttonPress.x,buttonPress.y);
+	vsg::dvec3 start,end;
+	getPickSegment(*camera,buttonPress.x,buttonPress.y,start,end);
+	PickResult pick;
+	pickRailCar(start,end,pick);
+	pickTerrain(start,end,pick);
+	pickTrack(start,end,pick);
+	//	bridges, buildings and other models aren't in the height field
+	//	so the scene graph is also intersected, but only up to the
+	//	nearest hit found so far
+	vsg::dvec3 sceneEnd= end;
+	if (pick.distance < vsg::length(end-start))
+		sceneEnd= start + vsg::normalize(end-start)*pick.distance;
+	auto intersector= vsg::LineSegmentIntersector::create(start,sceneEnd);
 	scene->accept(*intersector);
-	if (intersector->intersections.empty())
-		return;
-	std::sort(intersector->intersections.begin(),intersector->intersections.end(),
-	  [](auto& lhs, auto& rhs) { return lhs->ratio < rhs->ratio; });
-	auto& intersection= intersector->intersections.front();
-	follow= nullptr;
-	selectedTrain= nullptr;
-	selectedRailCar= nullptr;
-	for (auto train: trainList) {
-		for (auto car= train->firstCar; car; car=car->next) {
-			for (auto& node: intersection->nodePath) {
-				auto mt= dynamic_cast<const vsg::MatrixTransform*>(node);
-				if (car->model == mt) {
-					follow= mt;
-					selectedTrain= train;
-					selectedRailCar= car;
-				}
+	if (!intersector->intersections.empty()) {
+		std::sort(intersector->intersections.begin(),intersector->intersections.end(),
+		  [](auto& lhs, auto& rhs) { return lhs->ratio < rhs->ratio; });
+		auto& intersection= intersector->intersections.front();
+		pick.position= intersection->worldIntersection;
+		pick.distance= vsg::length(pick.position-start);
+		pick.train= nullptr;
+		pick.car= nullptr;
+		for (auto& node: intersection->nodePath) {
+			auto mt= dynamic_cast<const vsg::MatrixTransform*>(node);
+			auto i= railCarModelMap.find(mt);
+			if (mt && i!=railCarModelMap.end()) {
+				pick.car= i->second;
+				pick.train= findTrain(pick.car);
 			}
 		}
 	}
+	if (pick.distance >= 1e30)
+		return;
+	follow= nullptr;
+	selectedTrain= pick.train;
+	selectedRailCar= pick.car;
+	if (pick.car)
+		follow= pick.car->model;
 	auto lookV= lookAt->eye - lookAt->center;
-	lookAt->center= intersection->worldIntersection + vsg::dvec3(0,0,1.6);
+	lookAt->center= pick.position + vsg::dvec3(0,0,1.6);
 	if (follow) {
 		vsg::dvec3 position;
 		vsg::dquat rotation;
@@ -254,6 +272,9 @@ void CameraController::apply(vsg::ScrollWheelEvent& scroll)
 void CameraController::apply(vsg::FrameEvent& frame)
 {
 	if (follow) {
+		auto i= railCarModelMap.find(follow.get());
+		if (i != railCarModelMap.end())
+			i->second->validatePose();
 		auto lookV= lookAt->eye - lookAt->center;
 		vsg::dvec3 position;
 		vsg::dquat rotation;
@@ -264,6 +285,14 @@ void CameraController::apply(vsg::FrameEvent& frame)
 		lookAt->eye= lookAt->center + lookV;
 		prevRotation= rotation;
 	}
+	poseView.eye= lookAt->eye;
+	poseView.dir= vsg::normalize(lookAt->center-lookAt->eye);
+	if (perspective) {
+		double t= tan(vsg::radians(.5*perspective->fieldOfViewY));
+		double d= t*sqrt(1+perspective->aspectRatio*perspective->aspectRatio);
+		poseView.halfAngle= atan(d);
+		poseView.valid= true;
+	}
 	updateListener();
 }
 
@@ -0,0 +1,290 @@
+//	persistent catalog of route, activity and consist files
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <filesystem>
+#include <chrono>
+
+#include "catalog.h"
+
+using namespace std;
+using namespace filesystem;
+
+RouteCatalog routeCatalog;
+
+//	file types kept in the catalog
+static const char* catalogExtensions[]= { ".tdb", ".act", ".con", NULL };
+
+//	directories that only hold models, textures and terrain and are
+//	not searched
+static const char* skipDirs[]= { "SHAPES", "TEXTURES", "TILES",
+  "LO_TILES", "TERRTEX", "WORLD", "SOUND", "ENVFILES", "TRAINSET", NULL };
+
+static bool hasExtension(const string& name, const char* ext)
+{
+	int n= strlen(ext);
+	return name.size()>n && strcasecmp(name.c_str()+name.size()-n,ext)==0;
+}
+
+static bool isCataloged(const string& name)
+{
+	for (int i=0; catalogExtensions[i]; i++)
+		if (hasExtension(name,catalogExtensions[i]))
+			return true;
+	return false;
+}
+
+static bool isSkipped(const string& name)
+{
+	for (int i=0; skipDirs[i]; i++)
+		if (strcasecmp(name.c_str(),skipDirs[i]) == 0)
+			return true;
+	return false;
+}
+
+//	gets a directory's modification time, returns false on error
+static bool modTime(const string& path, int64_t& mtime)
+{
+	std::error_code ec;
+	auto t= last_write_time(path,ec);
+	if (ec)
+		return false;
+	mtime= t.time_since_epoch().count();
+	return true;
+}
+
+RouteCatalog::RouteCatalog()
+{
+	stopping= false;
+	loaded= false;
+	updated= false;
+	const char* file= getenv("VSGTS_CATALOG");
+	const char* home= getenv("HOME");
+	if (file)
+		filename= file;
+	else if (home)
+		filename= string(home)+"/.cache/vsgts/catalog";
+}
+
+RouteCatalog::~RouteCatalog()
+{
+	stopping= true;
+	if (thread.joinable())
+		thread.join();
+}
+
+//	reads the catalog saved by an earlier run
+void RouteCatalog::load()
+{
+	loaded= true;
+	if (filename.size() == 0)
+		return;
+	FILE* in= fopen(filename.c_str(),"r");
+	if (!in)
+		return;
+	char line[4096];
+	if (!fgets(line,sizeof(line),in) || strcmp(line,"VTRC 1\n")!=0) {
+		fclose(in);
+		return;
+	}
+	Dir* dir= NULL;
+	while (fgets(line,sizeof(line),in)) {
+		int n= strlen(line);
+		if (n<3 || line[n-1]!='\n')
+			continue;
+		line[n-1]= '\0';
+		if (line[0] == 'D') {
+			char* p;
+			long long mtime= strtoll(line+2,&p,10);
+			if (*p != ' ')
+				continue;
+			dir= &dirs[p+1];
+			dir->mtime= mtime;
+		} else if (line[0]=='S' && dir) {
+			dir->subdirs.push_back(line+2);
+		} else if (line[0]=='F' && dir) {
+			dir->files.push_back(line+2);
+		}
+	}
+	fclose(in);
+//	fprintf(stderr,"catalog %d dirs\n",(int)dirs.size());
+}
+
+//	writes the catalog to a temporary file and renames it so a partly
+//	written catalog is never read
+void RouteCatalog::save(DirMap& dirs)
+{
+	if (filename.size() == 0)
+		return;
+	std::error_code ec;
+	create_directories(path(filename).parent_path(),ec);
+	string tmpPath= filename+".tmp";
+	FILE* out= fopen(tmpPath.c_str(),"w");
+	if (!out)
+		return;
+	fprintf(out,"VTRC 1\n");
+	for (DirMap::iterator i=dirs.begin(); i!=dirs.end(); ++i) {
+		Dir& dir= i->second;
+		fprintf(out,"D %lld %s\n",(long long)dir.mtime,i->first.c_str());
+		for (int j=0; j<dir.subdirs.size(); j++)
+			fprintf(out,"S %s\n",dir.subdirs[j].c_str());
+		for (int j=0; j<dir.files.size(); j++)
+			fprintf(out,"F %s\n",dir.files[j].c_str());
+	}
+	bool ok= ferror(out) == 0;
+	fclose(out);
+	if (ok)
+		rename(tmpPath.c_str(),filename.c_str());
+	else
+		remove(tmpPath.c_str());
+}
+
+//	adds directory path and its subdirectories to newDirs
+//	a directory with the same modification time as in oldDirs is not
+//	read again, its subdirectories are still checked because adding a
+//	file to them doesn't change the parent's time
+void RouteCatalog::scan(const string& dirPath, DirMap& oldDirs,
+  DirMap& newDirs, int& nRead)
+{
+	int64_t mtime;
+	if (!modTime(dirPath,mtime))
+		return;
+	Dir& dir= newDirs[dirPath];
+	DirMap::iterator i= oldDirs.find(dirPath);
+	if (i!=oldDirs.end() && i->second.mtime==mtime) {
+		dir= i->second;
+	} else {
+		dir.mtime= mtime;
+		std::error_code ec;
+		for (directory_iterator j(dirPath,ec), end; !ec && j!=end;
+		  j.increment(ec)) {
+			string name= j->path().filename().string();
+			if (j->is_directory(ec) && !j->is_symlink(ec)) {
+				if (!isSkipped(name))
+					dir.subdirs.push_back(name);
+			} else if (isCataloged(name)) {
+				dir.files.push_back(name);
+			}
+		}
+		nRead++;
+	}
+	vector<string> subdirs= dir.subdirs;
+	for (int j=0; j<subdirs.size() && !stopping; j++)
+		scan(dirPath+"/"+subdirs[j],oldDirs,newDirs,nRead);
+}
+
+//	brings the catalog up to date, runs in the background thread
+void RouteCatalog::refresh(vector<string> roots)
+{
+	auto startTime= std::chrono::steady_clock::now();
+	DirMap oldDirs;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		oldDirs= dirs;
+	}
+	DirMap newDirs;
+	int nRead= 0;
+	for (int i=0; i<roots.size() && !stopping; i++)
+		scan(roots[i],oldDirs,newDirs,nRead);
+	if (stopping)
+		return;
+	bool changed= nRead>0 || newDirs.size()!=oldDirs.size();
+	if (changed)
+		save(newDirs);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dirs.swap(newDirs);
+		if (changed)
+			updated= true;
+	}
+	double t= std::chrono::duration<double>(
+	  std::chrono::steady_clock::now()-startTime).count();
+	fprintf(stderr,"catalog refresh %d dirs %d read %.3fs\n",
+	  (int)dirs.size(),nRead,t);
+}
+
+//	loads the saved catalog and starts a background refresh
+void RouteCatalog::start(vector<string>& roots)
+{
+	if (thread.joinable())
+		thread.join();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!loaded)
+		load();
+	for (int i=0; i<roots.size(); i++)
+		while (roots[i].size()>1 && roots[i].back()=='/')
+			roots[i].pop_back();
+	this->roots= roots;
+	thread= std::thread(&RouteCatalog::refresh,this,roots);
+}
+
+//	returns true once after a refresh has changed the catalog
+bool RouteCatalog::takeUpdate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	bool result= updated;
+	updated= false;
+	return result;
+}
+
+//	adds the full path of every cataloged file with extension ext
+//	under the current roots to list
+void RouteCatalog::getFiles(const char* ext, vector<string>& list)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (DirMap::iterator i=dirs.begin(); i!=dirs.end(); ++i) {
+		bool inRoots= false;
+		for (int j=0; j<roots.size(); j++)
+			if (i->first.compare(0,roots[j].size(),roots[j]) == 0)
+				inRoots= true;
+		if (!inRoots)
+			continue;
+		Dir& dir= i->second;
+		for (int j=0; j<dir.files.size(); j++)
+			if (hasExtension(dir.files[j],ext))
+				list.push_back(i->first+"/"+dir.files[j]);
+	}
+}
+
+//	adds the names of the files in directory dirPath with extension ext
+//	to list
+//	returns false if the directory isn't cataloged or has changed
+bool RouteCatalog::getFiles(const string& dirPath, const char* ext,
+  vector<string>& list)
+{
+	int64_t mtime;
+	if (!modTime(dirPath,mtime))
+		return false;
+	std::lock_guard<std::mutex> lock(mutex);
+	DirMap::iterator i= dirs.find(dirPath);
+	if (i==dirs.end() || i->second.mtime!=mtime)
+		return false;
+	Dir& dir= i->second;
+	for (int j=0; j<dir.files.size(); j++)
+		if (hasExtension(dir.files[j],ext))
+			list.push_back(dir.files[j]);
+	return true;
+}
@@ -0,0 +1,71 @@
+//	persistent catalog of route, activity and consist files
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+//	keeps a list of the route, activity and consist files found under
+//	the MSTS directories
+//	the list is saved between runs with each directory's modification
+//	time and is refreshed by a background thread that only reads
+//	directories whose time has changed
+class RouteCatalog {
+	struct Dir {
+		int64_t mtime;
+		std::vector<std::string> subdirs;
+		std::vector<std::string> files;
+	};
+	typedef std::map<std::string,Dir> DirMap;
+	DirMap dirs;
+	std::vector<std::string> roots;
+	std::string filename;
+	std::mutex mutex;
+	std::thread thread;
+	std::atomic<bool> stopping;
+	bool loaded;
+	bool updated;
+	void scan(const std::string& path, DirMap& oldDirs, DirMap& newDirs,
+	  int& nRead);
+	void refresh(std::vector<std::string> roots);
+	void load();
+	void save(DirMap& dirs);
+ public:
+	RouteCatalog();
+	~RouteCatalog();
+	void start(std::vector<std::string>& roots);
+	bool takeUpdate();
+	void getFiles(const char* ext, std::vector<std::string>& list);
+	bool getFiles(const std::string& dir, const char* ext,
+	  std::vector<std::string>& list);
+};
+extern RouteCatalog routeCatalog;
+
+#endif
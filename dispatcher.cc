@@ -21,8 +21,14 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
+#include <math.h>
+#include <algorithm>
+
 #include "dispatcher.h"
 #include "timetable.h"
+#include "snapshot.h"
+
+extern double simTime;
 
 //	looks for passing sections in AI train paths and divides the track
 //	into blocks that can be reserved for AI trains
@@ -31,12 +37,7 @@ void Dispatcher::findBlocks()
 	track= trackMap.begin()->second;
 #if 1
 	int n= 0;
-	for (Track::VertexList::iterator i=track->vertexList.begin();
-	  i!=track->vertexList.end(); ++i) {
-		Track::Vertex* v= *i;
-		if (v->type != Track::VT_SWITCH)
-			continue;
-		Track::SwVertex* sw= (Track::SwVertex*)v;
+	for (auto sw: track->swVertexList) {
 		for (int j=0; j<3; j++) {
 			if (sw->ssEdges[j]->block < 0)
 				sw->ssEdges[j]->block= ++n;
@@ -124,6 +125,7 @@ void Dispatcher::findBlocks()
 	}
 #endif
 	blockReservations.resize(n+1);
+	blockIntervals.resize(n+1);
 #if 0
 	fprintf(stderr,"%d blocks\n",n);
 	for (TrainInfoMap::iterator i=trainInfoMap.begin();
@@ -210,8 +212,12 @@ MoveAuth Dispatcher::requestAuth(Train* train)
 	if ((blockReservations[block]!=0 &&
 	  blockReservations[block]!=ti->id) ||
 	  (endBlock!=block && blockReservations[endBlock]!=0 &&
-	  blockReservations[endBlock]!=ti->id))
-		return MoveAuth(0,60);
+	  blockReservations[endBlock]!=ti->id)) {
+		Route route(1,0);
+		route.add(endBlock,0);
+		route.add(block,0);
+		return MoveAuth(0,retryTime(ti->id,&route));
+	}
 	unreserve(&blocks);
 	blocks.clear();
 	blocks.add(endBlock);
@@ -268,6 +274,8 @@ MoveAuth Dispatcher::requestAuth(Train* train)
 	Track::Path::Node* pn= ti->findBlock(block);
 	fprintf(stderr,"find block %d %p\n",block,pn);
 	BlockList bl1;
+	Route route1(train->targetSpeed>1 ? train->targetSpeed : 10,
+	  train->getLength());
 	int hasInterlocking= 0;
 	while (pn != NULL) {
 		if (pn->sw)
@@ -280,12 +288,16 @@ MoveAuth Dispatcher::requestAuth(Train* train)
 			if (pn->nextSiding != NULL)
 				break;
 			bl1.add(pn->nextSSEdge->block);
+			route1.add(pn->nextSSEdge->block,
+			  pn->nextSSEdge->length);
 //			fprintf(stderr,"adding %d %d\n",
 //			  pn->nextSSEdge->block,
 //			  blockReservations[pn->nextSSEdge->block]);
 			pn= pn->next;
 		} else if (pn->nextSiding != NULL) {
 			bl1.add(pn->nextSidingSSEdge->block);
+			route1.add(pn->nextSidingSSEdge->block,
+			  pn->nextSidingSSEdge->length);
 			pn= pn->nextSiding;
 		} else {
 			break;
@@ -296,12 +308,16 @@ MoveAuth Dispatcher::requestAuth(Train* train)
 	if (pn == NULL) {
 		return MoveAuth(0,0);
 	}
-	if (!hasInterlocking && !canReserve(ti->id,&bl1,checkOtherTrains))
-		return MoveAuth(0,60);
+	//	the blocks past a passing point and the refusal checks only
+	//	depend on the path, so a refused request returns before the
+	//	shortest path search
+	//	a refused train waits for a window covering its whole route
+	//	through the passing point, not just the next block
 	PathAuth pathAuth;
-	track->findSPT(train->location,false,ti->path);
 	BlockList bl2;
 	BlockList bl3;
+	Route route2= route1;
+	Route route3= route1;
 	if (pn->type == Track::Path::SIDINGSTART) {
 		fprintf(stderr,"start siding %d %d\n",
 		  pn->nextSSEdge->block,pn->nextSidingSSEdge->block);
@@ -309,35 +325,56 @@ MoveAuth Dispatcher::requestAuth(Train* train)
 		bl3.add(pn->nextSidingSSEdge->block);
 		pathAuth.sidingNode= pn;
 		Track::Path::Node* p=pn->next;
+		route2.add(pn->nextSSEdge->block,pn->nextSSEdge->length);
 		for (; p!=NULL && p->type!=Track::Path::SIDINGEND; p=p->next) {
-			if (p->nextSSEdge != NULL)
+			if (p->nextSSEdge != NULL) {
 				bl2.add(p->nextSSEdge->block);
+				route2.add(p->nextSSEdge->block,
+				  p->nextSSEdge->length);
+			}
 			if (p->type == Track::Path::COUPLE)
 				checkOtherTrains= false;
 		}
 		pathAuth.endNode= p;
 		fprintf(stderr,"bl2 %d %d\n",
 		  bl2.size(),canReserve(ti->id,&bl2,checkOtherTrains));
+		route3.add(pn->nextSidingSSEdge->block,
+		  pn->nextSidingSSEdge->length);
 		for (Track::Path::Node* p=pn->nextSiding;
 		  p!=NULL && p->type!=Track::Path::SIDINGEND; p=p->nextSiding) {
-			if (p->nextSidingSSEdge != NULL)
+			if (p->nextSidingSSEdge != NULL) {
 				bl3.add(p->nextSidingSSEdge->block);
+				route3.add(p->nextSidingSSEdge->block,
+				  p->nextSidingSSEdge->length);
+			}
 			if (p->type == Track::Path::COUPLE)
 				checkOtherTrains= false;
 		}
 		fprintf(stderr,"bl3 %d %d\n",
 		  bl3.size(),canReserve(ti->id,&bl3,checkOtherTrains));
+	} else {
+		pathAuth.endNode= pn;
+	}
+	if (!hasInterlocking && !canReserve(ti->id,&bl1,checkOtherTrains)) {
+		if (pn->type != Track::Path::SIDINGSTART)
+			return MoveAuth(0,retryTime(ti->id,&route1));
+		return MoveAuth(0,std::min(retryTime(ti->id,&route2),
+		  retryTime(ti->id,&route3)));
+	}
+	if (pn->type == Track::Path::SIDINGSTART) {
 		bool canUseMain= canReserve(ti->id,&bl2,checkOtherTrains);
 		bool canUseSiding= canReserve(ti->id,&bl3,checkOtherTrains);
+		if (!canUseMain && !canUseSiding)
+			return MoveAuth(0,std::min(retryTime(ti->id,&route2),
+			  retryTime(ti->id,&route3)));
+		track->findSPT(train->location,false,ti->path);
 		if (canUseSiding && (pn->sw->dist>501 || !canUseMain))
 			bl2.clear();
-		else if (canUseMain)
-			bl3.clear();
 		else
-			return MoveAuth(0,60);
+			bl3.clear();
 		pathAuth.takeSiding= bl2.size()==0;
 	} else {
-		pathAuth.endNode= pn;
+		track->findSPT(train->location,false,ti->path);
 	}
 	blocks.add(bl1);
 	blocks.add(bl2);
@@ -441,6 +478,11 @@ MoveAuth Dispatcher::requestAuth(Train* train)
 		train->alignSwitches(pn->sw);
 		fprintf(stderr,"meet %f\n",auth.distance);
 	}
+	if (!hasInterlocking) {
+		float speed= train->targetSpeed>1 ? train->targetSpeed : 10;
+		planHold(ti->id,&blocks,simTime+auth.waitTime+
+		  (fabs(auth.distance)+train->getLength())/speed);
+	}
 	if (auth.nextNode == NULL) {
 		auth.waitTime= pathAuth.endNode->value;
 		track->alignSwitches(ti->firstNode,pathAuth.endNode,false);
@@ -549,13 +591,19 @@ void Dispatcher::release(Train* train)
 
 void Dispatcher::BlockList::add(int block)
 {
-	list.insert(block);
+	if (block<0 || contains(block))
+		return;
+	if ((block>>6) >= bits.size())
+		bits.resize((block>>6)+1,0);
+	bits[block>>6]|= (uint64_t)1<<(block&63);
+	list.push_back(block);
 }
 
-bool Dispatcher::BlockList::contains(int block)
+void Dispatcher::BlockList::clear()
 {
-	iterator i= list.find(block);
-	return i!=list.end();
+	for (iterator i=list.begin(); i!=list.end(); ++i)
+		bits[*i>>6]= 0;
+	list.clear();
 }
 
 //	tests to see if the blocks in list bl can be reserved for train id
@@ -583,10 +631,13 @@ bool Dispatcher::canReserve(int id, BlockList* bl, bool checkOtherTrains)
 }
 
 //	reserves the blocks in list bl for train id
+//	the hold time is open ended until planHold is called
 void Dispatcher::reserve(int id, BlockList* bl)
 {
-	for (BlockList::iterator i=bl->begin(); i!=bl->end(); ++i)
-		  blockReservations[*i]= id;
+	for (BlockList::iterator i=bl->begin(); i!=bl->end(); ++i) {
+		blockReservations[*i]= id;
+		setInterval(id,*i,simTime,1e30);
+	}
 }
 
 //	unreserves the blocks in list bl
@@ -595,6 +646,7 @@ void Dispatcher::unreserve(BlockList* bl)
 	for (BlockList::iterator i=bl->begin(); i!=bl->end(); ++i) {
 //		fprintf(stderr,"unreserve %d was %d\n",
 //		  *i,blockReservations[*i]);
+		clearInterval(blockReservations[*i],*i);
 		blockReservations[*i]= 0;
 	}
 }
@@ -603,7 +655,107 @@ void Dispatcher::unreserve(BlockList* bl)
 void Dispatcher::BlockList::add(Dispatcher::BlockList& other)
 {
 	for (BlockList::iterator i=other.list.begin(); i!=other.list.end(); ++i)
-		list.insert(*i);
+		add(*i);
+}
+
+//	records that train id expects to hold block from start until end
+//	intervals are kept sorted by start time
+void Dispatcher::setInterval(int id, int block, double start, double end)
+{
+	if (block >= blockIntervals.size())
+		return;
+	clearInterval(id,block);
+	IntervalList& il= blockIntervals[block];
+	IntervalList::iterator i= il.begin();
+	while (i!=il.end() && i->start<=start)
+		++i;
+	il.insert(i,BlockInterval(start,end,id));
+}
+
+void Dispatcher::clearInterval(int id, int block)
+{
+	if (id==0 || block>=blockIntervals.size())
+		return;
+	IntervalList& il= blockIntervals[block];
+	for (IntervalList::iterator i=il.begin(); i!=il.end(); ++i) {
+		if (i->id == id) {
+			il.erase(i);
+			return;
+		}
+	}
+}
+
+//	sets the expected release time for the blocks held by train id
+void Dispatcher::planHold(int id, BlockList* bl, double end)
+{
+	for (BlockList::iterator i=bl->begin(); i!=bl->end(); ++i) {
+		if (*i >= blockIntervals.size())
+			continue;
+		IntervalList& il= blockIntervals[*i];
+		for (IntervalList::iterator j=il.begin(); j!=il.end(); ++j)
+			if (j->id == id)
+				j->end= end;
+	}
+}
+
+//	adds block to the end of a route, estimating when the train will
+//	enter it from the distance covered so far
+//	consecutive edges in the same block extend the time it is held
+void Dispatcher::Route::add(int block, double length)
+{
+	double enter= dist/speed;
+	dist+= length;
+	double leave= (dist+trainLength)/speed;
+	if (blocks.size()>0 && blocks.back().block==block)
+		blocks.back().leave= leave;
+	else
+		blocks.push_back(RouteBlock(block,enter,leave));
+}
+
+//	returns the earliest time at or after start when train id could
+//	begin to move along route without any of its blocks overlapping
+//	another train's interval
+//	each conflict pushes the start time far enough that the train
+//	reaches that block after the conflicting interval ends, so the
+//	scan stops after a pass with no conflicts
+double Dispatcher::earliestWindow(int id, Route* route, double start)
+{
+	double t= start;
+	for (bool moved=true; moved && t<1e30; ) {
+		moved= false;
+		for (int i=0; i<route->blocks.size(); i++) {
+			RouteBlock& rb= route->blocks[i];
+			if (rb.block<0 || rb.block>=blockIntervals.size())
+				continue;
+			IntervalList& il= blockIntervals[rb.block];
+			for (IntervalList::iterator j=il.begin();
+			  j!=il.end(); ++j) {
+				if (j->id==id || j->end<=t+rb.enter)
+					continue;
+				if (j->start >= t+rb.leave)
+					break;
+				t= j->end-rb.enter;
+				moved= true;
+			}
+		}
+	}
+	return t;
+}
+
+//	returns how long a train should wait before asking to move along
+//	route again, based on when the current holders expect to leave
+//	never less than 60 seconds so that refused trains don't poll the
+//	dispatcher, and 60 seconds when a holder hasn't planned its release
+//	waits are capped at 300 seconds because holders can leave early
+int Dispatcher::retryTime(int id, Route* route)
+{
+	double t= earliestWindow(id,route,simTime);
+//	fprintf(stderr,"retry %d %f %f\n",id,simTime,t);
+	if (t<simTime+60 || t>1e20)
+		return 60;
+	if (t > simTime+300)
+		return 300;
+	return (int)ceil(t-simTime);
 }
 
 //	returns true if the train is on a block reserved for another train
@@ -619,3 +771,89 @@ bool Dispatcher::isOnReservedBlock(Train* train)
 	  ((blockReservations[block]!=0 && blockReservations[block]!=id) ||
 	  (blockReservations[endBlock]!=0 && blockReservations[endBlock]!=id));
 }
+
+//	saves or restores block reservations and each train's progress
+//	along its path
+//	paths are saved as the index of the timetable train that owns them
+void Dispatcher::snapshot(SnapshotFile& f)
+{
+	bool hasBlocks= track!=NULL;
+	f.io(hasBlocks);
+	if (!f.isWriting() && hasBlocks && track==NULL)
+		findBlocks();
+	if (!hasBlocks)
+		return;
+	int n= blockReservations.size();
+	f.io(n);
+	if (n != blockReservations.size()) {
+		f.fail("block count");
+		return;
+	}
+	for (int i=0; i<n; i++) {
+		f.io(blockReservations[i]);
+		int m= blockIntervals[i].size();
+		f.io(m);
+		if (!f.isWriting())
+			blockIntervals[i].clear();
+		for (int j=0; j<m && f.good(); j++) {
+			BlockInterval bi(0,0,0);
+			if (f.isWriting())
+				bi= blockIntervals[i][j];
+			f.io(bi.start);
+			f.io(bi.end);
+			f.io(bi.id);
+			if (!f.isWriting())
+				blockIntervals[i].push_back(bi);
+		}
+	}
+	n= 0;
+	for (TrainInfoMap::iterator i=trainInfoMap.begin();
+	  i!=trainInfoMap.end(); ++i)
+		if (i->first != NULL)
+			n++;
+	f.io(n);
+	TrainInfoMap::iterator ti= trainInfoMap.begin();
+	if (!f.isWriting())
+		trainInfoMap.clear();
+	for (int i=0; i<n && f.good(); i++) {
+		if (f.isWriting())
+			while (ti->first == NULL)
+				++ti;
+		Train* train= f.isWriting() ? ti->first : NULL;
+		int pathIndex= -1;
+		for (int j=0; f.isWriting() && timeTable!=NULL &&
+		  j<timeTable->getNumTrains(); j++)
+			if (timeTable->getTrain(j)->path == ti->second.path)
+				pathIndex= j;
+		f.io(train);
+		f.io(pathIndex);
+		if (!f.isWriting() && (timeTable==NULL || pathIndex<0 ||
+		  pathIndex>=timeTable->getNumTrains())) {
+			f.fail("dispatcher path");
+			return;
+		}
+		Track::Path* path= f.isWriting() ? ti->second.path :
+		  timeTable->getTrain(pathIndex)->path;
+		TrainInfo info(0,path);
+		if (f.isWriting())
+			info= ti->second;
+		f.io(info.id);
+		f.io(info.state);
+		f.io(info.nextSwitch);
+		f.io(path,info.firstNode);
+		f.io(path,info.stopNode);
+		int m= info.blocks.size();
+		f.io(m);
+		BlockList::iterator bi= info.blocks.begin();
+		for (int j=0; j<m && f.good(); j++) {
+			int b= f.isWriting() ? *bi++ : 0;
+			f.io(b);
+			if (!f.isWriting())
+				info.blocks.add(b);
+		}
+		if (f.isWriting())
+			++ti;
+		else if (train != NULL)
+			trainInfoMap.insert(std::make_pair(train,info));
+	}
+}
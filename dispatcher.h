@@ -23,11 +23,13 @@ THE SOFTWARE.
 #define DISPATHER_H
 
 #include <vector>
-#include <set>
+#include <stdint.h>
 
 #include "track.h"
 #include "train.h"
 
+class SnapshotFile;
+
 struct PathAuth {
 	Track::Path::Node *endNode;
 	Track::Path::Node *sidingNode;
@@ -63,19 +65,67 @@ struct MoveAuth {
 class Dispatcher {
 	enum { BETWEEN, HOLDMAIN, TAKESIDING };
 	std::vector<int> blockReservations;
+	//	set of block ids, kept as a bitset for membership tests and
+	//	a list for iteration
 	struct BlockList {
-		typedef std::set<int>::iterator iterator;
-		std::set<int> list;
+		typedef std::vector<int>::iterator iterator;
+		std::vector<int> list;
+		std::vector<uint64_t> bits;
 		int last;
 	 public:
 		void add(int block);
 		void add(BlockList& other);
 		int size() { return list.size(); };
-		void clear() { list.clear(); };
+		void clear();
 		iterator begin() { return list.begin(); };
 		iterator end() { return list.end(); };
-		bool contains(int block);
+		bool contains(int block) {
+			return block>=0 && (block>>6)<bits.size() &&
+			  (bits[block>>6]&((uint64_t)1<<(block&63)))!=0;
+		};
+	};
+	//	time during which a train expects to hold a block
+	struct BlockInterval {
+		double start;
+		double end;
+		int id;
+		BlockInterval(double s, double e, int n) {
+			start= s;
+			end= e;
+			id= n;
+		};
+	};
+	typedef std::vector<BlockInterval> IntervalList;
+	std::vector<IntervalList> blockIntervals;
+	void setInterval(int id, int block, double start, double end);
+	void clearInterval(int id, int block);
+	void planHold(int id, BlockList* bl, double end);
+	//	blocks a train expects to pass through in order, with the
+	//	times after it starts moving that it enters and clears each
+	struct RouteBlock {
+		int block;
+		double enter;
+		double leave;
+		RouteBlock(int b, double e, double l) {
+			block= b;
+			enter= e;
+			leave= l;
+		};
+	};
+	struct Route {
+		std::vector<RouteBlock> blocks;
+		double dist;
+		double speed;
+		double trainLength;
+		Route(double s, double len) {
+			dist= 0;
+			speed= s;
+			trainLength= len;
+		};
+		void add(int block, double length);
 	};
+	double earliestWindow(int id, Route* route, double start);
+	int retryTime(int id, Route* route);
 	bool canReserve(int id, BlockList* bl, bool checkOtherTrains);
 	void reserve(int id, BlockList* bl);
 	void unreserve(BlockList* bl);
@@ -110,6 +160,7 @@ class Dispatcher {
 	void release(Train* train);
 	PathAuth requestAuth(Train* train, Track::Path* path,
 	  Track::Path::Node* node);
+	void snapshot(SnapshotFile& f);
 };
 
 #endif
@@ -25,6 +25,7 @@ THE SOFTWARE.
 #define EVENTSIM_H
 
 #include <queue>
+#include <vector>
 
 namespace tt {
 
@@ -69,6 +70,16 @@ template<class T> class EventSim {
 	T getNextEventTime() {
 		return events.size()>0 ? events.top().event->time : 0;
 	}
+	//	copies the pending events in time order
+	void getEvents(std::vector<Event<T>*>& list) {
+		std::priority_queue<EventPointer<T> > copy= events;
+		for (; copy.size()>0; copy.pop())
+			list.push_back(copy.top().event);
+	}
+	void clearEvents() {
+		for (; events.size()>0; events.pop())
+			delete events.top().event;
+	}
 };
 
 }
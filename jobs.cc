@@ -0,0 +1,230 @@
+//	work stealing job system shared by loaders and the simulation
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "jobs.h"
+
+using namespace std;
+
+JobSystem jobSystem;
+
+//	index of the calling thread's queue, -1 if it isn't a worker
+static thread_local int workerIndex= -1;
+
+JobSystem::JobSystem()
+{
+	nQueued= 0;
+	stopping= false;
+}
+
+JobSystem::~JobSystem()
+{
+	stop();
+}
+
+//	starts nThreads workers, by default one less than the number of cores
+//	so the main thread keeps a core
+void JobSystem::start(int nThreads)
+{
+	if (threads.size() > 0)
+		return;
+	if (nThreads < 0)
+		nThreads= (int)std::thread::hardware_concurrency()-1;
+	if (nThreads <= 0)
+		return;
+	stopping= false;
+	for (int i=0; i<=nThreads; i++)
+		queues.push_back(new Queue);
+	for (int i=0; i<nThreads; i++)
+		threads.push_back(std::thread(&JobSystem::worker,this,i));
+}
+
+//	stops the workers after the queues are empty
+void JobSystem::stop()
+{
+	if (threads.size() == 0)
+		return;
+	{
+		scoped_lock lock {sleepMutex};
+		stopping= true;
+	}
+	wake.notify_all();
+	for (auto& t: threads)
+		t.join();
+	threads.clear();
+	Job job;
+	while (findJob(-1,job))
+		runJob(job);
+	for (auto q: queues)
+		delete q;
+	queues.clear();
+}
+
+//	adds a job to the calling thread's queue and wakes a worker
+void JobSystem::push(Job& job)
+{
+	int i= workerIndex>=0 ? workerIndex : queues.size()-1;
+	{
+		scoped_lock lock {queues[i]->mutex};
+		queues[i]->jobs[job.priority].push_back(std::move(job));
+	}
+	nQueued++;
+	{
+		scoped_lock lock {sleepMutex};
+	}
+	wake.notify_one();
+}
+
+//	takes the highest priority job available to queue index
+//	the newest job in the thread's own queue is preferred, otherwise
+//	the oldest job in another queue is stolen
+bool JobSystem::findJob(int index, Job& job)
+{
+	if (queues.size()==0 || nQueued.load()==0)
+		return false;
+	int own= index>=0 ? index : queues.size()-1;
+	for (int p=0; p<JOB_NPRIORITIES; p++) {
+		{
+			Queue* q= queues[own];
+			scoped_lock lock {q->mutex};
+			if (q->jobs[p].size() > 0) {
+				job= std::move(q->jobs[p].back());
+				q->jobs[p].pop_back();
+				nQueued--;
+				return true;
+			}
+		}
+		for (int i=1; i<queues.size(); i++) {
+			Queue* q= queues[(own+i)%queues.size()];
+			scoped_lock lock {q->mutex};
+			if (q->jobs[p].size() > 0) {
+				job= std::move(q->jobs[p].front());
+				q->jobs[p].pop_front();
+				nQueued--;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//	runs a job and releases the jobs held until its group finished
+void JobSystem::runJob(Job& job)
+{
+	job.func();
+	JobGroup* group= job.group;
+	vector<Job> ready;
+	{
+		scoped_lock lock {group->mutex};
+		if (--group->pending == 0)
+			ready.swap(group->held);
+	}
+	for (auto& j: ready) {
+		if (threads.size() == 0)
+			runJob(j);
+		else
+			push(j);
+	}
+}
+
+void JobSystem::worker(int index)
+{
+	workerIndex= index;
+	for (;;) {
+		Job job;
+		if (findJob(index,job)) {
+			runJob(job);
+			continue;
+		}
+		unique_lock<mutex> lock(sleepMutex);
+		if (stopping)
+			break;
+		wake.wait(lock,[this] { return nQueued>0 || stopping; });
+	}
+}
+
+//	adds a job to group
+void JobSystem::run(JobGroup& group, std::function<void()> func,
+  JobPriority priority)
+{
+	group.pending++;
+	Job job= { std::move(func), &group, priority };
+	if (threads.size() == 0)
+		runJob(job);
+	else
+		push(job);
+}
+
+//	adds a job to group that doesn't start until group after finishes
+//	jobs must be added to after before jobs that depend on it
+void JobSystem::runAfter(JobGroup& after, JobGroup& group,
+  std::function<void()> func, JobPriority priority)
+{
+	group.pending++;
+	Job job= { std::move(func), &group, priority };
+	{
+		scoped_lock lock {after.mutex};
+		if (after.pending > 0) {
+			after.held.push_back(std::move(job));
+			return;
+		}
+	}
+	if (threads.size() == 0)
+		runJob(job);
+	else
+		push(job);
+}
+
+//	runs queued jobs until all of group's jobs have finished
+void JobSystem::wait(JobGroup& group)
+{
+	while (group.pending > 0) {
+		Job job;
+		if (findJob(workerIndex,job))
+			runJob(job);
+		else
+			std::this_thread::yield();
+	}
+	//	the last job may still hold the group's lock
+	scoped_lock lock {group.mutex};
+}
+
+//	calls func for ranges of at most grain values covering begin to end
+//	and waits for them to finish
+void JobSystem::parallelFor(int begin, int end, int grain,
+  std::function<void(int,int)> func, JobPriority priority)
+{
+	if (grain < 1)
+		grain= 1;
+	if (threads.size()==0 || end-begin<=grain) {
+		if (begin < end)
+			func(begin,end);
+		return;
+	}
+	JobGroup group;
+	for (int i=begin; i<end; i+=grain) {
+		int e= i+grain<end ? i+grain : end;
+		run(group,[&func,i,e]() { func(i,e); },priority);
+	}
+	wait(group);
+}
@@ -0,0 +1,97 @@
+//	work stealing job system shared by loaders and the simulation
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//	queues are searched from high to low priority
+enum JobPriority { JOB_HIGH, JOB_NORMAL, JOB_LOW, JOB_NPRIORITIES };
+
+class JobGroup;
+
+struct Job {
+	std::function<void()> func;
+	JobGroup* group;
+	JobPriority priority;
+};
+
+//	counts a set of jobs that haven't finished
+//	jobs can be held until another group finishes, so groups can be
+//	chained into a task graph
+//	a group must outlive its jobs, usually by waiting for it
+class JobGroup {
+	friend class JobSystem;
+	std::atomic<int> pending;
+	std::mutex mutex;
+	std::vector<Job> held;
+ public:
+	JobGroup() { pending= 0; };
+	bool done() { return pending.load()==0; };
+};
+
+//	runs jobs on a fixed set of worker threads
+//	each worker has its own queues and takes its newest job first,
+//	idle workers steal the oldest jobs from other queues
+//	jobs from threads that aren't workers go in a shared queue
+//	with no workers every job runs immediately in the calling thread
+class JobSystem {
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs[JOB_NPRIORITIES];
+	};
+	std::vector<Queue*> queues;
+	std::vector<std::thread> threads;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> nQueued;
+	std::atomic<bool> stopping;
+	void push(Job& job);
+	bool findJob(int index, Job& job);
+	void runJob(Job& job);
+	void worker(int index);
+ public:
+	JobSystem();
+	~JobSystem();
+	void start(int nThreads= -1);
+	void stop();
+	int getNumThreads() { return threads.size(); };
+	void run(JobGroup& group, std::function<void()> func,
+	  JobPriority priority= JOB_NORMAL);
+	void runAfter(JobGroup& after, JobGroup& group,
+	  std::function<void()> func, JobPriority priority= JOB_NORMAL);
+	void wait(JobGroup& group);
+	void parallelFor(int begin, int end, int grain,
+	  std::function<void(int,int)> func,
+	  JobPriority priority= JOB_NORMAL);
+};
+extern JobSystem jobSystem;
+
+#endif
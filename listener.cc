@@ -28,6 +28,8 @@ THE SOFTWARE.
 #include "railcar.h"
 #include "listener.h"
 #include "morse.h"
+#include "profiler.h"
+#include "jobs.h"
 
 using namespace std;
 
@@ -67,9 +69,9 @@ struct ControlCurve {
 	}
 };
 
+//	one MSTS sound stream, shared by all cars that use the same sms file
 struct SoundControl {
 	Control control;
-	int currentSound;
 	vector<SoundTableEntry> soundTable;
 	ControlCurve* volCurve;
 	ControlCurve* freqCurve;
@@ -86,6 +88,37 @@ struct SoundControl {
 	};
 };
 
+//	compiled sms file, never modified after readSMS returns
+struct SMSDef {
+	vector<SoundControl*> streams;
+	~SMSDef() {
+		for (auto sc: streams)
+			delete sc;
+	};
+};
+
+//	decoded pcm data from a wav file, in the format openAL expects
+struct WavData {
+	vector<unsigned char> data;
+	int rate;
+	int bps;
+	bool stereo;
+	WavData() {
+		rate= 0;
+		bps= 8;
+		stereo= false;
+	};
+};
+
+//	a wav file being decoded by the job system
+struct PendingWav {
+	JobGroup group;
+	WavData* wav;
+	PendingWav() {
+		wav= NULL;
+	};
+};
+
 Listener listener;
 
 Listener::~Listener()
@@ -93,8 +126,14 @@ Listener::~Listener()
 	for (multimap<Train*,RailCarSound>::iterator i=railcars.begin();
 	  i!=railcars.end(); ++i) {
 		alSourceStop(i->second.source);
-		if (i->second.soundControl)
-			delete i->second.soundControl;
+	}
+	for (auto& i: smsMap)
+		if (i.second)
+			delete i.second;
+	for (auto& i: pendingWavs) {
+		jobSystem.wait(i.second->group);
+		delete i.second->wav;
+		delete i.second;
 	}
 	if (morseSource) {
 		alSourceStop(morseSource);
@@ -120,72 +159,110 @@ void Listener::init()
 	alListenerf(AL_GAIN,1);
 }
 
-ALuint Listener::findBuffer(string& file)
-{
-	map<string,ALuint>::iterator i=bufferMap.find(file);
-	if (i != bufferMap.end())
-		return i->second;
-	slSample sample;
-	loadWav(file.c_str(),&sample);
-	if (sample.getLength() == 0)
-		return 0;
-	ALuint buf= makeBuffer(&sample);
-	bufferMap[file]= buf;
-	return buf;
-}
-
-//	slSample(file) doesn't skip unknown chunks in wav file.
-void Listener::loadWav(const char* filename, slSample* sample)
+//	reads a wav file, skipping unknown chunks.
+//	slSample(file) doesn't skip them and converts 16 bit samples to
+//	unsigned, which openAL doesn't want, so the data chunk is copied as is.
+//	Runs as a job, so it only touches its own data.
+static WavData* decodeWav(string filename)
 {
-	FILE* in= fopen(filename,"r");
+	FILE* in= fopen(filename.c_str(),"r");
 	if (in == NULL) {
-		fprintf(stderr,"cannot read %s\n",filename);
-		return;
+		fprintf(stderr,"cannot read %s\n",filename.c_str());
+		return NULL;
 	}
 	char magic[4];
 	if (fread(magic,4,1,in)==0 || strncmp(magic,"RIFF",4)!=0) {
-		fprintf(stderr,"bad wav format %s\n",filename);
+		fprintf(stderr,"bad wav format %s\n",filename.c_str());
 		fclose(in);
-		return;
+		return NULL;
 	}
 	int len;
 	if (fread(&len,4,1,in)==0 || fread(magic,4,1,in)==0 ||
 	  strncmp(magic,"WAVE",4)!=0) {
-		fprintf(stderr,"bad wav format %s\n",filename);
+		fprintf(stderr,"bad wav format %s\n",filename.c_str());
 		fclose(in);
-		return;
+		return NULL;
 	}
-	while (!feof(in)) {
-		if (fread(magic,4,1,in)==0 || fread(&len,4,1,in)==0) {
-//			fprintf(stderr,"bad wav format %s\n",filename);
-			fclose(in);
-			return;
-		}
+	WavData* wav= new WavData;
+	for (;;) {
+		if (fread(magic,4,1,in)==0 || fread(&len,4,1,in)==0)
+			break;
 		if (strncmp(magic,"fmt ",4)==0) {
 			unsigned short header[8];
-			fread(&header,sizeof(header),1,in);
+			if (fread(&header,sizeof(header),1,in) == 0)
+				break;
 			len-= sizeof(header);
 			if (header[0] != 1)
 				fprintf(stderr,"not pcm wav %s %d\n",
-				  filename,header[0]);
-			sample->setStereo(header[1]>1);
-			sample->setRate(*((int*)(&header[2])));
-			sample->setBps(header[7]);
+				  filename.c_str(),header[0]);
+			wav->stereo= header[1]>1;
+			wav->rate= *((int*)(&header[2]));
+			wav->bps= header[7];
 		} else if (strncmp(magic,"data",4)==0) {
-			unsigned char* buf= (unsigned char*) malloc(len);
-			fread(buf,1,len,in);
-			sample->setBuffer(buf,len);
-			free(buf);
-			if (sample->getBps() == 16)
-				sample->changeToUnsigned();
+			wav->data.resize(len);
+			len= fread(wav->data.data(),1,len,in);
+			wav->data.resize(len);
 			len= 0;
 		}
-		for (; len>0; len--)
-			getc(in);
+		if (len>0 && fseek(in,len,SEEK_CUR)!=0)
+			break;
 	}
 	fclose(in);
+	if (wav->data.size() == 0) {
+		delete wav;
+		return NULL;
+	}
+	return wav;
+}
+
+//	starts decoding a wav file in the background if it isn't already
+//	loaded or loading
+void Listener::prefetchBuffer(string& file)
+{
+	if (bufferMap.find(file)!=bufferMap.end() ||
+	  pendingWavs.find(file)!=pendingWavs.end())
+		return;
+	PendingWav* pw= new PendingWav;
+	pendingWavs[file]= pw;
+	jobSystem.run(pw->group,[pw,file]() {
+		pw->wav= decodeWav(file);
+	},JOB_LOW);
+}
+
+ALuint Listener::findBuffer(string& file)
+{
+	map<string,ALuint>::iterator i=bufferMap.find(file);
+	if (i != bufferMap.end())
+		return i->second;
+	prefetchBuffer(file);
+	auto j= pendingWavs.find(file);
+	PendingWav* pw= j->second;
+	pendingWavs.erase(j);
+	jobSystem.wait(pw->group);
+	WavData* wav= pw->wav;
+	delete pw;
+	ALuint buf= 0;
+	if (wav) {
+		buf= makeBuffer(wav);
+		delete wav;
+	}
+	bufferMap[file]= buf;
+	return buf;
 }
-	
+
+ALuint Listener::makeBuffer(WavData* wav)
+{
+	ALuint buf;
+	alGenBuffers(1,&buf);
+	ALenum format;
+	if (wav->stereo)
+		format= wav->bps==8 ? AL_FORMAT_STEREO8 : AL_FORMAT_STEREO16;
+	else
+		format= wav->bps==8 ? AL_FORMAT_MONO8 : AL_FORMAT_MONO16;
+	alBufferData(buf,format,wav->data.data(),wav->data.size(),wav->rate);
+	return buf;
+}
+
 ALuint Listener::makeBuffer(slSample* sample)
 {
 	if (sample->getBps() == 16) {
@@ -219,6 +296,7 @@ ALuint Listener::makeBuffer(slSample* sample)
 //	sets the location and orientation of the listener and trains
 void Listener::update(vsg::dvec3 position, float cosa, float sina)
 {
+	ProfileScope ps("Listener::update");
 	if (!device)
 		return;
 	ALfloat v[6];
@@ -238,6 +316,17 @@ void Listener::update(vsg::dvec3 position, float cosa, float sina)
 	for (multimap<Train*,RailCarSound>::iterator i=railcars.begin();
 	  i!=railcars.end(); ++i) {
 		RailCarInst* c= i->second.car;
+		if (!c->poseValid) {
+			vsg::dvec3 p= c->getPosition();
+			float dx= position[0]-p[0];
+			float dy= position[1]-p[1];
+			float dz= position[2]-p[2];
+			if (dx*dx+dy*dy+dz*dz>1e6) {
+				alSourceStop(i->second.source);
+				continue;
+			}
+			c->updatePose();
+		}
 		RailCarInst::LinReg* lr= c->linReg[c->def->parts.size()-1];
 		v[0]= lr->ax;
 		v[1]= lr->ay;
@@ -255,7 +344,7 @@ void Listener::update(vsg::dvec3 position, float cosa, float sina)
 		v[2]= lr->bz*c->speed;
 		alSourcefv(i->second.source,AL_VELOCITY,v);
 		if (i->second.soundControl) {
-			SoundControl* sc= i->second.soundControl;
+			const SoundControl* sc= i->second.soundControl;
 			float s= c->speed/c->getMainWheelRadius();
 			if (sc->control==VAR2)
 				s= i->first->tControl;
@@ -266,13 +355,13 @@ void Listener::update(vsg::dvec3 position, float cosa, float sina)
 			if (s < 0)
 				s= -s;
 //			fprintf(stderr,"sound speed %f\n",s);
-			int j= sc->currentSound;
+			int j= i->second.currentSound;
 			while (j>0 && s<sc->soundTable[j].min)
 				j--;
 			while (j<sc->soundTable.size()-1
 			  && s>sc->soundTable[j].max)
 				j++;
-			if (j != sc->currentSound) {
+			if (j != i->second.currentSound) {
 				alSourcei(i->second.source,AL_LOOPING,AL_FALSE);
 				alSourceStop(i->second.source);
 			}
@@ -281,13 +370,13 @@ void Listener::update(vsg::dvec3 position, float cosa, float sina)
 			if (state!=AL_PLAYING && sc->soundTable[j].buffer) {
 //				fprintf(stderr,
 //				  "sound change %p %d %d %f %f %f\n",
-//				  sc,sc->currentSound,j,s,
+//				  sc,i->second.currentSound,j,s,
 //				  sc->soundTable[j].min,sc->soundTable[j].max);
 				alSourcei(i->second.source,AL_BUFFER,
 				  sc->soundTable[j].buffer);
 				alSourcei(i->second.source,AL_LOOPING,AL_TRUE);
 				alSourcePlay(i->second.source);
-				sc->currentSound= j;
+				i->second.currentSound= j;
 			}
 			if (sc->volCurve) {
 				float g= sc->volCurve->getValue(i->first);
@@ -295,11 +384,10 @@ void Listener::update(vsg::dvec3 position, float cosa, float sina)
 					g= .1;
 				alSourcef(i->second.source,AL_GAIN,g);
 			}
-			if (sc->freqCurve &&
-			  sc->soundTable[sc->currentSound].buffer) {
+			int k= i->second.currentSound;
+			if (sc->freqCurve && sc->soundTable[k].buffer) {
 				int fq;
-				alGetBufferi(
-				  sc->soundTable[sc->currentSound].buffer,
+				alGetBufferi(sc->soundTable[k].buffer,
 				  AL_FREQUENCY,&fq);
 				if (fq > 0)
 					alSourcef(i->second.source,AL_PITCH,
@@ -328,12 +416,20 @@ void Listener::addTrain(Train* train)
 	if (!device)
 		return;
 //	fprintf(stderr,"addTrain %s\n",train->name.c_str());
+	for (RailCarInst* c=train->firstCar; c!=NULL; c=c->next) {
+		if (c->def->soundFile.size()>0 &&
+		  c->def->soundFile.find(".sms")==string::npos)
+			prefetchBuffer(c->def->soundFile);
+	}
 	int n= 0;
 	for (RailCarInst* c=train->firstCar; c!=NULL; c=c->next) {
 		if (c->def->soundFile.size() <= 0)
 			continue;
 		if (c->def->soundFile.find(".sms") != string::npos) {
-			readSMS(train,c,c->def->soundFile);
+			SMSDef* sms= findSMS(c->def->soundFile);
+			if (sms)
+				for (auto sc: sms->streams)
+					addSMSSource(train,c,sc);
 			continue;
 		}
 		ALuint buf= findBuffer(c->def->soundFile);
@@ -362,8 +458,6 @@ void Listener::removeTrain(Train* train)
 	while (i!=railcars.end() && i->first==train) {
 		ALuint s= i->second.source;
 		alDeleteSources(1,&s);
-		if (i->second.soundControl)
-			delete i->second.soundControl;
 		++i;
 	}
 	railcars.erase(train);
@@ -454,15 +548,59 @@ ControlCurve* readSMSCurve(MSTSFileNode* curve)
 			maxx= x;
 	}
 //	cc->curve.compute();
+	cc->curve.bake();
 	if (cc->control==VAR2 && maxx>1)
 		cc->control= VAR2A;
 	return cc;
 }
 
-void Listener::readSMS(Train* train, RailCarInst* car, string& file)
+//	returns the compiled sms file, reading it the first time it is used
+SMSDef* Listener::findSMS(const string& file)
+{
+	auto i= smsMap.find(file);
+	if (i != smsMap.end())
+		return i->second;
+	SMSDef* sms= readSMS(file);
+	smsMap[file]= sms;
+	return sms;
+}
+
+//	returns the StartLoop file node for a trigger that readSMS will use
+//	so only the wav files that are played get decoded ahead of time
+static MSTSFileNode* findStartLoopFile(MSTSFileNode* trigger)
+{
+	if (trigger->value==NULL || trigger->next==NULL ||
+	  trigger->next->children==NULL)
+		return NULL;
+	if (*(trigger->value)!="Variable_Trigger" &&
+	  *(trigger->value)!="Initial_Trigger")
+		return NULL;
+	MSTSFileNode* children= trigger->next->children;
+	MSTSFileNode* varinc= children->find("Variable1_Inc_Past");
+	if (varinc == NULL)
+		varinc= children->find("Variable2_Inc_Past");
+	if (varinc == NULL)
+		varinc= children->find("Speed_Inc_Past");
+	if (varinc==NULL && *(trigger->value)=="Variable_Trigger")
+		return NULL;
+	if (varinc && varinc->value && atof(varinc->value->c_str())<0)
+		return NULL;
+	if (children->find("ReleaseLoopRelease"))
+		return NULL;
+	MSTSFileNode* startLoop= children->find("StartLoop");
+	if (startLoop==NULL || startLoop->children==NULL)
+		return NULL;
+	MSTSFileNode* fnode= startLoop->children->find("File");
+	if (fnode==NULL || fnode->children==NULL ||
+	 fnode->children->value==NULL)
+		return NULL;
+	return fnode;
+}
+
+SMSDef* Listener::readSMS(const string& smsFilename)
 {
-//	fprintf(stderr,"readSMS %s\n",file.c_str());
-	file= fixFilenameCase(file.c_str());
+//	fprintf(stderr,"readSMS %s\n",smsFilename.c_str());
+	string file= fixFilenameCase(smsFilename.c_str());
 	int i= file.rfind("/");
 	string dir= file.substr(0,i);
 //	fprintf(stderr,"dir %s\n",dir.c_str());
@@ -471,23 +609,43 @@ void Listener::readSMS(Train* train, RailCarInst* car, string& file)
 		smsFile.readFile(file.c_str());
 	} catch (const char* msg) {
 		fprintf(stderr,"cannot read %s\n",file.c_str());
-		return;
+		return NULL;
 	} catch (const std::exception& error) {
 		fprintf(stderr,"cannot read %s\n",file.c_str());
-		return;
+		return NULL;
 	}
 	MSTSFileNode* sms= smsFile.find("Tr_SMS");
 //	fprintf(stderr,"sms %p\n",sms);
 	if (sms == NULL)
-		return;
+		return NULL;
 	MSTSFileNode* sgroup= sms->children->find("ScalabiltyGroup");
 //	fprintf(stderr,"sgroup %p\n",sgroup);
 	if (sgroup == NULL)
-		return;
+		return NULL;
 	MSTSFileNode* streams= sgroup->children->find("Streams");
 //	fprintf(stderr,"streams %p\n",streams);
 	if (streams == NULL)
-		return;
+		return NULL;
+	map<MSTSFileNode*,string> paths;
+	for (MSTSFileNode* node=streams->children; node!=NULL;
+	  node=node->next) {
+		if (node->value==NULL || *(node->value)!="Stream")
+			continue;
+		MSTSFileNode* triggers= node->next->children->find("Triggers");
+		if (triggers == NULL)
+			continue;
+		for (MSTSFileNode* trigger=triggers->children; trigger!=NULL;
+		  trigger=trigger->next) {
+			MSTSFileNode* fnode= findStartLoopFile(trigger);
+			if (fnode == NULL)
+				continue;
+			string path= dir+"/"+*(fnode->children->value);
+			path= fixFilenameCase(path.c_str());
+			prefetchBuffer(path);
+			paths[fnode]= path;
+		}
+	}
+	SMSDef* def= new SMSDef;
 	for (MSTSFileNode* node=streams->children; node!=NULL;
 	  node=node->next) {
 //		fprintf(stderr,"node %p\n",node->value);
@@ -547,8 +705,7 @@ void Listener::readSMS(Train* train, RailCarInst* car, string& file)
 					continue;
 //				fprintf(stderr,"file %s\n",
 //				  fnode->children->value->c_str());
-				string path= dir+"/"+*(fnode->children->value);
-				path= fixFilenameCase(path.c_str());
+				string& path= paths[fnode];
 				ALuint buf= findBuffer(path);
 //				fprintf(stderr,"file %s %d\n",path.c_str(),buf);
 				if (buf == 0)
@@ -579,28 +736,34 @@ void Listener::readSMS(Train* train, RailCarInst* car, string& file)
 		if (curve)
 			sc->freqCurve= readSMSCurve(curve);
 //		fprintf(stderr,"adding sms source %p\n",sc);
-		ALuint s;
-		alGenSources(1,&s);
-//		fprintf(stderr,"insert\n");
-		railcars.insert(make_pair(train,RailCarSound(car,s,0.,sc)));
-//		fprintf(stderr,"queue %d\n",sc->soundTable[0].buffer);
+		def->streams.push_back(sc);
 //		for (int i=1; i<sc->soundTable.size(); i++)
 //			sc->soundTable[i-1].max= sc->soundTable[i].min;
 //		for (int i=0; i<sc->soundTable.size(); i++)
 //			fprintf(stderr,"soundtable %d %f %f %d\n",i,
 //			  sc->soundTable[i].min,sc->soundTable[i].max,
 //			  sc->soundTable[i].buffer);
-		sc->currentSound= 0;
-		if (sc->soundTable[0].buffer)
-			alSourceQueueBuffers(s,1,&sc->soundTable[0].buffer);
-		alSourcei(s,AL_LOOPING,1);
-		alSourcef(s,AL_ROLLOFF_FACTOR,.2);
-		alSourcef(s,AL_REFERENCE_DISTANCE,3);
-		alSourcef(s,AL_MAX_DISTANCE,10000);
-		alSourcef(s,AL_GAIN,1);
-		//alSourcePlay(s);
-//		fprintf(stderr,"added sms source %d\n",s);
 	}
+	return def;
+}
+
+//	creates an openAL source for one sms stream on a car
+void Listener::addSMSSource(Train* train, RailCarInst* car,
+  const SoundControl* sc)
+{
+	ALuint s;
+	alGenSources(1,&s);
+	railcars.insert(make_pair(train,RailCarSound(car,s,0.,sc)));
+//	fprintf(stderr,"queue %d\n",sc->soundTable[0].buffer);
+	if (sc->soundTable[0].buffer)
+		alSourceQueueBuffers(s,1,&sc->soundTable[0].buffer);
+	alSourcei(s,AL_LOOPING,1);
+	alSourcef(s,AL_ROLLOFF_FACTOR,.2);
+	alSourcef(s,AL_REFERENCE_DISTANCE,3);
+	alSourcef(s,AL_MAX_DISTANCE,10000);
+	alSourcef(s,AL_GAIN,1);
+	//alSourcePlay(s);
+//	fprintf(stderr,"added sms source %d\n",s);
 }
 
 void Listener::setGain(float g)
@@ -32,25 +32,32 @@ THE SOFTWARE.
 #include "morse.h"
 
 struct SoundControl;
+struct SMSDef;
+struct WavData;
+struct PendingWav;
 
 struct Listener {
 	struct RailCarSound {
 		RailCarInst* car;
 		ALuint source;
 		ALfloat pitchOffset;
-		SoundControl* soundControl;
+		const SoundControl* soundControl;
+		int currentSound;
 		RailCarSound(RailCarInst* c, ALuint s, ALfloat p,
-		  SoundControl* sc) {
+		  const SoundControl* sc) {
 			car= c;
 			source= s;
 			pitchOffset= p;
 			soundControl= sc;
+			currentSound= 0;
 		};
 	};
 	ALCdevice* device;
 	ALCcontext* context;
 	std::multimap<Train*,RailCarSound> railcars;
 	std::map<std::string,ALuint> bufferMap;
+	std::map<std::string,PendingWav*> pendingWavs;
+	std::map<std::string,SMSDef*> smsMap;
 	ALuint morseSource;
 	MorseConverter* morseConverter;
 	std::string morseMessage;
@@ -66,15 +73,19 @@ struct Listener {
 	void addTrain(Train* train);
 	void removeTrain(Train* train);
 	ALuint findBuffer(std::string& file);
+	void prefetchBuffer(std::string& file);
 	ALuint makeBuffer(slSample* sample);
+	ALuint makeBuffer(WavData* wav);
 	MorseConverter* getMorseConverter();
 	void playMorse(const char* s);
 	void cleanupMorse();
 	bool playingMorse();
 	std::string& getMorseMessage() { return morseMessage; };
-	void readSMS(Train* train, RailCarInst* car, std::string& file);
+	SMSDef* findSMS(const std::string& file);
+	SMSDef* readSMS(const std::string& file);
+	void addSMSSource(Train* train, RailCarInst* car,
+	  const SoundControl* sc);
 	void setGain(float g);
-	void loadWav(const char* filename, slSample* sample);
 };
 extern Listener listener;
 
@@ -791,7 +791,7 @@ void SteamEngine::init()
 		evapRate.scaleY(grateArea);
 		burnRate.scaleX(grateArea);
 		burnRate.scaleY(grateArea);
-		printf("gratearea %f %f %f\n",
+		fprintf(stderr,"gratearea %f %f %f\n",
 		  grateArea,3600*burnRate.getMinX(),3600*burnRate.getMaxX());
 		for (int i=0; i<=11; i++) {
 			float u= burnRate.getMinX() + .1*i*burnRate.getMaxX();
@@ -818,6 +818,19 @@ void SteamEngine::init()
 //	fprintf(stderr,"blowerRate %f\n",blowerRate);
 	if (fireMass==0 && burnFactor.size()>0)
 		fireMass= (burnFactor.getMaxX()+burnFactor.getMinX())/2;
+	// these are evaluated every physics step, so use lookup tables
+	heat2psig.bake();
+	cylSteamDensity.bake();
+	satSteamHeat.bake();
+	cylPressureDrop.bake();
+	backPressure.bake();
+	release.bake();
+	forceFactor1.bake();
+	forceFactor2.bake();
+	burnRate.bake();
+	evapRate.bake();
+	burnFactor.bake();
+	evapFactor.bake();
 }
 
 //	returns the crank angle given piston position
@@ -860,7 +873,7 @@ void SteamEngine::setMaxBoilerOutput(float x)
 {
 	if (x <= 0)
 		return;
-	printf("max boiler output %.0f\n",x);
+	fprintf(stderr,"max boiler output %.0f\n",x);
 	evapRate.add(0,0);
 	evapRate.add(20,170);
 	evapRate.add(40,315);
@@ -889,6 +902,25 @@ void SteamEngine::setIdealFireMass(float x)
 	evapFactor.add(2*x,1);
 }
 
+//	returns the curves evaluated by getForce, set up as getForce uses them
+void SteamEngine::getCurves(CurveList& curves)
+{
+	if (heat2psig.size() == 0)
+		init();
+	curves.push_back(std::make_pair("heat2psig",&heat2psig));
+	curves.push_back(std::make_pair("cylSteamDensity",&cylSteamDensity));
+	curves.push_back(std::make_pair("satSteamHeat",&satSteamHeat));
+	curves.push_back(std::make_pair("cylPressureDrop",&cylPressureDrop));
+	curves.push_back(std::make_pair("backPressure",&backPressure));
+	curves.push_back(std::make_pair("release",&release));
+	curves.push_back(std::make_pair("forceFactor1",&forceFactor1));
+	curves.push_back(std::make_pair("forceFactor2",&forceFactor2));
+	curves.push_back(std::make_pair("burnRate",&burnRate));
+	curves.push_back(std::make_pair("evapRate",&evapRate));
+	curves.push_back(std::make_pair("burnFactor",&burnFactor));
+	curves.push_back(std::make_pair("evapFactor",&evapFactor));
+}
+
 //	prints a table of max force vs speed using the Kiesel force method.
 void SteamEngine::printForceVsSpeed()
 {
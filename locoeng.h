@@ -316,6 +316,8 @@ class SteamEngine : public LocoEngine, public CommandBlockHandler {
 	void setExhaustLimit(float x);
 	void setIdealFireMass(float x);
 	void printForceVsSpeed();
+	typedef std::vector<std::pair<const char*,Spline<float>*> > CurveList;
+	void getCurves(CurveList& curves);
 };
 
 extern SteamEngine* mySteamEngine;
@@ -23,12 +23,353 @@ THE SOFTWARE.
 */
 
 #include <vsg/all.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <atomic>
+#include <filesystem>
+#include <string.h>
+#ifdef __SSE2__
+#include <tmmintrin.h>
+#endif
 
 #include "mstsbfile.h"
+#include "mstsfile.h"
 #include "mstsace.h"
+#include "texcompress.h"
+#include "jobs.h"
+
+bool aceCompression= true;
+bool aceMipmaps= true;
+std::string aceCacheDir;
+static std::atomic<size_t> aceBytesLoaded;
+static std::atomic<size_t> aceBytesUncompressed;
+
+//	returns the image memory used by ace files read so far and the memory
+//	they would use without compression
+void getACEMemory(size_t& loaded, size_t& uncompressed)
+{
+	loaded= aceBytesLoaded;
+	uncompressed= aceBytesUncompressed;
+}
+
+//	header for block compressed images saved in the texture cache
+struct ACECacheHeader {
+	char magic[4];
+	int32_t version;
+	int32_t format;		// 1 for BC1, 3 for BC3
+	int32_t alphaMask;
+	int32_t width;
+	int32_t height;
+	int32_t mipLevels;
+	int32_t size;
+	int32_t uncompressedSize;
+};
+
+//	returns the default texture cache directory, empty if there is none
+//	called once from main since textures are read on pager threads
+std::string defaultACECacheDir()
+{
+	const char* dir= getenv("VSGTS_TEXTURE_CACHE");
+	const char* home= getenv("HOME");
+	if (dir)
+		return dir;
+	if (home)
+		return std::string(home)+"/.cache/vsgts/textures";
+	return "";
+}
+
+//	returns the texture cache file name for an ace file
+//	the name depends on the path, size and modification time
+static std::string aceCachePath(const char* path)
+{
+	if (aceCacheDir.size() == 0)
+		return "";
+	struct stat st;
+	if (stat(path,&st) != 0) {
+		std::string fixed= fixFilenameCase(path);
+		if (fixed.size()==0 || stat(fixed.c_str(),&st)!=0)
+			return "";
+	}
+	uint64_t hash= 14695981039346656037ull;
+	auto add= [&hash](const void* p, int n) {
+		for (int i=0; i<n; i++) {
+			hash^= ((const unsigned char*)p)[i];
+			hash*= 1099511628211ull;
+		}
+	};
+	add(path,strlen(path));
+	int64_t t= st.st_mtime;
+	int64_t s= st.st_size;
+	add(&t,sizeof(t));
+	add(&s,sizeof(s));
+	char buf[20];
+	snprintf(buf,sizeof(buf),"%16.16llx",(unsigned long long)hash);
+	return aceCacheDir+"/"+buf+".bc";
+}
+
+//	makes a vsg image from block compressed data
+static vsg::ref_ptr<vsg::Data> makeBCImage(uint8_t* data, int format,
+  bool alphaMask, int wid, int ht, int mipLevels)
+{
+	vsg::Data::Properties layout;
+	layout.mipLevels= mipLevels;
+	layout.origin= vsg::TOP_LEFT;
+	layout.imageViewType= VK_IMAGE_VIEW_TYPE_2D;
+	layout.blockWidth= 4;
+	layout.blockHeight= 4;
+	if (format == 3) {
+		layout.format= VK_FORMAT_BC3_SRGB_BLOCK;
+		return vsg::block128Array2D::create(wid/4,ht/4,
+		  reinterpret_cast<vsg::block128*>(data),layout);
+	}
+	layout.format= alphaMask ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK :
+	  VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	return vsg::block64Array2D::create(wid/4,ht/4,
+	  reinterpret_cast<vsg::block64*>(data),layout);
+}
+
+//	reads a previously compressed image from the texture cache
+static vsg::ref_ptr<vsg::Data> readACECache(std::string& cachePath)
+{
+	FILE* in= fopen(cachePath.c_str(),"rb");
+	if (!in)
+		return {};
+	ACECacheHeader header;
+	uint8_t* data= NULL;
+	if (fread(&header,sizeof(header),1,in)==1 &&
+	  strncmp(header.magic,"VTBC",4)==0 && header.version==2 &&
+	  header.size>0 && header.size<=64*1024*1024) {
+		data= (uint8_t*) malloc(header.size);
+		if (data && fread(data,1,header.size,in)!=header.size) {
+			free(data);
+			data= NULL;
+		}
+	}
+	fclose(in);
+	if (!data)
+		return {};
+	aceBytesLoaded+= header.size;
+	aceBytesUncompressed+= header.uncompressedSize;
+	return makeBCImage(data,header.format,header.alphaMask!=0,
+	  header.width,header.height,header.mipLevels);
+}
+
+//	block compresses a decoded ace image and saves it in the texture cache
+//	colors==5 images have full alpha and use BC3, others use BC1
+static vsg::ref_ptr<vsg::Data> compressACE(std::string& cachePath,
+  uint8_t* pixels, int wid, int ht, int mipLevels, int colors,
+  int uncompressedSize)
+{
+	int format= colors==5 ? 3 : 1;
+	bool alphaMask= colors == 4;
+	int pixelSize= colors>3 ? 4 : 3;
+	int blockSize= format==3 ? 16 : 8;
+	int size= 0;
+	for (int i=0,w=wid,h=ht; i<mipLevels; i++,w/=2,h/=2)
+		size+= (w/4)*(h/4)*blockSize;
+	uint8_t* data= (uint8_t*) malloc(size);
+	if (!data)
+		return {};
+	//	each mip level is split into bands of block rows that are
+	//	compressed as separate jobs
+	const int bandRows= 64;
+	JobGroup group;
+	uint8_t* src= pixels;
+	uint8_t* dst= data;
+	for (int i=0,w=wid,h=ht; i<mipLevels; i++,w/=2,h/=2) {
+		for (int y=0; y<h; y+=bandRows) {
+			int n= h-y<bandRows ? h-y : bandRows;
+			uint8_t* s= src + y*w*pixelSize;
+			uint8_t* d= dst + (y/4)*((w+3)/4)*blockSize;
+			jobSystem.run(group,[=]() {
+				if (format == 3)
+					encodeBC3(s,w,n,d);
+				else
+					encodeBC1(s,pixelSize,w,n,alphaMask,d);
+			});
+		}
+		src+= w*h*pixelSize;
+		dst+= (w/4)*(h/4)*blockSize;
+	}
+	jobSystem.wait(group);
+	if (cachePath.size() > 0) {
+		std::error_code ec;
+		std::filesystem::create_directories(aceCacheDir,ec);
+		std::string tmpPath= cachePath+".tmp";
+		FILE* out= fopen(tmpPath.c_str(),"wb");
+		if (out) {
+			ACECacheHeader header= { {'V','T','B','C'}, 2, format,
+			  alphaMask, wid, ht, mipLevels, size,
+			  uncompressedSize };
+			fwrite(&header,sizeof(header),1,out);
+			fwrite(data,1,size,out);
+			bool ok= ferror(out) == 0;
+			fclose(out);
+			if (ok)
+				rename(tmpPath.c_str(),cachePath.c_str());
+			else
+				remove(tmpPath.c_str());
+		}
+	}
+	aceBytesLoaded+= size;
+	return makeBCImage(data,format,alphaMask,wid,ht,mipLevels);
+}
+
+#ifdef __SSE2__
+//	interleaves 16 pixels of planar r, g, b and a
+static inline void interleave16(__m128i r, __m128i g, __m128i b, __m128i a,
+  uint8_t* dp)
+{
+	__m128i rg0= _mm_unpacklo_epi8(r,g);
+	__m128i rg1= _mm_unpackhi_epi8(r,g);
+	__m128i ba0= _mm_unpacklo_epi8(b,a);
+	__m128i ba1= _mm_unpackhi_epi8(b,a);
+	_mm_storeu_si128((__m128i*)dp,_mm_unpacklo_epi16(rg0,ba0));
+	_mm_storeu_si128((__m128i*)(dp+16),_mm_unpackhi_epi16(rg0,ba0));
+	_mm_storeu_si128((__m128i*)(dp+32),_mm_unpacklo_epi16(rg1,ba1));
+	_mm_storeu_si128((__m128i*)(dp+48),_mm_unpackhi_epi16(rg1,ba1));
+}
+
+//	expands 16 bits of an ace transparency mask to 0 or 255 bytes
+//	the first pixel is in the high bit of the first byte
+static inline __m128i expandMask16(const uint8_t* tp)
+{
+	const __m128i bits= _mm_setr_epi8(-128,64,32,16,8,4,2,1,
+	  -128,64,32,16,8,4,2,1);
+	__m128i m= _mm_cvtsi32_si128(tp[0] | tp[1]<<8);
+	m= _mm_unpacklo_epi8(m,m);
+	m= _mm_unpacklo_epi16(m,m);
+	m= _mm_unpacklo_epi32(m,m);
+	return _mm_cmpeq_epi8(_mm_and_si128(m,bits),bits);
+}
+
+//	interleaves 16 rgb pixels using ssse3 byte shuffles
+//	only called when the cpu supports ssse3
+__attribute__((target("ssse3")))
+static int decodeRGBRowSSSE3(const uint8_t* rp, const uint8_t* gp,
+  const uint8_t* bp, int w, uint8_t* dp)
+{
+	const __m128i pack= _mm_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,
+	  -1,-1,-1,-1);
+	const __m128i zero= _mm_setzero_si128();
+	int k= 0;
+	for (; k+16<=w; k+=16) {
+		__m128i r= _mm_loadu_si128((const __m128i*)(rp+k));
+		__m128i g= _mm_loadu_si128((const __m128i*)(gp+k));
+		__m128i b= _mm_loadu_si128((const __m128i*)(bp+k));
+		__m128i rg0= _mm_unpacklo_epi8(r,g);
+		__m128i rg1= _mm_unpackhi_epi8(r,g);
+		__m128i b0= _mm_unpacklo_epi8(b,zero);
+		__m128i b1= _mm_unpackhi_epi8(b,zero);
+		__m128i p[4]= { _mm_unpacklo_epi16(rg0,b0),
+		  _mm_unpackhi_epi16(rg0,b0), _mm_unpacklo_epi16(rg1,b1),
+		  _mm_unpackhi_epi16(rg1,b1) };
+		for (int i=0; i<4; i++) {
+			__m128i v= _mm_shuffle_epi8(p[i],pack);
+			_mm_storel_epi64((__m128i*)dp,v);
+			int t= _mm_cvtsi128_si32(_mm_srli_si128(v,8));
+			memcpy(dp+8,&t,4);
+			dp+= 12;
+		}
+	}
+	return k;
+}
+#endif
+
+//	converts one row of planar ace pixels to interleaved rgb or rgba
+//	the row has w red, w green and w blue bytes followed by a one bit
+//	mask when colors>3 and w alpha bytes when colors==5
+void decodeACERow(const uint8_t* row, int w, int colors, uint8_t* dp)
+{
+	const uint8_t* rp= row;
+	const uint8_t* gp= rp+w;
+	const uint8_t* bp= gp+w;
+	const uint8_t* tp= bp+w;
+	const uint8_t* ap= tp+(w<8 ? 1 : w/8);
+	int k= 0;
+#ifdef __SSE2__
+	if (colors > 3) {
+		for (; k+16<=w; k+=16) {
+			__m128i r= _mm_loadu_si128((const __m128i*)(rp+k));
+			__m128i g= _mm_loadu_si128((const __m128i*)(gp+k));
+			__m128i b= _mm_loadu_si128((const __m128i*)(bp+k));
+			__m128i a= colors==5 ?
+			  _mm_loadu_si128((const __m128i*)(ap+k)) :
+			  expandMask16(tp+k/8);
+			interleave16(r,g,b,a,dp);
+			dp+= 64;
+		}
+	} else {
+		static bool ssse3= __builtin_cpu_supports("ssse3");
+		if (ssse3) {
+			k= decodeRGBRowSSSE3(rp,gp,bp,w,dp);
+			dp+= 3*k;
+		}
+	}
+#endif
+	for (; k<w; k++) {
+		*dp++= rp[k];
+		*dp++= gp[k];
+		*dp++= bp[k];
+		if (colors == 4)
+			*dp++= (tp[k/8]&(1<<(7-k%8)))==0 ? 0 : 255;
+		else if (colors == 5)
+			*dp++= ap[k];
+	}
+}
+
+//	adds a box filtered mipmap chain down to 4x4 to a single level image
+//	returns the reallocated image data or the original if out of memory
+uint8_t* makeACEMipmaps(uint8_t* data, int wid, int ht, int pixelSize,
+  int& nMipmaps, int& size)
+{
+	int total= wid*ht*pixelSize;
+	int n= 1;
+	for (int w=wid/2,h=ht/2; w>=4 && h>=4; w/=2,h/=2,n++)
+		total+= w*h*pixelSize;
+	if (n == 1)
+		return data;
+	uint8_t* p= (uint8_t*) realloc(data,total);
+	if (p == NULL)
+		return data;
+	uint8_t* src= p;
+	int w= wid;
+	int h= ht;
+	for (int i=1; i<n; i++) {
+		uint8_t* dst= src+w*h*pixelSize;
+		int srcRow= w*pixelSize;
+		w/= 2;
+		h/= 2;
+		uint8_t* dp= dst;
+		for (int j=0; j<h; j++) {
+			const uint8_t* s0= src+2*j*srcRow;
+			const uint8_t* s1= s0+srcRow;
+			for (int k=0; k<w; k++) {
+				for (int c=0; c<pixelSize; c++)
+					*dp++= (s0[c]+s0[c+pixelSize]+
+					  s1[c]+s1[c+pixelSize]+2)>>2;
+				s0+= 2*pixelSize;
+				s1+= 2*pixelSize;
+			}
+		}
+		src= dst;
+	}
+	nMipmaps= n;
+	size= total;
+	return p;
+}
 
 vsg::ref_ptr<vsg::Data> readMSTSACE(const char* path)
 {
+	std::string cachePath;
+	if (aceCompression) {
+		cachePath= aceCachePath(path);
+		if (cachePath.size() > 0) {
+			vsg::ref_ptr<vsg::Data> image= readACECache(cachePath);
+			if (image)
+				return image;
+		}
+	}
 	MSTSBFile reader;
 	if (reader.open(path)) {
 		fprintf(stderr,"cannot read ace %s\n",path);
@@ -96,28 +437,11 @@ vsg::ref_ptr<vsg::Data> readMSTSACE(const char* path)
 			if (colors > 4)
 				rsz+= w;
 			auto dp= data+offset;
+			int pixelSize= colors>3 ? 4 : 3;
 			for (int j=0; j<h; j++) {
 				reader.getBytes(row,rsz);
-				auto rp= row;
-				auto gp= rp+w;
-				auto bp= gp+w;
-				auto tp= bp+w;
-				auto ap= tp+w/8;
-				for (int k=0; k<w; k++) {
-					*dp++= *rp++;
-					*dp++= *gp++;
-					*dp++= *bp++;
-					if (colors == 4) {
-						int j= k%8;
-						//*dp++= (*tp&(1<<j))==0?0:255;
-						*dp++=
-						  (*tp&(1<<(7-j)))==0?0:255;
-						if (j == 7)
-							tp++;
-					} else if (colors == 5) {
-						*dp++= *ap++;
-					}
-				}
+				decodeACERow(row,w,colors,dp);
+				dp+= w*pixelSize;
 			}
 		}
 		if ((flags&01)==0 || w<=4 || h<=4)
@@ -134,6 +458,18 @@ vsg::ref_ptr<vsg::Data> readMSTSACE(const char* path)
 		  offset,size,
 		  path,flags,wid,ht,colors,offset);
 //	fprintf(stderr,"%d mipmaps\n",nMipmaps);
+	if (aceMipmaps && (flags&021)==0)
+		data= makeACEMipmaps(data,wid,ht,colors>3?4:3,nMipmaps,size);
+	aceBytesUncompressed+= size;
+	if (aceCompression && (flags&020)==0 && wid%4==0 && ht%4==0) {
+		vsg::ref_ptr<vsg::Data> image= compressACE(cachePath,data,
+		  wid,ht,nMipmaps,colors,size);
+		if (image) {
+			free(data);
+			return image;
+		}
+	}
+	aceBytesLoaded+= size;
 	vsg::Data::Properties layout;
 	layout.mipLevels= nMipmaps;
 	layout.origin= vsg::TOP_LEFT;
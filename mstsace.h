@@ -29,6 +29,14 @@ THE SOFTWARE.
 vsg::ref_ptr<vsg::Data> readMSTSACE(const char* path);
 vsg::ref_ptr<vsg::Data> readCacheACEFile(const char* path, bool tryPNG=false);
 void cleanACECache();
+std::string defaultACECacheDir();
+void getACEMemory(size_t& loaded, size_t& uncompressed);
+void decodeACERow(const uint8_t* row, int w, int colors, uint8_t* dp);
+uint8_t* makeACEMipmaps(uint8_t* data, int wid, int ht, int pixelSize,
+  int& nMipmaps, int& size);
+extern bool aceCompression;
+extern bool aceMipmaps;
+extern std::string aceCacheDir;
 class MstsAceReaderWriter : public vsg::Inherit<vsg::CompositeReaderWriter,
   MstsAceReaderWriter>
 {
@@ -27,6 +27,7 @@ THE SOFTWARE.
 
 #include "mstsbfile.h"
 #include "mstsfile.h"
+#include "profiler.h"
 
 using namespace std;
 #include <string>
@@ -43,6 +44,7 @@ MSTSBFile::MSTSBFile()
 //	opens the specified file and determines type
 int MSTSBFile::open(const char* filename)
 {
+	ProfileScope ps("MSTSBFile::open");
 	in= fopen(filename,"r");
 	if (in == NULL) {
 		string fixed= fixFilenameCase(filename);
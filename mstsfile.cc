@@ -29,6 +29,7 @@ using namespace std;
 #include <string>
 
 #include "mstsfile.h"
+#include "profiler.h"
 
 MSTSFileNode* MSTSFileNode::find(const char* value)
 {
@@ -139,6 +140,7 @@ void MSTSFile::openFile(const char* path)
 
 void MSTSFile::readFile(const char* path)
 {
+	ProfileScope ps("MSTSFile::readFile");
 	firstNode= NULL;
 	openFile(path);
 	string token;
@@ -23,6 +23,7 @@ THE SOFTWARE.
 */
 #include <plib/ul.h>
 #include <vsg/all.h>
+#include <chrono>
 
 #include "mstsroute.h"
 #include "mstsfile.h"
@@ -40,6 +41,7 @@ THE SOFTWARE.
 #include "train.h"
 #include "timetable.h"
 #include "mstsace.h"
+#include "jobs.h"
 
 using namespace std;
 
@@ -94,6 +96,11 @@ MSTSRoute::MSTSRoute(const char* mDir, const char* rID)
 	waterLevelDelta= 0;
 	bermHeight= 0;
 	wireHeight= 0;
+	cullRatio[OBJ_TRACK]= 0;
+	cullRatio[OBJ_STATIC]= .002;
+	cullRatio[OBJ_TRANSFER]= .004;
+	cullRatio[OBJ_FOREST]= .001;
+	cullRatio[OBJ_HAZARD]= .004;
 	bridgeBase= false;
 	srDynTrack= false;
 	ustDynTrack= true;
@@ -101,10 +108,13 @@ MSTSRoute::MSTSRoute(const char* mDir, const char* rID)
 	signalSwitchStands= false;
 	createSignals= false;
 	wireTerrain= false;
+	modelSampler= NULL;
 }
 
 MSTSRoute::~MSTSRoute()
 {
+	for (auto& i: dynTrackMap)
+		delete i.second;
 }
 
 //	find the center of the route
@@ -178,15 +188,14 @@ void MSTSRoute::xy2ll(double x, double y, double* lat, double* lng)
 }
 
 //	Makes Track class data from tsection and tdb data
+//	uses the saved track cache if it was made from the same files
 void MSTSRoute::makeTrack()
 {
-	TSection tSection;
+	auto startTime= std::chrono::steady_clock::now();
 	string globalDir= fixFilenameCase(mstsDir+dirSep+"GLOBAL");
-	string path= fixFilenameCase(globalDir+dirSep+"tsection.dat");
-	tSection.readGlobalFile(path.c_str());
-	path= fixFilenameCase(routeDir+dirSep+"tsection.dat");
-	tSection.readRouteFile(path.c_str());
-	path= fixFilenameCase(routeDir+dirSep+fileName+".tdb");
+	string globalPath= fixFilenameCase(globalDir+dirSep+"tsection.dat");
+	string routePath= fixFilenameCase(routeDir+dirSep+"tsection.dat");
+	string path= fixFilenameCase(routeDir+dirSep+fileName+".tdb");
 	if (path.size() == 0) {
 		ulDir* dir= ulOpenDir(routeDir.c_str());
 		if (dir == NULL) {
@@ -203,6 +212,26 @@ void MSTSRoute::makeTrack()
 			fprintf(stderr,"cannot find tdb file\n");
 		fprintf(stderr,"tdbfile %s\n",path.c_str());
 	}
+	uint64_t key= hashTrackFiles({globalPath,routePath,path});
+	string cachePath= routeDir+dirSep+"vsgts-track.cache";
+	bool cached= readTrackCache(cachePath,key);
+	if (!cached) {
+		readTrack(globalPath,routePath,path);
+		writeTrackCache(cachePath,key);
+	}
+	double t= std::chrono::duration<double>(
+	  std::chrono::steady_clock::now()-startTime).count();
+	fprintf(stderr,"track ready in %.3f seconds%s\n",t,
+	  cached?" from cache":"");
+}
+
+//	parses tsection and tdb files and builds the Track
+void MSTSRoute::readTrack(string& globalPath, string& routePath,
+  string& path)
+{
+	TSection tSection;
+	tSection.readGlobalFile(globalPath.c_str());
+	tSection.readRouteFile(routePath.c_str());
 	TrackDB trackDB;
 	trackDB.readFile(path.c_str(),&tSection);
 //	fprintf(stderr,"nNodes %d nTrItems %d\n",
@@ -398,6 +427,7 @@ void MSTSRoute::tFileToXZ(char* filename, int *xp, int * zp)
 }
 
 //	Reads all files in tiles directory to get tiles in route
+//	the tile files are read in parallel by the job system
 void MSTSRoute::readTiles()
 {
 	
@@ -407,6 +437,8 @@ void MSTSRoute::readTiles()
 		  tilesDir.c_str());
 		return;
 	}
+	vector<Tile*> tiles;
+	vector<string> paths;
 	for (ulDirEnt* ent=ulReadDir(dir); ent!=NULL; ent=ulReadDir(dir)) {
 		int n= strlen(ent->d_name);
 		if (ent->d_name[n-1] != 't')
@@ -416,19 +448,24 @@ void MSTSRoute::readTiles()
 //		fprintf(stderr,"%s %d %d\n",ent->d_name,x,z);
 		Tile* t= new Tile(x,z);
 		t->tFilename= tFile(x,z);
-		string path= tilesDir+dirSep+ent->d_name;
 		tileMap[tileID(x,z)]= t;
 		terrainTileMap[t->tFilename]= t;
-		readTFile(path.c_str(),t);
+		tiles.push_back(t);
+		paths.push_back(tilesDir+dirSep+ent->d_name);
+	}
+	ulCloseDir(dir);
+	jobSystem.parallelFor(0,tiles.size(),16,[&](int begin, int end) {
+		for (int i=begin; i<end; i++)
+			readTFile(paths[i].c_str(),tiles[i]);
+	});
+//	for (auto t: tiles) {
 //		fprintf(stderr,"%s tf=%f sc=%f\n",
-//		  ent->d_name,t->floor,t->scale);
-//		fprintf(stderr," %d %d %s\n",x,z,tFile(x,z));
+//		  t->tFilename.c_str(),t->floor,t->scale);
 //		if (t->swWaterLevel != 0)
 //			fprintf(stderr,"%d %d sw=%f se=%f ne=%f nw=%f\n",
-//			  x,z,t->swWaterLevel,t->seWaterLevel,
+//			  t->x,t->z,t->swWaterLevel,t->seWaterLevel,
 //			  t->neWaterLevel,t->nwWaterLevel);
-	}
-	ulCloseDir(dir);
+//	}
 }
 
 //	reads a single tile file and saves some of the data
@@ -1246,8 +1283,24 @@ void MSTSRoute::loadActivity(vsg::Group* root, int activityFlags)
 //			  w->dir.c_str(),w->name.c_str());
 		loadConsist(c,root);
 	}
-	for (Event* e=activity.events; e!=NULL; e=e->next) {
+	allEvents.clear();
+	for (Event* e=activity.events; e!=NULL; e=e->next)
+		allEvents[e->id]= e;
+	resetActivityEvents();
+}
+
+//	makes the events with ids in pending waiting to fire again, or all of
+//	the activity's events if pending is NULL
+void MSTSRoute::resetActivityEvents(const std::set<int>* pending)
+{
+	activityEvents.clear();
+	eventMap.clear();
+	for (auto& i: allEvents) {
+		Event* e= i.second;
+		if (pending && pending->find(e->id)==pending->end())
+			continue;
 		eventMap[e->id]= e;
+		activityEvents.add(e,convX(e->tx,e->x),convZ(e->tz,e->z));
 	}
 }
 
@@ -1805,6 +1858,24 @@ void MSTSRoute::createWater(float waterLevel)
 }
 #endif
 
+//	finds the terrain elevation at route coordinates x,y
+//	returns false if the terrain for the tile isn't loaded
+bool MSTSRoute::getElevation(double x, double y, float* elevation)
+{
+	int tx= centerTX + (int)rint(x/2048);
+	int tz= centerTZ + (int)rint(y/2048);
+	Tile* tile= findTile(tx,tz);
+	if (tile==NULL || tile->terrain==NULL)
+		return false;
+	float dx= x - 2048*(tx-centerTX);
+	float dz= y - 2048*(tz-centerTZ);
+	Tile* t12= findTile(tile->x,tile->z-1);
+	Tile* t21= findTile(tile->x+1,tile->z);
+	Tile* t22= findTile(tile->x+1,tile->z-1);
+	*elevation= getAltitude(dx,dz,tile,t12,t21,t22);
+	return true;
+}
+
 #if 0
 float MSTSRoute::getWaterDepth(double x, double y)
 {
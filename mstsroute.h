@@ -34,9 +34,11 @@ struct LooseConsist;
 struct MSTSSignal;
 
 #include <mutex>
+#include <shared_mutex>
 #include <set>
 
 #include "track.h"
+#include "trackshape.h"
 #include "ghproj.h"
 
 struct MSTSRoute {
@@ -95,6 +97,9 @@ struct MSTSRoute {
 		std::vector<std::string> textures;
 		std::vector<std::string> microTextures;
 		float microTexUVMult;
+		int lastUsed;
+		size_t modelBytes;
+		size_t terrModelBytes;
 		void freeTerrain();
 		Tile(int tx, int tz) {	
 			x= tx;
@@ -103,9 +108,30 @@ struct MSTSRoute {
 			models= NULL;
 			terrModel= NULL;
 			microTexUVMult= 32;
+			lastUsed= 0;
+			modelBytes= 0;
+			terrModelBytes= 0;
 		};
 		float getWaterLevel(int i, int j);
 	};
+	//	samples a tile's terrain heights and normals from arrays padded
+	//	with the edges of its eight neighbours so no lookups are needed
+	struct TerrainSampler {
+		enum { PAD=2, SIZE=256+2*PAD+1 };
+		float height[SIZE][SIZE];
+		vsg::vec3 normal[SIZE][SIZE];
+		TerrainSampler(MSTSRoute* route, Tile* tile);
+		float getAltitude(int i, int j) {
+			return height[i+PAD][j+PAD];
+		};
+		vsg::vec3 getNormal(int i, int j) {
+			return normal[i+PAD][j+PAD];
+		};
+		float getAltitude(float x, float z);
+		vsg::vec3 getNormal(float x, float z);
+	};
+	TerrainSampler* modelSampler;
+	TerrainSampler* getModelSampler(Tile* tile);
 	int tileID(int tx, int tz) {
 		return ((0xffff&tx)<<16) + (0xffff&tz);
 	};
@@ -118,6 +144,27 @@ struct MSTSRoute {
 		}
 	};
 	typedef std::vector<TrackSection> TrackSections;
+	enum ObjClass {
+		OBJ_TRACK,	// track objects, signals and other line side items
+		OBJ_STATIC,
+		OBJ_TRANSFER,
+		OBJ_FOREST,
+		OBJ_HAZARD,
+		OBJ_NCLASSES
+	};
+	//	minimum screen height ratio for each object class, zero means
+	//	objects are drawn whenever their tile is visible
+	float cullRatio[OBJ_NCLASSES];
+	struct TileObject {
+		vsg::ref_ptr<vsg::MatrixTransform> transform;
+		int objClass;
+		vsg::dsphere bound;
+		TileObject(vsg::ref_ptr<vsg::MatrixTransform> mt, int oc) {
+			transform= mt;
+			objClass= oc;
+		};
+	};
+	typedef std::vector<TileObject> TileObjectList;
 	typedef std::map<int,Tile*> TileMap;
 	typedef std::map<std::string,Tile*> TerrainTileMap;
 	TileMap tileMap;
@@ -137,6 +184,8 @@ struct MSTSRoute {
 	};
 	typedef std::map<std::string,TrackModelInfo*> TrackModelMap;
 	TrackModelMap trackModelMap;
+	typedef std::map<std::string,TrackMeshList*> DynTrackMap;
+	DynTrackMap dynTrackMap;
 	TrackShape* dynTrackBase;
 	TrackShape* dynTrackRails;
 	TrackShape* dynTrackWire;
@@ -154,7 +203,8 @@ struct MSTSRoute {
 	vsg::ref_ptr<vsg::Switch> trackLines;
 	vsg::ref_ptr<vsg::MatrixTransform> skyBox;
 	typedef std::map<int,Event*> EventMap;
-	EventMap eventMap;
+	EventMap eventMap;		// events that haven't fired
+	EventMap allEvents;		// every event in the activity
 	MSTSRoute(const char* mstsDir, const char* routeID);
 	static MSTSRoute* createRoute(std::string tdbPath);
 	~MSTSRoute();
@@ -169,6 +219,11 @@ struct MSTSRoute {
 	void ll2xy(double lat, double lng, double* x, double *y);
 	void xy2ll(double lat, double lng, double* x, double *y);
 	void makeTrack();
+	void readTrack(std::string& globalPath, std::string& routePath,
+	  std::string& tdbPath);
+	uint64_t hashTrackFiles(std::vector<std::string> paths);
+	bool readTrackCache(std::string& path, uint64_t key);
+	void writeTrackCache(std::string& path, uint64_t key);
 	void addSwitchStands(double offset, double zoffset,
 	  vsg::Node* model, vsg::Group* rootNode, double poffset);
 	void adjustWater(int setTerrain);
@@ -182,7 +237,11 @@ struct MSTSRoute {
 	void makeTileMap(vsg::Group* root);
 	void loadModels(Tile* tile);
 	std::mutex loadMutex;
-	int readBinWFile(const char* filename, Tile* tile, float x0, float z0);
+	std::shared_mutex residencyMutex;
+	int readBinWFile(const char* filename, Tile* tile, float x0, float z0,
+	  TileObjectList& objects);
+	void makeTileGroups(Tile* tile, TileObjectList& objects,
+	  float x0, float z0);
 	void loadTerrainData(Tile* tile);
 	vsg::ref_ptr<vsg::Node> loadTrackModel(std::string* filename, Track::SwVertex* sw);
 	void overrideTrackModel(std::string& shapename, std::string& model);
@@ -192,8 +251,13 @@ struct MSTSRoute {
 	vsg::Node* attachSwitchStand(Tile* tile, vsg::Node* model,
 	  double x, double y, double z);
 	void cleanStaticModelMap();
-	vsg::ref_ptr<vsg::Node> makeDynTrack(MSTSFileNode* dynTrack);
-	vsg::ref_ptr<vsg::Node> makeDynTrack(TrackSections& trackSections,bool bridge);
+	bool readDynTrack(MSTSFileNode* dynTrack, TrackSections& trackSections);
+	TrackMeshList* findDynTrack(TrackSections& trackSections, bool bridge);
+	TrackMeshList* makeDynTrack(TrackSections& trackSections, bool bridge);
+	void addDynTrack(TrackMeshList& tileMeshes,
+	  TrackSections& trackSections, bool bridge, vsg::dmat4 matrix);
+	void addDynTrackModels(Tile* tile, TrackMeshList& tileMeshes,
+	  float x0, float z0);
 	vsg::ref_ptr<vsg::Node> makeTransfer(MSTSFileNode* transfer, std::string* filename,
 	  Tile* tile, MSTSFileNode* pos, MSTSFileNode* qdir);
 	vsg::ref_ptr<vsg::Node> makeTransfer(std::string* filename, Tile* tile,
@@ -212,7 +276,8 @@ struct MSTSRoute {
 	float waterLevelDelta;
 	void makeTerrainPatches(Tile* tile);
 	vsg::ref_ptr<vsg::StateGroup> makePatch(Patch* patch, int i0, int j0,
-	  Tile* tile, Tile* t12, Tile* t21, Tile* t22);
+	  Tile* tile, Tile* t12, Tile* t21, Tile* t22,
+	  TerrainSampler* sampler);
 	vsg::Geometry* loadPatchGeoFile(Patch* patch, int i0, int j0,
 	  Tile* tile);
 	float getAltitude(int i, int j, Tile* tile,
@@ -229,6 +294,7 @@ struct MSTSRoute {
 	  Tile* t12, Tile* t21, Tile* t22);
 	std::vector<vsg::vec3> terrainNormals;
 	void loadActivity(vsg::Group* root, int activityFlags);
+	void resetActivityEvents(const std::set<int>* pending= NULL);
 	void loadConsist(LooseConsist* consist, vsg::Group* root);
 	void loadExploreConsist(vsg::Group* root);
 	Track::Path* loadPath(std::string filename, bool align);
@@ -238,6 +304,7 @@ struct MSTSRoute {
 	bool createSignals;
 	MSTSSignal* findSignalInfo(MSTSFileNode* node);
 	float getWaterDepth(double x, double y);
+	bool getElevation(double x, double y, float* elevation);
 	std::vector<double> ignorePolygon;
 	std::multimap<std::string,vsg::dvec3> ignoreShapeMap;
 	bool ignoreShape(std::string* filename, double x, double y, double z);
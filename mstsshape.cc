@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include "mstsbfile.h"
 #include "mstsace.h"
 #include "mstsshape.h"
+#include "profiler.h"
 
 #include <vsg/all.h>
 
@@ -32,6 +33,7 @@ THE SOFTWARE.
 void MSTSShape::readFile(const char* filename, const char* texDir1,
   const char* texDir2)
 {
+	ProfileScope ps("MSTSShape::readFile");
 //	fprintf(stderr,"readshape %s\n",filename);
 	this->filename= filename;
 	if (texDir1 == NULL) {
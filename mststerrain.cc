@@ -24,29 +24,36 @@ THE SOFTWARE.
 #include <vsg/all.h>
 #include <string>
 #include <vector>
+#include <cmath>
 using namespace std;
 
 #include "mstsroute.h"
 #include "mstsace.h"
+#include "profiler.h"
+#include "residency.h"
 
 //	makes 3D models for each patch in a tile
 void MSTSRoute::makeTerrainPatches(Tile* tile)
 {
 	if (tile->terrModel)
 		return;
+	ProfileScope ps("makeTerrainPatches");
 //	scoped_lock lock {loadMutex};
 	readTerrain(tile);
 //	fprintf(stderr,"makeTerrain %d %d %f %f\n",
 //	  tile->x,tile->z,tile->floor,tile->scale);
+	for (int i=-1; i<=1; i++) {
+		for (int j=-1; j<=1; j++) {
+			Tile* t= findTile(tile->x+i,tile->z+j);
+			if (t != NULL)
+				readTerrain(t);
+		}
+	}
+	//	hidden flags still come from the tile and its +x and -z neighbours
 	Tile* t12= findTile(tile->x,tile->z-1);
-	if (t12 != NULL)
-		readTerrain(t12);
 	Tile* t21= findTile(tile->x+1,tile->z);
-	if (t21 != NULL)
-		readTerrain(t21);
 	Tile* t22= findTile(tile->x+1,tile->z-1);
-	if (t22 != NULL)
-		readTerrain(t22);
+	TerrainSampler* sampler= new TerrainSampler(this,tile);
 	std::vector<vsg::ref_ptr<vsg::Data>> textures;
 	for (int i=0; i<tile->textures.size()/2; i++) {
 		std::string path= terrtexDir+dirSep+tile->textures[i];
@@ -99,7 +106,7 @@ void MSTSRoute::makeTerrainPatches(Tile* tile)
 				continue;
 			}
 			auto stateGroup=
-			  makePatch(patch,i*16,j*16,tile,t12,t21,t22);
+			  makePatch(patch,i*16,j*16,tile,t12,t21,t22,sampler);
 			auto gpConfig=
 			  vsg::GraphicsPipelineConfigurator::create(shaderSet);
 			gpConfig->assignTexture("diffuseMap",
@@ -137,6 +144,7 @@ void MSTSRoute::makeTerrainPatches(Tile* tile)
 			patch++;
 		}
 	}
+	delete sampler;
 	vsg::ComputeBounds computeBounds;
 	group->accept(computeBounds);
 	vsg::dvec3 center=
@@ -150,6 +158,7 @@ void MSTSRoute::makeTerrainPatches(Tile* tile)
 	lod->children[0]= vsg::PagedLOD::Child{.8,{}};
 	lod->children[1]= vsg::PagedLOD::Child{1,{}};
 	group->addChild(lod);
+	tile->terrModelBytes= ResidencyManager::graphBytes(group);
 //	auto cg= vsg::CullGroup::create();
 //	cg->bound.set(center.x,center.y,center.z,radius);
 //	cg->addChild(group);
@@ -161,7 +170,7 @@ void MSTSRoute::makeTerrainPatches(Tile* tile)
 
 //	makes a 3D model for a single patch
 vsg::ref_ptr<vsg::StateGroup> MSTSRoute::makePatch(Patch* patch, int i0, int j0,
-  Tile* tile, Tile* t12, Tile* t21, Tile* t22)
+  Tile* tile, Tile* t12, Tile* t21, Tile* t22, TerrainSampler* sampler)
 {
 	float x0= 2048*(tile->x-centerTX);
 	float z0= 2048*(tile->z-centerTZ);
@@ -176,7 +185,7 @@ vsg::ref_ptr<vsg::StateGroup> MSTSRoute::makePatch(Patch* patch, int i0, int j0,
 	for (int i=0; i<=16; i++) {
 		int k= i*17;
 		for (int j=0; j<=16; j++) {
-			float a= getAltitude(i+i0,j+j0,tile,t12,t21,t22);
+			float a= sampler->getAltitude(i+i0,j+j0);
 			int vi= k+j;
 			verts->at(vi)=
 			  vsg::vec3(x0+8*(j0+j-128),z0+8*(128-i-i0),a);
@@ -185,15 +194,12 @@ vsg::ref_ptr<vsg::StateGroup> MSTSRoute::makePatch(Patch* patch, int i0, int j0,
 			texCoords->at(vi)= vsg::vec2(u,v);
 //			microTexCoords->push_back(
 //			  osg::Vec2(uvmult*u,uvmult*v));
-			normals->at(vi)= getNormal(i+i0,j+j0,tile,t12,t21,t22);
+			normals->at(vi)= sampler->getNormal(i+i0,j+j0);
 			float h00= getVertexHidden(i+i0,j+j0,tile,t12,t21,t22);
 			if (i<16 && j<16) {
-				float a11= getAltitude(i+i0+1,j+j0+1,
-				  tile,t12,t21,t22);
-				float a01= getAltitude(i+i0,j+j0+1,
-				  tile,t12,t21,t22);
-				float a10= getAltitude(i+i0+1,j+j0,
-				  tile,t12,t21,t22);
+				float a11= sampler->getAltitude(i+i0+1,j+j0+1);
+				float a01= sampler->getAltitude(i+i0,j+j0+1);
+				float a10= sampler->getAltitude(i+i0+1,j+j0);
 				float h11= getVertexHidden(
 				  i+i0+1,j+j0+1,tile,t12,t21,t22);
 				float h01= getVertexHidden(
@@ -241,6 +247,94 @@ vsg::ref_ptr<vsg::StateGroup> MSTSRoute::makePatch(Patch* patch, int i0, int j0,
 	return stateGroup;
 }
 
+//	copies the heights of a tile and its neighbours into a padded
+//	array and computes normals for every point used by makePatch
+//	edges without a loaded neighbour repeat the tile's edge heights
+MSTSRoute::TerrainSampler::TerrainSampler(MSTSRoute* route, Tile* tile)
+{
+	Tile* tiles[3][3];
+	for (int i=0; i<3; i++) {
+		for (int j=0; j<3; j++) {
+			Tile* t= route->findTile(tile->x+j-1,tile->z+1-i);
+			tiles[i][j]= t!=NULL && t->terrain!=NULL ? t : NULL;
+		}
+	}
+	for (int i=-PAD; i<=256+PAD; i++) {
+		int ti= i<0 ? 0 : i<256 ? 1 : 2;
+		float* hp= height[i+PAD];
+		for (int j=-PAD; j<=256+PAD; j++) {
+			int tj= j<0 ? 0 : j<256 ? 1 : 2;
+			Tile* t= tiles[ti][tj];
+			int ii= i-256*(ti-1);
+			int jj= j-256*(tj-1);
+			if (t == NULL) {
+				t= tile;
+				ii= i<0 ? 0 : i>255 ? 255 : i;
+				jj= j<0 ? 0 : j>255 ? 255 : j;
+			}
+			hp[j+PAD]= t->terrain==NULL ? 0 :
+			  t->floor + t->scale*t->terrain->y[ii][jj];
+		}
+	}
+	for (int i=1; i<SIZE-1; i++) {
+		const float* hm= height[i-1];
+		const float* h0= height[i];
+		const float* hp= height[i+1];
+		vsg::vec3* np= normal[i];
+		for (int j=1; j<SIZE-1; j++) {
+			float nx= h0[j-1]-h0[j+1];
+			float ny= hp[j]-hm[j];
+			float s= 1/std::sqrt(nx*nx+ny*ny+256);
+			np[j]= vsg::vec3(nx*s,ny*s,16*s);
+		}
+	}
+}
+
+//	returns the interpolated altitude at tile coordinates x,z
+float MSTSRoute::TerrainSampler::getAltitude(float x, float z)
+{
+	int j= (int)floor(x/8) + 128;
+	int i= 128 - (int)floor(z/8);
+	i= i<0 ? 0 : i>256+PAD-1 ? 256+PAD-1 : i;
+	j= j<-1 ? -1 : j>256 ? 256 : j;
+	float wx= (x-8*(j-128))/8;
+	float wz= (z-8*(128-i))/8;
+	wx= wx<0 ? 0 : wx>1 ? 1 : wx;
+	wz= wz<0 ? 0 : wz>1 ? 1 : wz;
+	float a00= getAltitude(i,j);
+	float a01= getAltitude(i-1,j);
+	float a11= getAltitude(i-1,j+1);
+	float a10= getAltitude(i,j+1);
+	return (1-wx)*(1-wz)*a00 + wx*(1-wz)*a10 + wx*wz*a11 + (1-wx)*wz*a01;
+}
+
+//	returns the interpolated normal at tile coordinates x,z
+vsg::vec3 MSTSRoute::TerrainSampler::getNormal(float x, float z)
+{
+	int j= (int)floor(x/8) + 128;
+	int i= 128 - (int)floor(z/8);
+	i= i<0 ? 0 : i>256+PAD-1 ? 256+PAD-1 : i;
+	j= j<-1 ? -1 : j>256 ? 256 : j;
+	float wx= (x-8*(j-128))/8;
+	float wz= (z-8*(128-i))/8;
+	wx= wx<0 ? 0 : wx>1 ? 1 : wx;
+	wz= wz<0 ? 0 : wz>1 ? 1 : wz;
+	auto n00= getNormal(i,j);
+	auto n01= getNormal(i-1,j);
+	auto n11= getNormal(i-1,j+1);
+	auto n10= getNormal(i,j+1);
+	return (1-wx)*(1-wz)*n00 + wx*(1-wz)*n10 + wx*wz*n11 + (1-wx)*wz*n01;
+}
+
+//	returns a terrain sampler for the tile whose models are being loaded
+//	it is deleted at the end of loadModels
+MSTSRoute::TerrainSampler* MSTSRoute::getModelSampler(Tile* tile)
+{
+	if (modelSampler == NULL)
+		modelSampler= new TerrainSampler(this,tile);
+	return modelSampler;
+}
+
 MstsTerrainReader::MstsTerrainReader()
 {
 }
@@ -265,6 +359,7 @@ vsg::ref_ptr<vsg::Object> MstsTerrainReader::read(
 	if (i == mstsRoute->terrainTileMap.end())
 		return {};
 	auto tile= i->second;
+	std::shared_lock lock {mstsRoute->residencyMutex};
 	if (!tile->terrModel)
 		mstsRoute->makeTerrainPatches(tile);
 	return tile->terrModel;
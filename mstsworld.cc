@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 using namespace std;
 
 #include "mstsroute.h"
@@ -34,6 +35,8 @@ using namespace std;
 #include "mstsshape.h"
 #include "trackshape.h"
 #include "animation.h"
+#include "profiler.h"
+#include "residency.h"
 
 extern string fixFilenameCase(string);
 
@@ -42,6 +45,7 @@ void MSTSRoute::loadModels(Tile* tile)
 {
 	if (tile->models)
 		return;
+	ProfileScope ps("loadModels");
 	scoped_lock lock {loadMutex};
 	tile->models= vsg::Group::create();
 	float x0= 2048*(float)(tile->x-centerTX);
@@ -50,12 +54,14 @@ void MSTSRoute::loadModels(Tile* tile)
 	sprintf(buf,"w%+6.6d%+6.6d.w",tile->x,tile->z);
 	string path= worldDir+dirSep+buf;
 //	fprintf(stderr,"loadModels from %s %f %f\n",path.c_str(),x0,z0);
-	if (readBinWFile(path.c_str(),tile,x0,z0) == 0) {
+	TileObjectList objects;
+	if (readBinWFile(path.c_str(),tile,x0,z0,objects) == 0) {
 	try {
 		MSTSFile file;
 		file.readFile(path.c_str());
 //		fprintf(stderr,"file read\n");
 		MSTSFileNode* wf= file.find("Tr_Worldfile");
+		TrackMeshList dynTrackMeshes;
 		if (!wf) {
 			fprintf(stderr,"%s not a MSTS world file?",
 			  path.c_str());
@@ -95,6 +101,9 @@ void MSTSRoute::loadModels(Tile* tile)
 			if (pos==NULL || qdir==NULL)
 				continue;
 			vsg::ref_ptr<vsg::Node> model;
+			TrackSections trackSections;
+			bool bridge= false;
+			int objClass= OBJ_STATIC;
 			if (*(node->value)=="TrackObj" && file!=NULL) {
 				Track::SwVertex* swVertex= NULL;
 				if (next->children->find("JNodePosn") != NULL) {
@@ -117,16 +126,20 @@ void MSTSRoute::loadModels(Tile* tile)
 				}
 				model= loadTrackModel(file->getChild(0)->value,
 				  swVertex);
+				objClass= OBJ_TRACK;
 			} else if (*(node->value)=="Dyntrack") {
-				model= makeDynTrack(next);
+				bridge= readDynTrack(next,trackSections);
 			} else if (*(node->value)=="Transfer") {
 				model= makeTransfer(next,
 				  file->getChild(0)->value,tile,pos,qdir);
+				objClass= OBJ_TRANSFER;
 			} else if (*(node->value)=="Forest") {
 				model= makeForest(next,tile,pos,qdir);
+				objClass= OBJ_FOREST;
 			} else if (*(node->value)=="Hazard" && file!=NULL) {
 				model=
 				  loadHazardModel(file->getChild(0)->value);
+				objClass= OBJ_HAZARD;
 #if 0
 			} else if (*(node->value)=="Signal") {
 				MSTSSignal* signal= findSignalInfo(next);
@@ -142,8 +155,10 @@ void MSTSRoute::loadModels(Tile* tile)
 			} else if (file != NULL) {
 				model=
 				  loadStaticModel(file->getChild(0)->value);
+				if (*(node->value) != "Static")
+					objClass= OBJ_TRACK;
 			}
-			if (!model)
+			if (!model && trackSections.size()==0)
 				continue;
 #if 0
 			if (file && file->getChild(0)->value &&
@@ -162,12 +177,19 @@ void MSTSRoute::loadModels(Tile* tile)
 			double x= x0+atof(pos->getChild(0)->value->c_str());
 			double y= z0+atof(pos->getChild(2)->value->c_str());
 			double z= atof(pos->getChild(1)->value->c_str());
+			if (trackSections.size() > 0) {
+				addDynTrack(dynTrackMeshes,trackSections,bridge,
+				  vsg::dmat4(1,0,0,0, 0,0,1,0, 0,1,0,0,
+				  x-x0,y-z0,z,1) * vsg::rotate(q));
+				continue;
+			}
 			vsg::ref_ptr<vsg::MatrixTransform> mt=
 			  vsg::MatrixTransform::create();
 			mt->matrix= vsg::dmat4(1,0,0,0, 0,0,1,0, 0,1,0,0, x,y,z,1) * vsg::rotate(q);
 			mt->addChild(model);
-			tile->models->addChild(mt);
+			objects.push_back(TileObject(mt,objClass));
 		}
+		addDynTrackModels(tile,dynTrackMeshes,x0,z0);
 	} catch (const char* msg) {
 		//fprintf(stderr,"loadModels caught %s %s\n",msg,path.c_str());
 	} catch (const std::exception& error) {
@@ -175,6 +197,10 @@ void MSTSRoute::loadModels(Tile* tile)
 		//  error.what(),path.c_str());
 	}
 	}
+	makeTileGroups(tile,objects,x0,z0);
+	delete modelSampler;
+	modelSampler= NULL;
+	tile->modelBytes= ResidencyManager::graphBytes(tile->models);
 	makeWater(tile,waterLevelDelta-1,"waterbot.ace",0);
 	makeWater(tile,waterLevelDelta-.5,"watermid.ace",1);
 	makeWater(tile,waterLevelDelta,"watertop.ace",2);
@@ -185,6 +211,87 @@ void MSTSRoute::loadModels(Tile* tile)
 //	fprintf(stderr,"cleanACE\n");
 }
 
+//	returns a bounding sphere for a model, or a zero radius sphere if
+//	the model has no geometry
+static vsg::dsphere modelBound(vsg::Node* model,
+  std::map<vsg::Node*,vsg::dsphere>& boundMap)
+{
+	auto i= boundMap.find(model);
+	if (i != boundMap.end())
+		return i->second;
+	vsg::ComputeBounds computeBounds;
+	model->accept(computeBounds);
+	vsg::dsphere bound(vsg::dvec3(0,0,0),0);
+	if (computeBounds.bounds.valid()) {
+		const vsg::dbox& box= computeBounds.bounds;
+		bound.center= (box.min+box.max)*.5;
+		bound.radius= .5*vsg::length(box.max-box.min);
+	}
+	boundMap[model]= bound;
+	return bound;
+}
+
+//	arranges a tile's world objects into a grid of cull groups so
+//	whole parts of a tile can be skipped when out of view
+//	objects in classes with a non zero cullRatio are also put under
+//	an LOD so they disappear when they are small on the screen
+void MSTSRoute::makeTileGroups(Tile* tile, TileObjectList& objects,
+  float x0, float z0)
+{
+	const int n= 4;
+	std::map<vsg::Node*,vsg::dsphere> boundMap;
+	std::vector<TileObject*> cells[n*n];
+	for (auto& obj: objects) {
+		vsg::Node* model= obj.transform->children[0].get();
+		vsg::dsphere bound= modelBound(model,boundMap);
+		if (bound.radius <= 0) {
+			tile->models->addChild(obj.transform);
+			continue;
+		}
+		vsg::dmat4& m= obj.transform->matrix;
+		obj.bound.center= m*bound.center;
+		obj.bound.radius= bound.radius;
+		int i= (int)((m[3][0]-x0+1024)*n/2048);
+		int j= (int)((m[3][1]-z0+1024)*n/2048);
+		i= i<0 ? 0 : i>=n ? n-1 : i;
+		j= j<0 ? 0 : j>=n ? n-1 : j;
+		cells[i*n+j].push_back(&obj);
+	}
+	for (int i=0; i<n*n; i++) {
+		if (cells[i].size() == 0)
+			continue;
+		vsg::dbox box;
+		for (auto obj: cells[i]) {
+			vsg::dvec3 r(obj->bound.radius,obj->bound.radius,
+			  obj->bound.radius);
+			box.add(obj->bound.center-r);
+			box.add(obj->bound.center+r);
+		}
+		vsg::dvec3 center= (box.min+box.max)*.5;
+		double radius= 0;
+		auto group= vsg::CullGroup::create();
+		for (auto obj: cells[i]) {
+			double r= vsg::length(obj->bound.center-center) +
+			  obj->bound.radius;
+			if (radius < r)
+				radius= r;
+			float ratio= cullRatio[obj->objClass];
+			if (ratio <= 0) {
+				group->addChild(obj->transform);
+				continue;
+			}
+			auto lod= vsg::LOD::create();
+			lod->bound= obj->bound;
+			lod->addChild(vsg::LOD::Child{ratio,obj->transform});
+			group->addChild(lod);
+		}
+		group->bound.set(center.x,center.y,center.z,radius);
+		tile->models->addChild(group);
+	}
+//	fprintf(stderr,"tile %d %d %d objects\n",tile->x,tile->z,
+//	  (int)objects.size());
+}
+
 void MSTSRoute::cleanStaticModelMap()
 {
 	for (ModelMap::iterator i=staticModelMap.begin();
@@ -205,7 +312,7 @@ void MSTSRoute::cleanStaticModelMap()
 
 //	reads a binary world file
 int MSTSRoute::readBinWFile(const char* wfilename, Tile* tile,
-  float x0, float z0)
+  float x0, float z0, TileObjectList& objects)
 {
 	MSTSBFile reader;
 	if (reader.open(wfilename))
@@ -221,6 +328,7 @@ int MSTSRoute::readBinWFile(const char* wfilename, Tile* tile,
 	bool print= false;
 	bool visible= false;
 	TrackSections trackSections;
+	TrackMeshList dynTrackMeshes;
 	float width= 0;
 	float height= 0;
 	for (;;) {
@@ -425,6 +533,7 @@ int MSTSRoute::readBinWFile(const char* wfilename, Tile* tile,
 				fprintf(stderr,"prev %d\n",prevCode);
 			print= false;
 			vsg::ref_ptr<vsg::Node> model;
+			int objClass= OBJ_TRACK;
 			switch (prevCode) {
 			  case 62: // levelcr
 				//fprintf(stderr,"levelcr %d\n",visible);
@@ -432,6 +541,7 @@ int MSTSRoute::readBinWFile(const char* wfilename, Tile* tile,
 					model= loadStaticModel(&filename);
 				break;
 			  case 3: // static
+				objClass= OBJ_STATIC;
 			  case 56: // gantry
 			  case 17: // signal
 			  case 64: // speedpost
@@ -453,14 +563,18 @@ int MSTSRoute::readBinWFile(const char* wfilename, Tile* tile,
 					  swVertex);
 				}
 				break;
-			  case 6: // trackobj
-				model= makeDynTrack(trackSections,false);
+			  case 6: // dyntrack
+				addDynTrack(dynTrackMeshes,trackSections,false,
+				  vsg::dmat4(1,0,0,0, 0,0,1,0, 0,1,0,0,
+				  posX,posZ,posY,1) *
+				  vsg::rotate(vsg::dquat(-qDirX,-qDirY,-qDirZ,qDirW)));
 				break;
 			  case 63: // transfer
 				model= makeTransfer(&filename,tile,
 				  vsg::vec3(posX,posY,posZ),
 				  vsg::quat(-qDirX,-qDirY,-qDirZ,qDirW),
 				  width,height);
+				objClass= OBJ_TRANSFER;
 			  default:
 				break;
 			}
@@ -473,13 +587,14 @@ int MSTSRoute::readBinWFile(const char* wfilename, Tile* tile,
 				  vsg::MatrixTransform::create();
 				mt->matrix= vsg::dmat4(1,0,0,0, 0,0,1,0, 0,1,0,0, x,y,z,1) * vsg::rotate(q);
 				mt->addChild(model);
-				tile->models->addChild(mt);
+				objects.push_back(TileObject(mt,objClass));
 			}
 			remainingBytes= -1;
 			visible= false;
 			prevCode= 0;
 		}
 	}
+	addDynTrackModels(tile,dynTrackMeshes,x0,z0);
 	return 1;
 }
 
@@ -621,6 +736,7 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::loadTrackModel(string* filename,
 		if (swVertex) {
 			swVertex->model= clone;
 			swVertex->animation= animation;
+			queueSwitchAnimation(swVertex);
 		}
 		return clone;
 	}
@@ -657,6 +773,7 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::loadTrackModel(string* filename,
 		if (swVertex) {
 			swVertex->model= model;
 			swVertex->animation= animation;
+			queueSwitchAnimation(swVertex);
 		}
 		return model;
 	} catch (const char* msg) {
@@ -691,12 +808,14 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::loadHazardModel(string* filename)
 	return model;
 }
 
-//	makes 3D models for dynamic track
-vsg::ref_ptr<vsg::Node> MSTSRoute::makeDynTrack(MSTSFileNode* dynTrack)
+//	reads the section list for dynamic track
+//	returns true if the track is a bridge
+bool MSTSRoute::readDynTrack(MSTSFileNode* dynTrack,
+  TrackSections& trackSections)
 {
 	MSTSFileNode* sections= dynTrack->children->find("TrackSections");
 	if (sections == NULL)
-		return NULL;
+		return false;
 	bool bridge= false;
 	MSTSFileNode* staticFlags= dynTrack->children->find("StaticFlags");
 	if (staticFlags != NULL) {
@@ -706,7 +825,6 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeDynTrack(MSTSFileNode* dynTrack)
 			bridge= true;
 //		fprintf(stderr,"bridge %d\n",bridge);
 	}
-	TrackSections trackSections;
 	for (MSTSFileNode* node=sections->children; node!=NULL;
 	  node=node->next) {
 		if (node->value == NULL)
@@ -729,10 +847,60 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeDynTrack(MSTSFileNode* dynTrack)
 		float r= atof(p->value->c_str());
 		trackSections.push_back(TrackSection(d,r));
 	}
-	return makeDynTrack(trackSections,bridge);
+	return bridge;
 }
 
-vsg::ref_ptr<vsg::Node> MSTSRoute::makeDynTrack(TrackSections& trackSections, bool bridge)
+//	returns the meshes for dynamic track with the given sections,
+//	making them only the first time the same sections are seen
+TrackMeshList* MSTSRoute::findDynTrack(TrackSections& trackSections,
+  bool bridge)
+{
+	string key= bridge ? "b" : "t";
+	for (auto& ts: trackSections) {
+		char buf[40];
+		snprintf(buf,sizeof(buf)," %a %a",ts.dist,ts.radius);
+		key+= buf;
+	}
+	auto i= dynTrackMap.find(key);
+	if (i != dynTrackMap.end())
+		return i->second;
+	TrackMeshList* meshes= makeDynTrack(trackSections,bridge);
+	dynTrackMap[key]= meshes;
+	return meshes;
+}
+
+//	adds dynamic track to the per tile meshes, matrix places it in the tile
+void MSTSRoute::addDynTrack(TrackMeshList& tileMeshes,
+  TrackSections& trackSections, bool bridge, vsg::dmat4 matrix)
+{
+	if (trackSections.size() == 0)
+		return;
+	TrackMeshList* meshes= findDynTrack(trackSections,bridge);
+	matrix= matrix * vsg::dmat4(1,0,0,0, 0,0,1,0, 0,1,0,0, 0,0,0,1);
+	for (auto& i: *meshes)
+		findTrackMesh(tileMeshes,i.first).append(i.second,matrix);
+}
+
+//	adds one model per dynamic track profile to the tile
+void MSTSRoute::addDynTrackModels(Tile* tile, TrackMeshList& tileMeshes,
+  float x0, float z0)
+{
+	if (tileMeshes.size() == 0)
+		return;
+	auto group= vsg::Group::create();
+	for (auto& i: tileMeshes)
+		if (i.second.verts.size() > 0)
+			group->addChild(
+			  i.second.makeStateGroup(i.first,vsgOptions));
+	vsg::ref_ptr<vsg::MatrixTransform> mt= vsg::MatrixTransform::create();
+	mt->matrix= vsg::translate(vsg::dvec3(x0,z0,0));
+	mt->addChild(group);
+	tile->models->addChild(mt);
+}
+
+//	makes 3D meshes for dynamic track in local coordinates
+TrackMeshList* MSTSRoute::makeDynTrack(TrackSections& trackSections,
+  bool bridge)
 {
 	if (dynTrackBase == NULL && srDynTrack)
 		makeSRDynTrackShapes();
@@ -792,32 +960,27 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeDynTrack(TrackSections& trackSections, bo
 		track.addEdge(Track::ET_STRAIGHT,pv,n==0?0:1,v,0);
 		pv= v;
 	}
-	auto group= vsg::Group::create();
-	track.shape= dynTrackRails;
-	group->addChild(track.makeGeometry(vsgOptions));
+	vector<TrackShape*> shapes;
+	shapes.push_back(dynTrackRails);
 	if (!bridge) {
-		track.shape= dynTrackBase;
-		group->addChild(track.makeGeometry(vsgOptions));
-		if (bermHeight > 0) {
-			track.shape= dynTrackBerm;
-			group->addChild(track.makeGeometry(vsgOptions));
-		}
+		shapes.push_back(dynTrackBase);
+		if (bermHeight > 0)
+			shapes.push_back(dynTrackBerm);
 	} else if (bridgeBase) {
-		track.shape= dynTrackBridge;
-		group->addChild(track.makeGeometry(vsgOptions));
+		shapes.push_back(dynTrackBridge);
 	}
-	if (!bridge && dynTrackTies) {
-		track.shape= dynTrackTies;
-		group->addChild(track.makeGeometry(vsgOptions));
-	}
-	if (wireHeight > 0) {
-		track.shape= dynTrackWire;
-		group->addChild(track.makeGeometry(vsgOptions));
+	if (!bridge && dynTrackTies)
+		shapes.push_back(dynTrackTies);
+	if (wireHeight > 0)
+		shapes.push_back(dynTrackWire);
+	TrackMeshList* meshes= new TrackMeshList;
+	for (auto shape: shapes) {
+		if (shape == NULL)
+			continue;
+		track.shape= shape;
+		track.makeMesh(findTrackMesh(*meshes,shape));
 	}
-	vsg::ref_ptr<vsg::MatrixTransform> mt= vsg::MatrixTransform::create();
-	mt->matrix= vsg::dmat4(1,0,0,0, 0,0,1,0, 0,1,0,0, 0,0,0,1);
-	mt->addChild(group);
-	return mt;
+	return meshes;
 }
 
 //	makes profile information for dynamic track
@@ -1384,10 +1547,8 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeForest(MSTSFileNode* forest,
 	vsg::vec3 center= vsg::vec3(atof(pos->getChild(0)->value->c_str()),
 	  atof(pos->getChild(1)->value->c_str()),
 	  atof(pos->getChild(2)->value->c_str()));
-	Tile* t12= findTile(tile->x,tile->z-1);
-	Tile* t21= findTile(tile->x+1,tile->z);
-	Tile* t22= findTile(tile->x+1,tile->z-1);
-	float a0= center[1];//getAltitude(center[0],center[2],tile,t12,t21,t22);
+	TerrainSampler* sampler= getModelSampler(tile);
+	float a0= center[1];//sampler->getAltitude(center[0],center[2]);
 	float scale= atof(scaleRange->getChild(0)->value->c_str());
 	float range= atof(scaleRange->getChild(1)->value->c_str());
 	float areaW= atof(area->getChild(0)->value->c_str());
@@ -1426,7 +1587,7 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeForest(MSTSFileNode* forest,
 			float x= (s-.5)*(areaW>size?areaW-size:0);
 			float z= (t-.5)*(areaH>size?areaH-size:0);
 			vsg::vec3 p= rot*vsg::vec3(x,0,z) + center;
-			float a= getAltitude(p.x,p.z,tile,t12,t21,t22);
+			float a= sampler->getAltitude(p.x,p.z);
 			vIndex= addCrossTree(vIndex,w,h,size,x,a-a0,z,
 			  verts,texCoords,indices);
 			if (vIndex >= numVert)
@@ -1503,9 +1664,7 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeTransfer(string* filename, Tile* tile,
 {
 	float x0= 2048*(tile->x-centerTX);
 	float z0= 2048*(tile->z-centerTZ);
-	Tile* t12= findTile(tile->x,tile->z-1);
-	Tile* t21= findTile(tile->x+1,tile->z);
-	Tile* t22= findTile(tile->x+1,tile->z-1);
+	TerrainSampler* sampler= getModelSampler(tile);
 	float radius= std::sqrt(w*w + h*h)/2;
 	int minX= (int)std::floor((center.x-radius)/8);
 	int maxX= (int)std::ceil((center.x+radius)/8);
@@ -1528,16 +1687,16 @@ vsg::ref_ptr<vsg::Node> MSTSRoute::makeTransfer(string* filename, Tile* tile,
 			float x= (i+minX)*8;
 			float z= (j+minZ)*8;
 			vsg::vec3 p= invrot*(vsg::vec3(x,0,z)-center);
-			float y= getAltitude(x,z,tile,t12,t21,t22);
+			float y= sampler->getAltitude(x,z);
 			verts->at(vi)= vsg::vec3(p.x,y-center.y+.01,p.z);
 			float u= p.x/w + .5;
 			float v= -p.z/h + .5;
 			texCoords->at(vi)= vsg::vec2(u,v);
-			normals->at(vi)= getNormal(x,z,tile,t12,t21,t22);
+			normals->at(vi)= sampler->getNormal(x,z);
 			if (i<nx-1 && j<nz-1) {
-				float a11= getAltitude(x+8,z+8,tile,t12,t21,t22);
-				float a01= getAltitude(x,z+8,tile,t12,t21,t22);
-				float a10= getAltitude(x+8,z,tile,t12,t21,t22);
+				float a11= sampler->getAltitude(x+8,z+8);
+				float a01= sampler->getAltitude(x,z+8);
+				float a10= sampler->getAltitude(x+8,z);
 				if (fabs(a11-y) < fabs(a10-a01)) {
 					indices->set(ii++,vi);
 					indices->set(ii++,vi+nz);
@@ -1758,6 +1917,7 @@ vsg::ref_ptr<vsg::Object> MstsWorldReader::read(
 	if (i == mstsRoute->terrainTileMap.end())
 		return {};
 	auto tile= i->second;
+	std::shared_lock lock {mstsRoute->residencyMutex};
 	if (!tile->models)
 		mstsRoute->loadModels(tile);
 	return tile->models;
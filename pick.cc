@@ -0,0 +1,454 @@
+//	fast picking of rail cars and terrain
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <vsg/all.h>
+#include <algorithm>
+
+#include "pick.h"
+#include "train.h"
+#include "railcar.h"
+#include "mstsroute.h"
+
+//	returns the world space line segment under window coordinates x,y
+//	start is the end nearest the camera
+void getPickSegment(vsg::Camera& camera, int x, int y, vsg::dvec3& start,
+  vsg::dvec3& end)
+{
+	auto viewport= camera.getViewport();
+	double nx= 2*(x-viewport.x)/viewport.width - 1;
+	double ny= 2*(y-viewport.y)/viewport.height - 1;
+	auto view= camera.viewMatrix->transform();
+	auto inv= vsg::inverse(camera.projectionMatrix->transform()*view);
+	auto p0= inv*vsg::dvec4(nx,ny,0,1);
+	auto p1= inv*vsg::dvec4(nx,ny,1,1);
+	start= vsg::dvec3(p0.x,p0.y,p0.z)/p0.w;
+	end= vsg::dvec3(p1.x,p1.y,p1.z)/p1.w;
+	auto e= vsg::inverse(view)*vsg::dvec4(0,0,0,1);
+	auto eye= vsg::dvec3(e.x,e.y,e.z)/e.w;
+	if (vsg::length2(end-eye) < vsg::length2(start-eye))
+		std::swap(start,end);
+}
+
+//	slab test of segment start+t*dir against box
+//	returns true and the entry t if the segment hits the box
+static bool intersectBox(const vsg::dbox& box, const vsg::dvec3& start,
+  const vsg::dvec3& dir, double maxT, double& t)
+{
+	double t0= 0;
+	double t1= maxT;
+	for (int i=0; i<3; i++) {
+		if (dir[i] == 0) {
+			if (start[i]<box.min[i] || start[i]>box.max[i])
+				return false;
+			continue;
+		}
+		double inv= 1/dir[i];
+		double ta= (box.min[i]-start[i])*inv;
+		double tb= (box.max[i]-start[i])*inv;
+		if (ta > tb)
+			std::swap(ta,tb);
+		if (t0 < ta)
+			t0= ta;
+		if (t1 > tb)
+			t1= tb;
+		if (t0 > t1)
+			return false;
+	}
+	t= t0;
+	return true;
+}
+
+//	sets leaf's world space box from the car's current matrix
+void CarBVH::setWorldBox(Leaf& leaf)
+{
+	leaf.car->validatePose();
+	leaf.matrix= leaf.car->model->matrix;
+	leaf.worldBox= vsg::dbox();
+	const vsg::dbox& local= leaf.localBox;
+	for (int i=0; i<8; i++) {
+		vsg::dvec3 p((i&1)?local.max.x:local.min.x,
+		  (i&2)?local.max.y:local.min.y,
+		  (i&4)?local.max.z:local.min.z);
+		auto wp= leaf.matrix*vsg::dvec4(p.x,p.y,p.z,1);
+		leaf.worldBox.add(vsg::dvec3(wp.x,wp.y,wp.z));
+	}
+	leaf.center= (leaf.worldBox.min+leaf.worldBox.max)*.5;
+}
+
+//	returns the summed diagonals of the nodes that hold leaves
+double CarBVH::leafNodeSize()
+{
+	double sum= 0;
+	for (auto& node: nodes)
+		if (node.left < 0)
+			sum+= vsg::length(node.box.max-node.box.min);
+	return sum;
+}
+
+//	brings the hierarchy up to date with the cars in trainList
+void CarBVH::update()
+{
+	int n= 0;
+	bool same= true;
+	for (auto train: trainList) {
+		for (auto car=train->firstCar; car; car=car->next) {
+			if (!car->def->getBounds().valid())
+				continue;
+			if (n>=cars.size() || cars[n].first!=train ||
+			  cars[n].second!=car)
+				same= false;
+			n++;
+		}
+	}
+	if (!same || n!=cars.size() || !refit())
+		build();
+}
+
+void CarBVH::build()
+{
+	leaves.clear();
+	nodes.clear();
+	cars.clear();
+	for (auto train: trainList) {
+		for (auto car=train->firstCar; car; car=car->next) {
+			const vsg::dbox& local= car->def->getBounds();
+			if (!local.valid())
+				continue;
+			cars.push_back(std::make_pair(train,car));
+			Leaf leaf;
+			leaf.train= train;
+			leaf.car= car;
+			leaf.localBox= local;
+			setWorldBox(leaf);
+			leaves.push_back(leaf);
+		}
+	}
+	if (leaves.size() > 0) {
+		nodes.reserve(2*leaves.size());
+		buildNode(0,leaves.size());
+	}
+	builtSize= leafNodeSize();
+}
+
+//	moves the leaf boxes to the cars' current positions and grows the
+//	node boxes to fit
+//	children always follow their parent in nodes, so a reverse pass
+//	sees every child before its parent
+//	returns false if the boxes have grown enough that a rebuild is better
+bool CarBVH::refit()
+{
+	for (auto& leaf: leaves)
+		setWorldBox(leaf);
+	for (int i=nodes.size()-1; i>=0; i--) {
+		Node& node= nodes[i];
+		vsg::dbox box;
+		if (node.left < 0) {
+			for (int j=node.first; j<node.first+node.count; j++)
+				box.add(leaves[j].worldBox);
+		} else {
+			box.add(nodes[node.left].box);
+			box.add(nodes[node.right].box);
+		}
+		node.box= box;
+	}
+	return leafNodeSize() < 2*builtSize+100;
+}
+
+//	splits leaves at the median of the longest axis of their bounds
+int CarBVH::buildNode(int first, int count)
+{
+	int index= nodes.size();
+	nodes.push_back(Node());
+	vsg::dbox box;
+	for (int i=first; i<first+count; i++)
+		box.add(leaves[i].worldBox);
+	nodes[index].box= box;
+	nodes[index].first= first;
+	nodes[index].count= count;
+	nodes[index].left= -1;
+	nodes[index].right= -1;
+	if (count <= 4)
+		return index;
+	auto size= box.max-box.min;
+	int axis= size.x>size.y ? (size.x>size.z ? 0 : 2) :
+	  (size.y>size.z ? 1 : 2);
+	int mid= first+count/2;
+	std::nth_element(leaves.begin()+first,leaves.begin()+mid,
+	  leaves.begin()+first+count,
+	  [axis](const Leaf& a, const Leaf& b) {
+		return a.center[axis] < b.center[axis];
+	  });
+	int left= buildNode(first,mid-first);
+	int right= buildNode(mid,first+count-mid);
+	nodes[index].left= left;
+	nodes[index].right= right;
+	return index;
+}
+
+//	finds the nearest car hit by the segment
+bool CarBVH::intersect(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result)
+{
+	if (nodes.size() == 0)
+		return false;
+	vsg::dvec3 dir= end-start;
+	double len= vsg::length(dir);
+	if (len <= 0)
+		return false;
+	dir/= len;
+	double bestT= len;
+	bool hit= false;
+	int stack[64];
+	int sp= 0;
+	stack[sp++]= 0;
+	while (sp > 0) {
+		Node& node= nodes[stack[--sp]];
+		double t;
+		if (!intersectBox(node.box,start,dir,bestT,t))
+			continue;
+		if (node.left >= 0) {
+			if (sp < 62) {
+				stack[sp++]= node.left;
+				stack[sp++]= node.right;
+			}
+			continue;
+		}
+		for (int i=node.first; i<node.first+node.count; i++) {
+			Leaf& leaf= leaves[i];
+			if (!intersectBox(leaf.worldBox,start,dir,bestT,t))
+				continue;
+			//	exact test in the car's own coordinates
+			auto inv= vsg::inverse(leaf.matrix);
+			auto ls= inv*vsg::dvec4(start.x,start.y,start.z,1);
+			auto ld= inv*vsg::dvec4(dir.x,dir.y,dir.z,0);
+			if (!intersectBox(leaf.localBox,
+			  vsg::dvec3(ls.x,ls.y,ls.z),vsg::dvec3(ld.x,ld.y,ld.z),
+			  bestT,t))
+				continue;
+			bestT= t;
+			result.train= leaf.train;
+			result.car= leaf.car;
+			hit= true;
+		}
+	}
+	if (hit) {
+		result.distance= bestT;
+		result.position= start+dir*bestT;
+	}
+	return hit;
+}
+
+bool pickRailCar(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result)
+{
+	static CarBVH bvh;
+	bvh.update();
+	return bvh.intersect(start,end,result);
+}
+
+//	marches along the segment comparing against the terrain height field
+//	step size grows with distance since far picks need less precision
+bool pickTerrain(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result)
+{
+	if (!mstsRoute)
+		return false;
+	vsg::dvec3 dir= end-start;
+	double len= vsg::length(dir);
+	if (len <= 0)
+		return false;
+	dir/= len;
+	double prevT= 0;
+	double prevDz= 0;
+	bool havePrev= false;
+	for (double t=0; t<len; ) {
+		vsg::dvec3 p= start+dir*t;
+		float elev;
+		if (mstsRoute->getElevation(p.x,p.y,&elev)) {
+			double dz= p.z-elev;
+			if (dz <= 0) {
+				if (havePrev) {
+					double a= prevDz/(prevDz-dz);
+					t= prevT + a*(t-prevT);
+				}
+				if (t >= result.distance)
+					return false;
+				result.train= nullptr;
+				result.car= nullptr;
+				result.distance= t;
+				result.position= start+dir*t;
+				return true;
+			}
+			prevT= t;
+			prevDz= dz;
+			havePrev= true;
+		} else {
+			havePrev= false;
+		}
+		double step= .005*t;
+		t+= step<4 ? 4 : step;
+	}
+	return false;
+}
+
+//	breaks every track edge into pieces no longer than 10 meters
+//	spline edges are sampled the same way Track::findLocation does
+void TrackPickIndex::update()
+{
+	int n= 0;
+	for (TrackMap::iterator i=trackMap.begin(); i!=trackMap.end(); ++i)
+		n+= i->second->edgeList.size();
+	if (n == nEdges)
+		return;
+	nEdges= n;
+	pieces.clear();
+	grid.clear();
+	for (TrackMap::iterator i=trackMap.begin(); i!=trackMap.end(); ++i) {
+		Track* track= i->second;
+		for (Track::EdgeList::iterator j=track->edgeList.begin();
+		  j!=track->edgeList.end(); ++j) {
+			Track::Edge* e= *j;
+			if (!e->v1 || !e->v2)
+				continue;
+			vsg::dvec3 p1= e->v1->location.coord;
+			vsg::dvec3 p2= e->v2->location.coord;
+			int m= 1;
+			if (e->type == Track::ET_SPLINE)
+				m= (int)(e->length/10)+1;
+			vsg::dvec3 prev= p1;
+			for (int k=1; k<=m; k++) {
+				double a= (double)k/m;
+				vsg::dvec3 p= p1+(p2-p1)*a;
+				if (e->type==Track::ET_SPLINE && k<m) {
+					Track::SplineEdge* sp=
+					  (Track::SplineEdge*) e;
+					double b= 1-a;
+					double a3= a*a*a-a;
+					double b3= b*b*b-b;
+					for (int l=0; l<3; l++)
+						p[l]+= (b3*sp->dd1[l] +
+						  a3*sp->dd2[l])*sp->splineMult;
+				}
+				addPiece(prev,p);
+				prev= p;
+			}
+		}
+	}
+}
+
+//	adds a piece to every cell its bounds, widened by radius, overlap
+void TrackPickIndex::addPiece(const vsg::dvec3& p0, const vsg::dvec3& p1)
+{
+	int index= pieces.size();
+	pieces.push_back(Piece{p0,p1});
+	int64_t i0= (int64_t)floor((std::min(p0.x,p1.x)-radius)/cellSize);
+	int64_t i1= (int64_t)floor((std::max(p0.x,p1.x)+radius)/cellSize);
+	int64_t j0= (int64_t)floor((std::min(p0.y,p1.y)-radius)/cellSize);
+	int64_t j1= (int64_t)floor((std::max(p0.y,p1.y)+radius)/cellSize);
+	for (int64_t i=i0; i<=i1; i++)
+		for (int64_t j=j0; j<=j1; j++)
+			grid[cellKey(i,j)].push_back(index);
+}
+
+//	returns the squared distance between segment start+s*dir, s in
+//	[0,maxT], and segment q0 q1, and the closest points' parameters
+//	dir must be unit length
+static double segmentDistance2(const vsg::dvec3& start,
+  const vsg::dvec3& dir, double maxT, const vsg::dvec3& q0,
+  const vsg::dvec3& q1, double& s, double& u)
+{
+	vsg::dvec3 d= q1-q0;
+	vsg::dvec3 r= start-q0;
+	double e= vsg::dot(d,d);
+	double b= vsg::dot(dir,d);
+	double c= vsg::dot(dir,r);
+	double f= vsg::dot(d,r);
+	double denom= e-b*b;
+	s= denom>1e-12 ? (b*f-c*e)/denom : 0;
+	s= std::clamp(s,0.,maxT);
+	u= e>0 ? (b*s+f)/e : 0;
+	if (u < 0) {
+		u= 0;
+		s= std::clamp(-c,0.,maxT);
+	} else if (u > 1) {
+		u= 1;
+		s= std::clamp(b-c,0.,maxT);
+	}
+	return vsg::length2(start+dir*s-(q0+d*u));
+}
+
+//	finds the nearest track piece that passes within radius of the
+//	segment, looking only at the grid cells under the segment
+bool TrackPickIndex::intersect(const vsg::dvec3& start,
+  const vsg::dvec3& end, PickResult& result)
+{
+	vsg::dvec3 dir= end-start;
+	double len= vsg::length(dir);
+	if (len <= 0)
+		return false;
+	dir/= len;
+	double bestT= std::min(len,result.distance);
+	vsg::dvec3 bestP;
+	bool hit= false;
+	double xy= sqrt(dir.x*dir.x+dir.y*dir.y);
+	double step= .25*cellSize/(xy>1e-3 ? xy : 1e-3);
+	int64_t prevKey= 0;
+	for (double t=0; t<=bestT+step; t+=step) {
+		vsg::dvec3 p= start+dir*std::min(t,bestT);
+		int64_t key= cellKey((int64_t)floor(p.x/cellSize),
+		  (int64_t)floor(p.y/cellSize));
+		if (t>0 && key==prevKey)
+			continue;
+		prevKey= key;
+		auto i= grid.find(key);
+		if (i == grid.end())
+			continue;
+		for (int index: i->second) {
+			Piece& piece= pieces[index];
+			double s,u;
+			double d2= segmentDistance2(start,dir,bestT,
+			  piece.p0,piece.p1,s,u);
+			if (d2>radius*radius || s>=bestT)
+				continue;
+			bestT= s;
+			bestP= piece.p0+(piece.p1-piece.p0)*u;
+			hit= true;
+		}
+	}
+	if (hit) {
+		result.train= nullptr;
+		result.car= nullptr;
+		result.distance= bestT;
+		result.position= bestP;
+	}
+	return hit;
+}
+
+bool pickTrack(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result)
+{
+	static TrackPickIndex index;
+	index.update();
+	return index.intersect(start,end,result);
+}
@@ -0,0 +1,116 @@
+//	fast picking of rail cars and terrain
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef PICK_H
+#define PICK_H
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <vsg/all.h>
+
+struct Train;
+struct RailCarInst;
+
+struct PickResult {
+	Train* train;
+	RailCarInst* car;
+	vsg::dvec3 position;
+	double distance;
+	PickResult() {
+		train= nullptr;
+		car= nullptr;
+		distance= 1e30;
+	};
+};
+
+//	bounding volume hierarchy over the rail cars in trainList
+//	kept between picks and refit to the cars' new positions, it is only
+//	rebuilt when cars are added, removed or moved between trains or when
+//	refitting has let the boxes grow too much
+struct CarBVH {
+	struct Leaf {
+		Train* train;
+		RailCarInst* car;
+		vsg::dmat4 matrix;
+		vsg::dbox localBox;
+		vsg::dbox worldBox;
+		vsg::dvec3 center;
+	};
+	struct Node {
+		vsg::dbox box;
+		int left;	// child node index or -1 for leaf range
+		int right;
+		int first;	// index into leaves
+		int count;
+	};
+	std::vector<Leaf> leaves;
+	std::vector<Node> nodes;
+	std::vector<std::pair<Train*,RailCarInst*> > cars;
+	double builtSize;	// sum of leaf node box sizes when built
+	CarBVH() { builtSize= 0; };
+	void update();
+	void build();
+	bool refit();
+	bool intersect(const vsg::dvec3& start, const vsg::dvec3& end,
+	  PickResult& result);
+ private:
+	int buildNode(int first, int count);
+	void setWorldBox(Leaf& leaf);
+	double leafNodeSize();
+};
+
+//	grid over short straight pieces of every track edge so track can
+//	be picked without intersecting the scene graph
+//	rebuilt when the number of track edges changes
+struct TrackPickIndex {
+	struct Piece {
+		vsg::dvec3 p0;
+		vsg::dvec3 p1;
+	};
+	std::vector<Piece> pieces;
+	std::unordered_map<int64_t,std::vector<int> > grid;
+	int nEdges;
+	double cellSize;
+	double radius;		// how close the segment must pass
+	TrackPickIndex() { nEdges= -1; cellSize= 64; radius= 2; };
+	void update();
+	bool intersect(const vsg::dvec3& start, const vsg::dvec3& end,
+	  PickResult& result);
+ private:
+	int64_t cellKey(int64_t i, int64_t j) {
+		return (int64_t)(((uint64_t)i<<32) ^ (j&0xffffffff));
+	};
+	void addPiece(const vsg::dvec3& p0, const vsg::dvec3& p1);
+};
+
+void getPickSegment(vsg::Camera& camera, int x, int y, vsg::dvec3& start,
+  vsg::dvec3& end);
+bool pickRailCar(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result);
+bool pickTerrain(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result);
+bool pickTrack(const vsg::dvec3& start, const vsg::dvec3& end,
+  PickResult& result);
+
+#endif
@@ -0,0 +1,98 @@
+//	lightweight scoped timer profiler
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include "profiler.h"
+
+using namespace std;
+
+Profiler profiler;
+
+Profiler::Profiler()
+{
+	startTime= std::chrono::steady_clock::now();
+	enabled= false;
+	bufferSize= 8192;
+}
+
+Profiler::~Profiler()
+{
+	for (auto b: buffers)
+		delete b;
+}
+
+//	returns the ring buffer for the calling thread, creating it on first use
+ProfileBuffer* Profiler::getBuffer()
+{
+	thread_local ProfileBuffer* buffer= nullptr;
+	if (!buffer) {
+		scoped_lock lock {mutex};
+		buffer= new ProfileBuffer(buffers.size(),bufferSize);
+		buffers.push_back(buffer);
+	}
+	return buffer;
+}
+
+//	copies the events currently held in all ring buffers
+//	events being written while this runs may be skipped
+void Profiler::getEvents(vector<ProfileEvent>& events, vector<int>& threadIDs)
+{
+	events.clear();
+	threadIDs.clear();
+	scoped_lock lock {mutex};
+	for (auto b: buffers) {
+		uint64_t n= b->count.load(std::memory_order_acquire);
+		uint64_t size= b->events.size();
+		uint64_t first= n>size-1 ? n-(size-1) : 0;
+		for (uint64_t i=first; i<n; i++) {
+			events.push_back(b->events[i%size]);
+			threadIDs.push_back(b->threadID);
+		}
+	}
+}
+
+//	writes the recorded events in Chrome trace event format
+//	which can be loaded into chrome://tracing or Perfetto
+bool Profiler::saveTrace(const char* filename)
+{
+	FILE* out= fopen(filename,"w");
+	if (!out) {
+		fprintf(stderr,"cannot create %s\n",filename);
+		return false;
+	}
+	vector<ProfileEvent> events;
+	vector<int> threadIDs;
+	getEvents(events,threadIDs);
+	fprintf(out,"{\"traceEvents\":[\n");
+	for (int i=0; i<events.size(); i++) {
+		ProfileEvent& e= events[i];
+		fprintf(out,"{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+		  "\"ts\":%lld,\"dur\":%lld}%s\n",
+		  e.name,threadIDs[i],(long long)e.start,
+		  (long long)(e.end-e.start),i<events.size()-1?",":"");
+	}
+	fprintf(out,"],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(out);
+	return true;
+}
@@ -0,0 +1,99 @@
+//	lightweight scoped timer profiler
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//	one timed interval, times are microseconds since the profiler started
+struct ProfileEvent {
+	const char* name;
+	int64_t start;
+	int64_t end;
+};
+
+//	fixed size ring of events written only by the owning thread
+struct ProfileBuffer {
+	int threadID;
+	std::vector<ProfileEvent> events;
+	std::atomic<uint64_t> count;
+	ProfileBuffer(int id, int size) : events(size) {
+		threadID= id;
+		count= 0;
+	};
+};
+
+class Profiler {
+	std::chrono::steady_clock::time_point startTime;
+	std::mutex mutex;
+	std::vector<ProfileBuffer*> buffers;
+	ProfileBuffer* getBuffer();
+ public:
+	std::atomic<bool> enabled;
+	int bufferSize;
+	Profiler();
+	~Profiler();
+	int64_t now() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+		  std::chrono::steady_clock::now()-startTime).count();
+	};
+	void record(const char* name, int64_t start, int64_t end) {
+		ProfileBuffer* b= getBuffer();
+		uint64_t n= b->count.load(std::memory_order_relaxed);
+		ProfileEvent& e= b->events[n%b->events.size()];
+		e.name= name;
+		e.start= start;
+		e.end= end;
+		b->count.store(n+1,std::memory_order_release);
+	};
+	void getEvents(std::vector<ProfileEvent>& events,
+	  std::vector<int>& threadIDs);
+	bool saveTrace(const char* filename);
+};
+extern Profiler profiler;
+
+//	times the enclosing scope if the profiler is enabled
+//	the name must be a string constant
+struct ProfileScope {
+	const char* name;
+	int64_t start;
+	ProfileScope(const char* name) {
+		if (profiler.enabled.load(std::memory_order_relaxed)) {
+			this->name= name;
+			start= profiler.now();
+		} else {
+			this->name= nullptr;
+		}
+	};
+	~ProfileScope() {
+		if (name)
+			profiler.record(name,start,profiler.now());
+	};
+};
+
+#endif
@@ -34,6 +34,8 @@ using namespace std;
 #include "railcar.h"
 
 RailCarDefMap railCarDefMap;
+RailCarModelMap railCarModelMap;
+PoseView poseView;
 
 RailCarDef* findRailCarDef(string name, bool random)
 {
@@ -73,6 +75,7 @@ RailCarDef::RailCarDef()
 	couplerGap= .02;
 	brakeValve= "K";
 	nInst= 0;
+	partAnimsValid= false;
 };
 
 void RailCarDef::copy(RailCarDef* other)
@@ -131,32 +134,91 @@ void RailCarDef::copyWheels(RailCarDef* other)
 	}
 }
 
-vsg::ref_ptr<vsg::TransformKeyframes> getWheelKeyframes()
+//	returns the bounding box of the car model in model coordinates
+const vsg::dbox& RailCarDef::getBounds()
 {
-	auto keyframes= vsg::TransformKeyframes::create();
-	for (int i=0; i<=16; i++) {
-		double time= i/16.;
-		auto r= vsg::dquat(time*2*M_PI,vsg::dvec3(1,0,0));
-		keyframes->rotations.push_back(vsg::time_dquat{time,r});
+	if (!bounds.valid() && parts.size()>0 && parts.back().model) {
+		vsg::ComputeBounds computeBounds;
+		parts.back().model->accept(computeBounds);
+		bounds= computeBounds.bounds;
 	}
-	return keyframes;
+	return bounds;
 }
 
-vsg::ref_ptr<vsg::TransformKeyframes> getBogieKeyframes()
+//	records the rest pose of each wheel, bogie and rod transform in
+//	the shared model
+//	instances only keep pointers to their own copies of the transforms
+//	and set their matrices directly in updatePose
+void RailCarDef::makePartAnims()
 {
-	auto keyframes= vsg::TransformKeyframes::create();
-	for (int i=-1; i<=1; i++) {
-		double time= i*M_PI/8;
-		auto r= vsg::dquat(time,vsg::dvec3(0,1,0));
-		keyframes->rotations.push_back(vsg::time_dquat{time,r});
+	if (partAnimsValid)
+		return;
+	partAnimsValid= true;
+	for (int i=0; i<(int)parts.size()-1; i++) {
+		PartAnim pa;
+		pa.transform=
+		  dynamic_cast<vsg::MatrixTransform*>(parts[i].model.get());
+		if (pa.transform)
+			vsg::decompose(pa.transform->matrix,pa.position,
+			  pa.rotation,pa.scale);
+		partAnims.push_back(pa);
+	}
+	if (!rodAnimation)
+		return;
+	for (auto& s: rodAnimation->samplers) {
+		auto ts= dynamic_cast<vsg::TransformSampler*>(s.get());
+		if (!ts || !ts->keyframes)
+			continue;
+		PartAnim pa;
+		pa.transform=
+		  dynamic_cast<vsg::MatrixTransform*>(ts->object.get());
+		if (!pa.transform)
+			continue;
+		pa.position= ts->position;
+		pa.rotation= ts->rotation;
+		pa.scale= ts->scale;
+		pa.keyframes= ts->keyframes;
+		rodAnims.push_back(pa);
 	}
-	return keyframes;
+}
+
+//	interpolates keyframes at time t, the end values are held outside
+//	the keyframe times
+template<class K, class T> static void sampleKeys(const vector<K>& keys,
+  double t, T& value)
+{
+	if (keys.size() == 0)
+		return;
+	if (t <= keys.front().time) {
+		value= keys.front().value;
+		return;
+	}
+	if (t >= keys.back().time) {
+		value= keys.back().value;
+		return;
+	}
+	int i= 1;
+	while (keys[i].time < t)
+		i++;
+	const K& k0= keys[i-1];
+	const K& k1= keys[i];
+	value= vsg::mix(k0.value,k1.value,(t-k0.time)/(k1.time-k0.time));
+}
+
+//	sets a part's matrix to its rest position and scale with rotation rot
+static void setPartMatrix(vsg::MatrixTransform* mt,
+  const RailCarDef::PartAnim& pa, const vsg::dvec3& pos,
+  const vsg::dquat& rot)
+{
+	mt->matrix= vsg::translate(pos)*vsg::rotate(rot)*vsg::scale(pa.scale);
 }
 
 //	creates an instance of a rail car
 RailCarInst::RailCarInst(RailCarDef* def, vsg::Group* group, float maxEqRes,
   std::string brakeValve)
 {
+	static int nextID= 0;
+	id= nextID++;
 	def->nInst++;
 	modelSw= vsg::Switch::create();
 	group->addChild(modelSw);
@@ -182,15 +244,19 @@ RailCarInst::RailCarInst(RailCarDef* def, vsg::Group* group, float maxEqRes,
 			wheels.push_back(RailCarWheel(r));
 		}
 		linReg.push_back(new LinReg);
-		partSamplers.push_back({});
 	}
 	auto& topPart= def->parts[def->parts.size()-1];
 	model= vsg::MatrixTransform::create();
 	modelSw->addChild(true,model);
+	railCarModelMap[model.get()]= this;
+	//	every instance shares the car's geometry, model holds the
+	//	instance's matrix
+	//	only the moving part transforms and the transforms above them
+	//	are copied so their matrices can differ between cars
 	auto duplicate= new vsg::Duplicate;
 	vsg::CopyOp copyop;
 	copyop.duplicate= duplicate;
-	if (def->nInst > 1) {
+	if (def->nInst>1 && def->animatedTransforms.size()>0) {
 		for (auto mt: def->animatedTransforms)
 			duplicate->insert(mt);
 		duplicate->insert(topPart.model);
@@ -199,24 +265,17 @@ RailCarInst::RailCarInst(RailCarDef* def, vsg::Group* group, float maxEqRes,
 	} else {
 		model->addChild(topPart.model);
 	}
-	if (def->rodAnimation)
-		rodAnimation= def->rodAnimation;
-	for (int i=0; i<def->parts.size()-1; i++) {
-		if (auto mt= dynamic_cast<vsg::MatrixTransform*>(def->parts[i].model.get())) {
-			auto sampler= vsg::TransformSampler::create();
-			vsg::decompose(mt->matrix,sampler->position,sampler->rotation,sampler->scale);
-			auto dup= duplicate->find(mt);
-			if (dup == duplicate->end())
-				sampler->object= mt;
-			else
-				sampler->object= dup->second;
-			partSamplers[i]= sampler;
-			if (i < wheels.size())
-				sampler->keyframes= getWheelKeyframes();
-			else
-				sampler->keyframes= getBogieKeyframes();
-		}
-	}
+	def->makePartAnims();
+	auto findCopy= [duplicate](vsg::MatrixTransform* mt) {
+		auto dup= duplicate->find(mt);
+		return dup==duplicate->end() ? mt :
+		  static_cast<vsg::MatrixTransform*>(dup->second.get());
+	};
+	for (auto& pa: def->partAnims)
+		partTransforms.push_back(pa.transform ?
+		  findCopy(pa.transform) : nullptr);
+	for (auto& pa: def->rodAnims)
+		rodTransforms.push_back(findCopy(pa.transform));
 	setLoad(0);
 	grade= 0;
 	curvature= 0;
@@ -233,11 +292,14 @@ RailCarInst::RailCarInst(RailCarDef* def, vsg::Group* group, float maxEqRes,
 	  def->brakeValve!=""?def->brakeValve:brakeValve);
 	distance= 0;
 	waybill= NULL;
+	poseValid= false;
+	posedPosition= vsg::dvec3(0,0,0);
 //	addSmoke();
 }
 
 RailCarInst::~RailCarInst()
 {
+	railCarModelMap.erase(model.get());
 	if (waybill)
 		delete waybill;
 }
@@ -254,6 +316,8 @@ void RailCarInst::setLocation(float offset, Track::Location* location)
 		wheels[n].location= loc;
 		n++;
 	}
+	//	posed now so the model is never drawn somewhere it never was
+	updatePose();
 }
 
 //	linear regression used to convert wheelset locations up to higher parts
@@ -312,7 +376,7 @@ void RailCarInst::LinReg::calc()
 }
 
 //	moves a rail car the specified distance
-//	also adjusts all the parts to follow the wheelset locations
+//	the parts are adjusted later by updatePose if the car can be seen
 void RailCarInst::move(float distance)
 {
 	this->distance+= distance;
@@ -323,12 +387,25 @@ void RailCarInst::move(float distance)
 	grade= 0;
 	curvature= 0;
 	int n= wheels.size();
-	for (int i=n; i<def->parts.size(); i++)
-		linReg[i]->init();
 	for (int i=0; i<n; i++) {
 		wheels[i].move(distance,rev);
 		grade+= wheels[i].location.grade();
 		curvature+= wheels[i].location.curvature();
+	}
+	grade/= n;
+	curvature/= n;
+	poseValid= false;
+}
+
+//	adjusts all the parts to follow the wheelset locations
+void RailCarInst::updatePose()
+{
+	poseValid= true;
+	posedPosition= getPosition();
+	int n= wheels.size();
+	for (int i=n; i<def->parts.size(); i++)
+		linReg[i]->init();
+	for (int i=0; i<n; i++) {
 		WLocation wloc;
 		wheels[i].location.getWLocation(&wloc);
 		LinReg* lr= linReg[i];
@@ -341,8 +418,6 @@ void RailCarInst::move(float distance)
 			linReg[part.parent]->sum(1,part.xoffset,
 			  wloc.coord[0],wloc.coord[1],wloc.coord[2],wloc.up);
 	}
-	grade/= n;
-	curvature/= n;
 	int m= 0;
 	for (int i=n; i<def->parts.size(); i++) {
 		LinReg* lr= linReg[i];
@@ -414,19 +489,29 @@ void RailCarInst::move(float distance)
 #endif
 		}
 	}
-	if (rodAnimation) {
+	if (rodTransforms.size() > 0) {
 		float state= 1-std::fmod(getMainWheelState(),1);
-		for (auto& s: rodAnimation->samplers) {
-			s->update(state);
+		for (int i=0; i<rodTransforms.size(); i++) {
+			RailCarDef::PartAnim& pa= def->rodAnims[i];
+			vsg::dvec3 pos= pa.position;
+			vsg::dquat rot= pa.rotation;
+			sampleKeys(pa.keyframes->positions,state,pos);
+			sampleKeys(pa.keyframes->rotations,state,rot);
+			setPartMatrix(rodTransforms[i],pa,pos,rot);
 		}
 	}
+	//	wheels turn about x once per revolution
 	for (int i=0; i<wheels.size()-1; i++) {
-		if (partSamplers[i])
-			partSamplers[i]->update(1-std::fmod(wheels[i].state,1));
+		if (!partTransforms[i])
+			continue;
+		double a= 2*M_PI*(1-std::fmod(wheels[i].state,1));
+		setPartMatrix(partTransforms[i],def->partAnims[i],
+		  def->partAnims[i].position,vsg::dquat(a,vsg::dvec3(1,0,0)));
 	}
+	//	bogies turn about z up to 22.5 degrees
 	for (int i=wheels.size(); i<def->parts.size()-1; i++) {
 		RailCarPart& part= def->parts[i];
-		if (!partSamplers[i] || part.parent<0)
+		if (!partTransforms[i] || part.parent<0)
 			continue;
 		LinReg* lr= linReg[i];
 		LinReg* plr= linReg[part.parent];
@@ -436,10 +521,53 @@ void RailCarInst::move(float distance)
 		auto angle= dot<1 ? acos(dot) : 0;
 		if (vsg::cross(fwd,pfwd).z < 0)
 			angle*= -1;
-		partSamplers[i]->update(angle);
+		if (angle > M_PI/8)
+			angle= M_PI/8;
+		else if (angle < -M_PI/8)
+			angle= -M_PI/8;
+		setPartMatrix(partTransforms[i],def->partAnims[i],
+		  def->partAnims[i].position,vsg::dquat(angle,vsg::dvec3(0,1,0)));
 	}
 }
 
+//	returns the world location of the main wheelset without updating
+//	the pose
+vsg::dvec3 RailCarInst::getPosition()
+{
+	WLocation wloc;
+	wheels[mainWheel].location.getWLocation(&wloc);
+	return wloc.coord;
+}
+
+//	returns true if a sphere at position might be seen by the camera
+bool PoseView::isVisible(const vsg::dvec3& position, double radius)
+{
+	if (!valid)
+		return true;
+	vsg::dvec3 d= position-eye;
+	double dist= vsg::length(d);
+	if (dist <= radius)
+		return true;
+	if (dist-radius > range)
+		return false;
+	double c= vsg::dot(d,dir)/dist;
+	if (c > 1)
+		c= 1;
+	else if (c < -1)
+		c= -1;
+	double a= std::acos(c);
+	return a <= halfAngle+std::asin(radius/dist);
+}
+
+//	returns true if the car or its model at its last pose might be seen
+//	by the camera
+bool PoseView::isVisible(RailCarInst* car)
+{
+	double radius= .5*car->def->length + 5;
+	return isVisible(car->getPosition(),radius) ||
+	  isVisible(car->posedPosition,radius);
+}
+
 RailCarWheel::RailCarWheel(float radius)
 {
 	state= 0;
@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include <string>
 #include <vector>
 #include <list>
+#include <unordered_map>
 #include <vsg/all.h>
 
 #include "airbrake.h"
@@ -119,8 +120,26 @@ struct RailCarDef {
 	void copy(RailCarDef* other);
 	void copyWheels(RailCarDef* other);
 	vsg::ref_ptr<vsg::Animation> rodAnimation;
+	//	instances share model's geometry and copy only the transforms
+	//	in animatedTransforms, so each car is still drawn separately
+	//	drawing all cars of a type at once would need an instanced
+	//	shader set with per car matrices and wheel angles
 	int nInst;
 	std::set<vsg::MatrixTransform*> animatedTransforms;
+	vsg::dbox bounds;
+	const vsg::dbox& getBounds();
+	//	rest pose of a moving part, shared by all instances
+	struct PartAnim {
+		vsg::MatrixTransform* transform;	// in the shared model
+		vsg::dvec3 position;
+		vsg::dquat rotation;
+		vsg::dvec3 scale;
+		vsg::ref_ptr<vsg::TransformKeyframes> keyframes; // rods only
+	};
+	std::vector<PartAnim> partAnims;	// wheels and bogies by part
+	std::vector<PartAnim> rodAnims;
+	bool partAnimsValid;
+	void makePartAnims();
 };
 
 struct Waybill {
@@ -162,14 +181,17 @@ struct RailCarInst {
 		void sum(double w, double o, double x, double y, double z,
 		  vsg::vec3& u);
 	};
+	int id;
 	RailCarDef* def;
 	LocoEngine* engine;
 	std::vector<RailCarWheel> wheels;
 	vsg::ref_ptr<vsg::Switch> modelSw;
 	vsg::ref_ptr<vsg::MatrixTransform> model;
 	std::vector<LinReg*> linReg;
-	vsg::ref_ptr<vsg::Animation> rodAnimation;
-	std::vector<vsg::ref_ptr<vsg::TransformSampler> > partSamplers;
+	//	this car's copies of the moving part transforms, in the same
+	//	order as def->partAnims and def->rodAnims
+	std::vector<vsg::MatrixTransform*> partTransforms;
+	std::vector<vsg::MatrixTransform*> rodTransforms;
 	int mainWheel;
 	float mass;
 	float massInv;
@@ -197,10 +219,18 @@ struct RailCarInst {
 	RailCarInst* prev;
 	Waybill* waybill;
 	int animState;
+	bool poseValid;
+	vsg::dvec3 posedPosition;	// main wheel location at last pose
 	RailCarInst(RailCarDef* def, vsg::Group* group, float maxEqRes,
 	  std::string brakeValve="");
 	~RailCarInst();
 	void move(float distance);
+	void updatePose();
+	void validatePose() {
+		if (!poseValid)
+			updatePose();
+	};
+	vsg::dvec3 getPosition();
 	void setLocation(float offset, Track::Location* loc);
 	void calcForce(float tControl, float dControl, float engBMult,
 	  float dt);
@@ -256,8 +286,29 @@ struct HeadLightVisitor : public osg::NodeVisitor {
 };
 #endif
 
+//	camera information used to decide which cars need their full pose
+//	computed every frame, other cars only move their wheels
+struct PoseView {
+	vsg::dvec3 eye;
+	vsg::dvec3 dir;
+	double halfAngle;	// radians, covers the frustum corners
+	double range;
+	bool valid;
+	PoseView() {
+		halfAngle= M_PI;
+		range= 1e30;
+		valid= false;
+	};
+	bool isVisible(const vsg::dvec3& position, double radius);
+	bool isVisible(RailCarInst* car);
+};
+extern PoseView poseView;
+
 typedef std::map<std::string,RailCarDef*> RailCarDefMap;
 extern RailCarDefMap railCarDefMap;
 extern RailCarDef* findRailCarDef(std::string name, bool random);
+typedef std::unordered_map<const vsg::MatrixTransform*,RailCarInst*>
+  RailCarModelMap;
+extern RailCarModelMap railCarModelMap;
 
 #endif
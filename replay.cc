@@ -0,0 +1,254 @@
+//	records and replays simulation sessions
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <string.h>
+#include "replay.h"
+#include "train.h"
+#include "track.h"
+#include "ttosim.h"
+#include "camerac.h"
+
+using namespace std;
+
+SessionReplay sessionReplay;
+
+static const int replayVersion= 1;
+
+SessionReplay::SessionReplay()
+{
+	file= NULL;
+	mode= NONE;
+	seed= 0;
+	frame= 0;
+	hashInterval= 60;
+	mismatches= 0;
+	hashChecks= 0;
+}
+
+SessionReplay::~SessionReplay()
+{
+	if (file)
+		fclose(file);
+}
+
+//	opens a session file for writing and saves the random number seed
+bool SessionReplay::startRecording(const char* path, long seed)
+{
+	file= fopen(path,"wb");
+	if (!file) {
+		fprintf(stderr,"cannot create %s\n",path);
+		return false;
+	}
+	this->seed= seed;
+	int64_t s= seed;
+	fwrite("VTSR",1,4,file);
+	fwrite(&replayVersion,sizeof(int),1,file);
+	fwrite(&s,sizeof(s),1,file);
+	mode= RECORD;
+	startTime= std::chrono::steady_clock::now();
+	return true;
+}
+
+//	opens a session file for replay and reads the random number seed
+bool SessionReplay::startReplay(const char* path)
+{
+	file= fopen(path,"rb");
+	if (!file) {
+		fprintf(stderr,"cannot open %s\n",path);
+		return false;
+	}
+	char magic[4];
+	int version= 0;
+	int64_t s= 0;
+	if (fread(magic,1,4,file)!=4 || strncmp(magic,"VTSR",4)!=0 ||
+	  fread(&version,sizeof(int),1,file)!=1 || version!=replayVersion ||
+	  fread(&s,sizeof(s),1,file)!=1) {
+		fprintf(stderr,"%s is not a session file\n",path);
+		fclose(file);
+		file= NULL;
+		return false;
+	}
+	seed= s;
+	mode= REPLAY;
+	startTime= std::chrono::steady_clock::now();
+	return true;
+}
+
+void SessionReplay::writeString(int type, const std::string& s)
+{
+	if (mode != RECORD)
+		return;
+	fputc(type,file);
+	int n= s.size();
+	fwrite(&n,sizeof(n),1,file);
+	fwrite(s.data(),1,n,file);
+}
+
+bool SessionReplay::readString(std::string& s)
+{
+	int n;
+	if (fread(&n,sizeof(n),1,file)!=1 || n<0 || n>4096)
+		return false;
+	s.resize(n);
+	return fread(&s[0],1,n,file) == n;
+}
+
+//	saves a key handled by the train controller
+void SessionReplay::recordKey(int keyBase, int keyModifier)
+{
+	if (mode != RECORD)
+		return;
+	ReplayKey key;
+	key.keyBase= keyBase;
+	key.keyModifier= keyModifier;
+	key.center= myLookAt ? myLookAt->center : vsg::dvec3(0,0,0);
+	key.selectedTrain= selectedTrain ? selectedTrain->id : -1;
+	key.selectedCar= -1;
+	if (selectedTrain) {
+		int i= 0;
+		for (RailCarInst* car=selectedTrain->firstCar; car!=NULL;
+		  car=car->next, i++)
+			if (car == selectedRailCar)
+				key.selectedCar= i;
+	}
+	fputc(KEY,file);
+	fwrite(&key,sizeof(key),1,file);
+}
+
+//	reads the records for the next frame
+//	returns false at the end of the session
+bool SessionReplay::readFrame(ReplayFrame& replayFrame)
+{
+	replayFrame.keys.clear();
+	replayFrame.route.clear();
+	replayFrame.activity.clear();
+	if (mode != REPLAY)
+		return false;
+	for (;;) {
+		int type= fgetc(file);
+		switch (type) {
+		 case KEY:
+			replayFrame.keys.push_back({});
+			if (fread(&replayFrame.keys.back(),sizeof(ReplayKey),1,
+			  file) != 1)
+				return false;
+			break;
+		 case ROUTE:
+			if (!readString(replayFrame.route))
+				return false;
+			break;
+		 case ACTIVITY:
+			if (!readString(replayFrame.activity))
+				return false;
+			break;
+		 case FRAME:
+			return fread(&replayFrame.dt,sizeof(double),1,file)==1;
+		 case EOF:
+			return false;
+		 default:
+			fprintf(stderr,"bad session record %d\n",type);
+			return false;
+		}
+	}
+}
+
+//	called after the simulation update
+//	saves dt and every hashInterval frames the state hash when recording
+//	and checks the recorded hash when replaying
+void SessionReplay::endFrame(double dt)
+{
+	if (mode == NONE)
+		return;
+	frame++;
+	if (mode == RECORD) {
+		fputc(FRAME,file);
+		fwrite(&dt,sizeof(dt),1,file);
+		if (hashInterval>0 && frame%hashInterval==0) {
+			uint64_t hash= stateHash();
+			fputc(HASH,file);
+			fwrite(&hash,sizeof(hash),1,file);
+		}
+		return;
+	}
+	int type= fgetc(file);
+	if (type != HASH) {
+		ungetc(type,file);
+		return;
+	}
+	uint64_t hash;
+	if (fread(&hash,sizeof(hash),1,file) != 1)
+		return;
+	hashChecks++;
+	if (hash!=stateHash() && mismatches++==0)
+		fprintf(stderr,"replay diverged at frame %d time %.3f\n",
+		  frame,simTime);
+}
+
+//	prints replay timing and hash check results
+void SessionReplay::printSummary()
+{
+	double t= std::chrono::duration<double>(
+	  std::chrono::steady_clock::now()-startTime).count();
+	printf("{\"frames\":%d,\"seconds\":%.3f,\"msPerFrame\":%.3f,"
+	  "\"hashChecks\":%d,\"mismatches\":%d}\n",
+	  frame,t,frame>0?1e3*t/frame:0,hashChecks,mismatches);
+}
+
+template <class T> static void addHash(uint64_t& hash, T value)
+{
+	unsigned char bytes[sizeof(T)];
+	memcpy(bytes,&value,sizeof(T));
+	for (int i=0; i<sizeof(T); i++) {
+		hash^= bytes[i];
+		hash*= 1099511628211ull;
+	}
+}
+
+//	returns an FNV-1a hash of the simulation state
+uint64_t SessionReplay::stateHash()
+{
+	uint64_t hash= 14695981039346656037ull;
+	addHash(hash,simTime);
+	for (auto train: trainList) {
+		addHash(hash,train->id);
+		addHash(hash,train->speed);
+		addHash(hash,train->location.offset);
+		addHash(hash,train->tControl);
+		addHash(hash,train->bControl);
+		for (RailCarInst* car=train->firstCar; car!=NULL;
+		  car=car->next) {
+			addHash(hash,car->speed);
+			addHash(hash,car->distance);
+			addHash(hash,car->slack);
+			if (car->airBrake) {
+				addHash(hash,car->airBrake->getPipePressure());
+				addHash(hash,car->airBrake->getCylPressure());
+			}
+		}
+	}
+	for (auto& t: trackMap)
+		for (auto sw: t.second->swVertexList)
+			addHash(hash,sw->edge2==sw->swEdges[0]);
+	return hash;
+}
@@ -0,0 +1,92 @@
+//	records and replays simulation sessions
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <vsg/all.h>
+
+//	a key handled by the train controller and the camera dependent
+//	state it uses
+struct ReplayKey {
+	int keyBase;
+	int keyModifier;
+	vsg::dvec3 center;
+	int selectedTrain;	// train id or -1
+	int selectedCar;	// car index in selectedTrain or -1
+};
+
+//	everything that happened before the simulation update in one frame
+struct ReplayFrame {
+	std::vector<ReplayKey> keys;
+	std::string route;
+	std::string activity;
+	double dt;
+};
+
+//	session file format:
+//	header: "VTSR", version, seed
+//	then records, each a type byte followed by its data
+//	frames end with a FRAME record and may be followed by a HASH record
+class SessionReplay {
+	enum { KEY=1, ROUTE, ACTIVITY, FRAME, HASH };
+	FILE* file;
+	int mode;
+	long seed;
+	int frame;
+	int hashInterval;
+	int mismatches;
+	int hashChecks;
+	std::chrono::steady_clock::time_point startTime;
+	void writeString(int type, const std::string& s);
+	bool readString(std::string& s);
+ public:
+	enum { NONE, RECORD, REPLAY };
+	SessionReplay();
+	~SessionReplay();
+	bool startRecording(const char* path, long seed);
+	bool startReplay(const char* path);
+	void setHashInterval(int n) { hashInterval= n; };
+	long getSeed() { return seed; };
+	bool isRecording() { return mode == RECORD; };
+	bool isReplaying() { return mode == REPLAY; };
+	void recordKey(int keyBase, int keyModifier);
+	void recordRoute(const std::string& route) {
+		writeString(ROUTE,route);
+	};
+	void recordActivity(const std::string& activity) {
+		writeString(ACTIVITY,activity);
+	};
+	bool readFrame(ReplayFrame& frame);
+	void endFrame(double dt);
+	void printSummary();
+	static uint64_t stateHash();
+};
+extern SessionReplay sessionReplay;
+
+#endif
@@ -0,0 +1,158 @@
+//	tile residency manager
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <vector>
+#include "residency.h"
+#include "mstsroute.h"
+
+using namespace std;
+
+ResidencyManager residencyManager;
+
+ResidencyManager::ResidencyManager()
+{
+	frame= 0;
+	budget= 512*1024*1024;
+	interval= 30;
+	nTerrain= nTerrModels= nModels= 0;
+	terrainBytes= terrModelBytes= modelBytes= 0;
+	nReleased= 0;
+}
+
+//	sums the size of vertex and index arrays in a scene graph
+//	shared arrays are counted once
+struct GraphBytesVisitor : public vsg::Inherit<vsg::ConstVisitor,
+  GraphBytesVisitor>
+{
+	set<const vsg::Data*> seen;
+	size_t bytes= 0;
+	void add(const vsg::Data* data) {
+		if (data && seen.insert(data).second)
+			bytes+= data->dataSize();
+	}
+	void apply(const vsg::Node& node) override {
+		node.traverse(*this);
+	}
+	void apply(const vsg::VertexIndexDraw& vid) override {
+		for (auto& array: vid.arrays)
+			if (array)
+				add(array->data.get());
+		if (vid.indices)
+			add(vid.indices->data.get());
+	}
+	void apply(const vsg::VertexDraw& vd) override {
+		for (auto& array: vd.arrays)
+			if (array)
+				add(array->data.get());
+	}
+};
+
+//	returns the approximate memory used by the geometry of a graph
+size_t ResidencyManager::graphBytes(vsg::Node* node)
+{
+	if (node == NULL)
+		return 0;
+	GraphBytesVisitor visitor;
+	node->accept(visitor);
+	return visitor.bytes;
+}
+
+//	updates the resident counts and releases tiles when over budget
+//	a tile is in use while the pager holds its terrain or models
+//	called once per frame from the main loop
+//	pager threads fill in tiles while holding residencyMutex shared, so
+//	the scan needs it exclusively, if a pager is busy the main thread
+//	doesn't wait and tries again at the next interval
+void ResidencyManager::update(MSTSRoute* route)
+{
+	frame++;
+	if (route==NULL || frame%interval!=0)
+		return;
+	std::unique_lock<std::shared_mutex> lock(route->residencyMutex,
+	  std::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+	nTerrain= nTerrModels= nModels= 0;
+	terrainBytes= terrModelBytes= modelBytes= 0;
+	vector<MSTSRoute::Tile*> idle;
+	for (auto& i: route->tileMap) {
+		MSTSRoute::Tile* tile= i.second;
+		bool inUse= false;
+		if (tile->terrain) {
+			nTerrain++;
+			terrainBytes+= sizeof(MSTSRoute::Terrain);
+		}
+		if (tile->terrModel) {
+			nTerrModels++;
+			terrModelBytes+= tile->terrModelBytes;
+			if (tile->terrModel->referenceCount() > 1)
+				inUse= true;
+		}
+		if (tile->models) {
+			nModels++;
+			modelBytes+= tile->modelBytes;
+			if (tile->models->referenceCount() > 1)
+				inUse= true;
+		}
+		if (inUse)
+			tile->lastUsed= frame;
+		else if (tile->terrain || tile->terrModel || tile->models)
+			idle.push_back(tile);
+	}
+	if (totalBytes() <= budget)
+		return;
+	sort(idle.begin(),idle.end(),
+	  [](MSTSRoute::Tile* a, MSTSRoute::Tile* b) {
+		return a->lastUsed < b->lastUsed;
+	});
+	for (auto tile: idle) {
+		if (totalBytes() <= budget)
+			break;
+		if ((tile->terrModel && tile->terrModel->referenceCount()>1) ||
+		  (tile->models && tile->models->referenceCount()>1))
+			continue;
+		if (tile->terrain) {
+			tile->freeTerrain();
+			nTerrain--;
+			terrainBytes-= sizeof(MSTSRoute::Terrain);
+		}
+		if (tile->terrModel) {
+			tile->terrModel= NULL;
+			nTerrModels--;
+			terrModelBytes-= tile->terrModelBytes;
+			tile->terrModelBytes= 0;
+		}
+		if (tile->models) {
+			tile->models= NULL;
+			nModels--;
+			modelBytes-= tile->modelBytes;
+			tile->modelBytes= 0;
+		}
+		nReleased++;
+	}
+}
@@ -0,0 +1,56 @@
+//	tile residency manager
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include <stddef.h>
+#include <vsg/all.h>
+
+struct MSTSRoute;
+
+//	keeps track of the terrain heights and scene graphs held for each
+//	route tile and releases the least recently visible ones when their
+//	total size goes over a budget
+class ResidencyManager {
+	int frame;
+ public:
+	size_t budget;
+	int interval;		// frames between scans
+	int nTerrain;
+	int nTerrModels;
+	int nModels;
+	size_t terrainBytes;
+	size_t terrModelBytes;
+	size_t modelBytes;
+	int nReleased;
+	ResidencyManager();
+	void update(MSTSRoute* route);
+	size_t totalBytes() {
+		return terrainBytes+terrModelBytes+modelBytes;
+	};
+	static size_t graphBytes(vsg::Node* node);
+};
+extern ResidencyManager residencyManager;
+
+#endif
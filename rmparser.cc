@@ -115,6 +115,18 @@ void RMParser::parseMSTSRoute(string& dir, string& route)
 			} else if (strcasecmp(cmd,"wire") == 0) {
 				mstsRoute->wireHeight= getDouble(1,0,10);
 				mstsRoute->wireModelsDir= tokens[2];
+			} else if (strcasecmp(cmd,"cullratio") == 0) {
+				const char* classes[]= { "track", "static",
+				  "transfer", "forest", "hazard" };
+				int i= 0;
+				for (; i<MSTSRoute::OBJ_NCLASSES; i++)
+					if (strcasecmp(tokens[1].c_str(),
+					  classes[i]) == 0)
+						break;
+				if (i >= MSTSRoute::OBJ_NCLASSES)
+					throw std::invalid_argument(
+					  "unknown object class");
+				mstsRoute->cullRatio[i]= getDouble(2,0,1);
 			} else if (strcasecmp(cmd,"path") == 0) {
 				pathFile= tokens[1];
 			} else if (strcasecmp(cmd,"ignorepolygon") == 0) {
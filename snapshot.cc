@@ -0,0 +1,806 @@
+//	binary snapshots of the simulation state
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+#include <set>
+
+#include "snapshot.h"
+#include "train.h"
+#include "signal.h"
+#include "listener.h"
+#include "ttosim.h"
+#include "mstsroute.h"
+
+using namespace std;
+
+std::string snapshotPath= "vsgts.snap";
+
+static const int snapshotVersion= 2;
+
+//	trains whose ids and pointers are valid while saving
+static unordered_map<Train*,int> liveTrains;
+
+SnapshotFile::SnapshotFile()
+{
+	file= NULL;
+	writing= false;
+	ok= false;
+	sectionStart= -1;
+}
+
+SnapshotFile::~SnapshotFile()
+{
+	if (file)
+		fclose(file);
+}
+
+//	opens a snapshot file and writes or checks the header
+//	also numbers the track edges and vertices
+bool SnapshotFile::open(const char* path, bool write)
+{
+	writing= write;
+	file= fopen(path,write?"wb":"rb");
+	if (!file) {
+		fprintf(stderr,"cannot %s %s\n",write?"create":"open",path);
+		return false;
+	}
+	ok= true;
+	char magic[4];
+	int version= snapshotVersion;
+	if (writing) {
+		fwrite("VTSS",1,4,file);
+	} else if (fread(magic,1,4,file)!=4 || strncmp(magic,"VTSS",4)!=0) {
+		fprintf(stderr,"%s is not a snapshot file\n",path);
+		ok= false;
+		return false;
+	}
+	io(version);
+	if (version != snapshotVersion) {
+		fprintf(stderr,"%s has snapshot version %d\n",path,version);
+		ok= false;
+		return false;
+	}
+	int t= 0;
+	for (TrackMap::iterator i=trackMap.begin(); i!=trackMap.end();
+	  ++i, t++) {
+		Track* track= i->second;
+		edges.push_back(std::vector<Track::Edge*>());
+		vertices.push_back(std::vector<Track::Vertex*>());
+		for (Track::EdgeList::iterator j=track->edgeList.begin();
+		  j!=track->edgeList.end(); ++j) {
+			edgeIndex[*j]= std::make_pair(t,(int)edges[t].size());
+			edges[t].push_back(*j);
+		}
+		for (Track::VertexList::iterator j=track->vertexList.begin();
+		  j!=track->vertexList.end(); ++j) {
+			vertexIndex[*j]=
+			  std::make_pair(t,(int)vertices[t].size());
+			vertices[t].push_back(*j);
+		}
+	}
+	return true;
+}
+
+void SnapshotFile::fail(const char* message)
+{
+	if (ok)
+		fprintf(stderr,"snapshot mismatch: %s\n",message);
+	ok= false;
+}
+
+//	writes or checks a section tag
+//	when writing the previous section's length is filled in and space
+//	is left for this one's, when reading the length is skipped
+bool SnapshotFile::section(const char* tag)
+{
+	char buf[4];
+	memcpy(buf,tag,4);
+	if (writing)
+		endSection();
+	io(buf);
+	if (ok && memcmp(buf,tag,4)!=0)
+		fail(tag);
+	if (ok && writing)
+		sectionStart= ftell(file);
+	int32_t length= 0;
+	io(length);
+	return ok;
+}
+
+//	fills in the length of the section being written
+void SnapshotFile::endSection()
+{
+	if (!ok || sectionStart<0)
+		return;
+	long end= ftell(file);
+	int32_t length= end-sectionStart-sizeof(length);
+	ok= fseek(file,sectionStart,SEEK_SET)==0 &&
+	  fwrite(&length,sizeof(length),1,file)==1 &&
+	  fseek(file,end,SEEK_SET)==0;
+	sectionStart= -1;
+}
+
+//	checks that the rest of the file holds the NULL terminated list of
+//	sections in order and that their lengths add up to the file size
+//	the file position is left where it was
+bool SnapshotFile::checkSections(const char** tags)
+{
+	if (!ok || writing)
+		return ok;
+	long start= ftell(file);
+	fseek(file,0,SEEK_END);
+	long size= ftell(file);
+	long pos= start;
+	for (; *tags!=NULL && ok; tags++) {
+		char buf[4];
+		int32_t length= -1;
+		ok= fseek(file,pos,SEEK_SET)==0;
+		io(buf);
+		io(length);
+		pos+= sizeof(buf)+sizeof(length);
+		if (!ok || memcmp(buf,*tags,4)!=0 || length<0 ||
+		  length>size-pos) {
+			ok= true;
+			fail(*tags);
+		}
+		pos+= length;
+	}
+	if (ok && pos!=size)
+		fail("file length");
+	fseek(file,start,SEEK_SET);
+	return ok;
+}
+
+void SnapshotFile::io(std::string& s)
+{
+	int n= s.size();
+	io(n);
+	if (!ok || writing)
+		ok= ok && fwrite(s.data(),1,n,file)==n;
+	else if (n<0 || n>4096)
+		fail("string length");
+	else {
+		s.resize(n);
+		ok= fread(&s[0],1,n,file)==n;
+	}
+}
+
+void SnapshotFile::io(Track::Edge*& edge)
+{
+	std::pair<int,int> index(-1,-1);
+	if (writing && edge!=NULL) {
+		auto i= edgeIndex.find(edge);
+		if (i != edgeIndex.end())
+			index= i->second;
+	}
+	io(index);
+	if (writing)
+		return;
+	edge= NULL;
+	if (index.first<0)
+		return;
+	if (index.first>=edges.size() ||
+	  index.second>=edges[index.first].size())
+		fail("edge index");
+	else
+		edge= edges[index.first][index.second];
+}
+
+void SnapshotFile::io(Track::Vertex*& vertex)
+{
+	std::pair<int,int> index(-1,-1);
+	if (writing && vertex!=NULL) {
+		auto i= vertexIndex.find(vertex);
+		if (i != vertexIndex.end())
+			index= i->second;
+	}
+	io(index);
+	if (writing)
+		return;
+	vertex= NULL;
+	if (index.first<0)
+		return;
+	if (index.first>=vertices.size() ||
+	  index.second>=vertices[index.first].size())
+		fail("vertex index");
+	else
+		vertex= vertices[index.first][index.second];
+}
+
+void SnapshotFile::io(Track::SwVertex*& sw)
+{
+	Track::Vertex* v= sw;
+	io(v);
+	if (writing)
+		return;
+	if (v!=NULL && v->type!=Track::VT_SWITCH)
+		fail("switch index");
+	else
+		sw= (Track::SwVertex*)v;
+}
+
+void SnapshotFile::io(Track::Location& loc)
+{
+	io(loc.edge);
+	io(loc.offset);
+	io(loc.rev);
+}
+
+//	numbers the nodes of a path in depth first order, main track
+//	before sidings
+std::vector<Track::Path::Node*>& SnapshotFile::getPathNodes(
+  Track::Path* path)
+{
+	auto i= pathNodes.find(path);
+	if (i != pathNodes.end())
+		return i->second;
+	std::vector<Track::Path::Node*>& nodes= pathNodes[path];
+	std::unordered_set<Track::Path::Node*> seen;
+	std::vector<Track::Path::Node*> stack;
+	stack.push_back(path->firstNode);
+	while (stack.size() > 0) {
+		Track::Path::Node* p= stack.back();
+		stack.pop_back();
+		if (p==NULL || seen.find(p)!=seen.end())
+			continue;
+		seen.insert(p);
+		nodes.push_back(p);
+		stack.push_back(p->nextSiding);
+		stack.push_back(p->next);
+	}
+	return nodes;
+}
+
+void SnapshotFile::io(Track::Path* path, Track::Path::Node*& node)
+{
+	int index= -1;
+	if (writing && path!=NULL && node!=NULL) {
+		std::vector<Track::Path::Node*>& nodes= getPathNodes(path);
+		for (int i=0; i<nodes.size(); i++)
+			if (nodes[i] == node)
+				index= i;
+	}
+	io(index);
+	if (writing)
+		return;
+	node= NULL;
+	if (index < 0)
+		return;
+	std::vector<Track::Path::Node*>* nodes= NULL;
+	if (path != NULL)
+		nodes= &getPathNodes(path);
+	if (nodes==NULL || index>=nodes->size())
+		fail("path node");
+	else
+		node= (*nodes)[index];
+}
+
+//	trains are saved by id, only trains still in use are written
+void SnapshotFile::io(Train*& train)
+{
+	int id= -1;
+	if (writing && train!=NULL) {
+		auto i= liveTrains.find(train);
+		if (i != liveTrains.end())
+			id= i->second;
+	}
+	io(id);
+	if (!writing)
+		train= id<0 ? NULL : Train::findTrain(id);
+}
+
+void SnapshotFile::io(RailCarInst*& car)
+{
+	int id= writing && car!=NULL ? car->id : -1;
+	io(id);
+	if (writing)
+		return;
+	car= NULL;
+	if (id < 0)
+		return;
+	auto i= cars.find(id);
+	if (i == cars.end())
+		fail("car id");
+	else
+		car= i->second;
+}
+
+void SnapshotFile::io(Signal*& signal)
+{
+	std::string name;
+	if (writing && signal!=NULL) {
+		for (SignalMap::iterator i=signalMap.begin();
+		  i!=signalMap.end(); ++i)
+			if (i->second == signal)
+				name= i->first;
+	}
+	io(name);
+	if (writing)
+		return;
+	signal= NULL;
+	SignalMap::iterator i= signalMap.find(name);
+	if (i != signalMap.end())
+		signal= i->second;
+}
+
+//	returns every train that might hold cars
+//	trains that aren't visible are kept in trainMap or by the timetable
+static void collectTrains(std::vector<Train*>& trains)
+{
+	std::unordered_set<Train*> seen;
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i)
+		if (seen.insert(*i).second)
+			trains.push_back(*i);
+	for (TrainMap::iterator i=trainMap.begin(); i!=trainMap.end(); ++i)
+		if (seen.insert(i->second).second)
+			trains.push_back(i->second);
+	for (int i=0; timeTable && i<timeTable->getNumTrains(); i++) {
+		AITrain* t= (AITrain*) timeTable->getTrain(i);
+		if (t->consist!=NULL && seen.insert(t->consist).second)
+			trains.push_back(t->consist);
+	}
+}
+
+static void snapshotCar(SnapshotFile& f, RailCarInst* car,
+  bool& brakeNext, bool& brakePrev)
+{
+	f.io(car->rev);
+	f.io(car->mass);
+	f.io(car->massInv);
+	f.io(car->drag0);
+	f.io(car->drag1);
+	f.io(car->grade);
+	f.io(car->curvature);
+	f.io(car->speed);
+	f.io(car->force);
+	f.io(car->drag);
+	f.io(car->slack);
+	f.io(car->maxSlack);
+	f.io(car->couplerState);
+	f.io(car->distance);
+	f.io(car->handBControl);
+	f.io(car->animState);
+	int n= car->wheels.size();
+	f.io(n);
+	if (n != car->wheels.size()) {
+		f.fail("wheel count");
+		return;
+	}
+	for (int i=0; i<n; i++) {
+		f.io(car->wheels[i].location);
+		f.io(car->wheels[i].state);
+	}
+	bool hasAirBrake= car->airBrake!=NULL;
+	f.io(hasAirBrake);
+	if (hasAirBrake != (car->airBrake!=NULL)) {
+		f.fail("air brake");
+		return;
+	}
+	if (car->airBrake == NULL)
+		return;
+	if (f.isWriting()) {
+		brakeNext= car->next!=NULL &&
+		  car->airBrake->getNext()==car->next->airBrake;
+		brakePrev= car->prev!=NULL &&
+		  car->airBrake->getPrev()==car->prev->airBrake;
+	}
+	f.io(brakeNext);
+	f.io(brakePrev);
+	bool nextOpen= car->airBrake->getNextOpen();
+	bool prevOpen= car->airBrake->getPrevOpen();
+	f.io(nextOpen);
+	f.io(prevOpen);
+	if (!f.isWriting()) {
+		car->airBrake->setNextOpen(nextOpen);
+		car->airBrake->setPrevOpen(prevOpen);
+	}
+	car->airBrake->snapshot(f);
+}
+
+//	saves or restores a train's controls, location and cars
+//	when restoring the cars are relinked in the saved order
+static void snapshotTrain(SnapshotFile& f, Train* t)
+{
+	f.io(t->name);
+	f.io(t->location);
+	f.io(t->endLocation);
+	f.io(t->speed);
+	f.io(t->accel);
+	f.io(t->positionError);
+	f.io(t->dControl);
+	f.io(t->tControl);
+	f.io(t->bControl);
+	f.io(t->engBControl);
+	f.io(t->mass);
+	f.io(t->length);
+	f.io(t->drag0);
+	f.io(t->drag1);
+	f.io(t->drag2);
+	f.io(t->maxBForce);
+	f.io(t->maxCForce);
+	f.io(t->moving);
+	f.io(t->modelCouplerSlack);
+	f.io(t->remoteControl);
+	f.io(t->targetSpeed);
+	f.io(t->maxTargetSpeed);
+	f.io(t->decelMult);
+	f.io(t->accelMult);
+	f.io(t->maxAccel);
+	f.io(t->maxDecel);
+	f.io(t->nextStopDist);
+	f.io(t->nextStopTime);
+	f.io(t->simLevel);
+	f.io(t->simDt);
+	f.io(t->airBControl);
+	int n= t->signalList.size();
+	f.io(n);
+	SigDistList::iterator si= t->signalList.begin();
+	if (!f.isWriting())
+		t->signalList.clear();
+	for (int i=0; i<n && f.good(); i++) {
+		Signal* signal= f.isWriting() ? si->first : NULL;
+		float d= f.isWriting() ? si->second : 0;
+		f.io(signal);
+		f.io(d);
+		if (f.isWriting())
+			++si;
+		else if (signal != NULL)
+			t->signalList.push_back(std::make_pair(signal,d));
+	}
+	n= 0;
+	int engIndex= -1;
+	for (RailCarInst* car=t->firstCar; car!=NULL; car=car->next, n++)
+		if (t->engAirBrake!=NULL && car->airBrake==t->engAirBrake)
+			engIndex= n;
+	f.io(n);
+	f.io(engIndex);
+	std::vector<RailCarInst*> cars;
+	std::vector<char> brakeLinks;
+	RailCarInst* car= t->firstCar;
+	for (int i=0; i<n && f.good(); i++) {
+		f.io(car);
+		if (car == NULL) {
+			f.fail("train car");
+			return;
+		}
+		cars.push_back(car);
+		bool brakeNext= false;
+		bool brakePrev= false;
+		snapshotCar(f,car,brakeNext,brakePrev);
+		brakeLinks.push_back(brakeNext | (brakePrev<<1));
+		car= f.isWriting() ? car->next : NULL;
+	}
+	if (f.isWriting() || !f.good())
+		return;
+	t->firstCar= n>0 ? cars[0] : NULL;
+	t->lastCar= n>0 ? cars[n-1] : NULL;
+	t->engAirBrake= NULL;
+	for (int i=0; i<n; i++) {
+		car= cars[i];
+		car->prev= i>0 ? cars[i-1] : NULL;
+		car->next= i<n-1 ? cars[i+1] : NULL;
+		car->poseValid= false;
+	}
+	for (int i=0; i<n; i++) {
+		car= cars[i];
+		if (car->airBrake == NULL)
+			continue;
+		car->airBrake->setNext((brakeLinks[i]&1) && car->next ?
+		  car->next->airBrake : NULL);
+		car->airBrake->setPrev((brakeLinks[i]&2) && car->prev ?
+		  car->prev->airBrake : NULL);
+		if (i == engIndex)
+			t->engAirBrake=
+			  dynamic_cast<EngAirBrake*>(car->airBrake);
+	}
+}
+
+//	saves or restores switch positions and signal states
+static void snapshotTrack(SnapshotFile& f)
+{
+	f.section("SWCH");
+	for (TrackMap::iterator i=trackMap.begin(); i!=trackMap.end(); ++i) {
+		Track* track= i->second;
+		int n= track->swVertexList.size();
+		f.io(n);
+		if (n != track->swVertexList.size()) {
+			f.fail("switch count");
+			return;
+		}
+		for (int j=0; j<n; j++) {
+			Track::SwVertex* sw= track->swVertexList[j];
+			int k= sw->edge2==sw->swEdges[1] ? 1 : 0;
+			f.io(k);
+			f.io(sw->locked);
+			if (!f.isWriting() && sw->edge2!=sw->swEdges[k]) {
+				sw->edge2= sw->swEdges[k];
+				queueSwitchAnimation(sw);
+			}
+		}
+	}
+	f.section("SIGS");
+	int n= signalMap.size();
+	f.io(n);
+	SignalMap::iterator si= signalMap.begin();
+	for (int i=0; i<n && f.good(); i++) {
+		std::string name= f.isWriting() ? si->first : "";
+		int state= f.isWriting() ? si->second->getState() : 0;
+		f.io(name);
+		f.io(state);
+		if (f.isWriting()) {
+			++si;
+			continue;
+		}
+		SignalMap::iterator j= signalMap.find(name);
+		if (j != signalMap.end())
+			j->second->setState(state);
+	}
+}
+
+//	saves or checks a count that restoring depends on
+static void snapshotCount(SnapshotFile& f, int n, const char* what)
+{
+	int m= n;
+	f.io(m);
+	if (m != n)
+		f.fail(what);
+}
+
+//	saves or checks the track, car and timetable sizes the other
+//	sections assume, so a snapshot of a different route, consist or
+//	timetable is rejected before any state is replaced
+static void snapshotInfo(SnapshotFile& f, std::vector<Train*>& trains)
+{
+	f.section("INFO");
+	snapshotCount(f,trackMap.size(),"track count");
+	for (TrackMap::iterator i=trackMap.begin();
+	  i!=trackMap.end() && f.good(); ++i) {
+		Track* track= i->second;
+		snapshotCount(f,track->edgeList.size(),"edge count");
+		snapshotCount(f,track->vertexList.size(),"vertex count");
+		snapshotCount(f,track->swVertexList.size(),"switch count");
+	}
+	std::vector<RailCarInst*> cars;
+	for (int i=0; i<trains.size(); i++)
+		for (RailCarInst* car=trains[i]->firstCar; car!=NULL;
+		  car=car->next)
+			cars.push_back(car);
+	int n= cars.size();
+	f.io(n);
+	for (int i=0; i<n && f.good(); i++) {
+		RailCarInst* car= f.isWriting() ? cars[i] : NULL;
+		f.io(car);
+		if (car == NULL) {
+			f.fail("car id");
+			return;
+		}
+		snapshotCount(f,car->wheels.size(),"wheel count");
+		snapshotCount(f,car->airBrake ? car->airBrake->getNumTanks() : -1,
+		  "air brake tank count");
+	}
+	bool hasTimeTable= timeTable!=NULL;
+	f.io(hasTimeTable);
+	if (hasTimeTable != (timeTable!=NULL)) {
+		f.fail("timetable");
+		return;
+	}
+	if (!hasTimeTable)
+		return;
+	snapshotCount(f,timeTable->getNumTrains(),"timetable train count");
+	for (int j=0; j<timeTable->getNumTrains() && f.good(); j++)
+		snapshotCount(f,timeTable->getTrain(j)->getTimes().size(),
+		  "timetable rows");
+	snapshotCount(f,timeTable->getNumBlocks(),"timetable block count");
+}
+
+//	saves or restores which activity events haven't fired yet
+static void snapshotEvents(SnapshotFile& f)
+{
+	f.section("EVTS");
+	int n= mstsRoute ? mstsRoute->eventMap.size() : 0;
+	f.io(n);
+	if (f.isWriting()) {
+		if (mstsRoute == NULL)
+			return;
+		for (MSTSRoute::EventMap::iterator i=
+		  mstsRoute->eventMap.begin(); i!=mstsRoute->eventMap.end();
+		  ++i) {
+			int id= i->first;
+			f.io(id);
+		}
+		return;
+	}
+	std::set<int> pending;
+	for (int i=0; i<n && f.good(); i++) {
+		int id= -1;
+		f.io(id);
+		pending.insert(id);
+	}
+	if (f.good() && mstsRoute)
+		mstsRoute->resetActivityEvents(&pending);
+}
+
+//	sections in the order saveSnapshot writes them
+static const char* sectionTags[]= {
+	"INFO", "TRNS", "SWCH", "SIGS", "EVTS", "TTOS", "END ", NULL
+};
+
+//	writes the simulation state to a file
+bool saveSnapshot(const char* path)
+{
+	auto startTime= std::chrono::steady_clock::now();
+	SnapshotFile f;
+	if (!f.open(path,true))
+		return false;
+	std::vector<Train*> trains;
+	collectTrains(trains);
+	liveTrains.clear();
+	for (int i=0; i<trains.size(); i++)
+		liveTrains[trains[i]]= trains[i]->id;
+	f.io(simTime);
+	snapshotInfo(f,trains);
+	f.section("TRNS");
+	int n= trains.size();
+	f.io(n);
+	for (int i=0; i<n; i++) {
+		Train* t= trains[i];
+		bool listed= find(trainList.begin(),trainList.end(),t) !=
+		  trainList.end();
+		f.io(t->id);
+		f.io(listed);
+		snapshotTrain(f,t);
+	}
+	n= trainMap.size();
+	f.io(n);
+	for (TrainMap::iterator i=trainMap.begin(); i!=trainMap.end(); ++i) {
+		std::string name= i->first;
+		f.io(name);
+		f.io(i->second);
+	}
+	f.io(myTrain);
+	f.io(following);
+	f.io(riding);
+	f.io(myRailCar);
+	snapshotTrack(f);
+	snapshotEvents(f);
+	f.section("TTOS");
+	ttoSim.snapshot(f);
+	f.section("END ");
+	liveTrains.clear();
+	double t= std::chrono::duration<double>(
+	  std::chrono::steady_clock::now()-startTime).count();
+	fprintf(stderr,"saved %s %d trains %.3fms\n",
+	  path,(int)trains.size(),1000*t);
+	return f.good();
+}
+
+//	restores the simulation state saved by saveSnapshot
+//	the same route and activity or timetable must already be loaded
+//	so that every saved car exists, the cars are then regrouped into
+//	the saved trains and the track, dispatcher and timetable state
+//	are replaced
+//	the section framing and the INFO counts are checked first so that
+//	nothing is changed if the file doesn't match
+bool loadSnapshot(const char* path)
+{
+	auto startTime= std::chrono::steady_clock::now();
+	SnapshotFile f;
+	if (!f.open(path,false))
+		return false;
+	std::vector<Train*> oldTrains;
+	collectTrains(oldTrains);
+	for (int i=0; i<oldTrains.size(); i++) {
+		Train* t= oldTrains[i];
+		for (RailCarInst* car=t->firstCar; car!=NULL; car=car->next)
+			f.cars[car->id]= car;
+	}
+	double time= 0;
+	f.io(time);
+	if (!f.checkSections(sectionTags))
+		return false;
+	snapshotInfo(f,oldTrains);
+	if (!f.section("TRNS"))
+		return false;
+	simTime= time;
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i)
+		listener.removeTrain(*i);
+	for (int i=0; i<oldTrains.size(); i++) {
+		Train* t= oldTrains[i];
+		t->removeFromEdgeIndex();
+		t->firstCar= NULL;
+		t->lastCar= NULL;
+		t->engAirBrake= NULL;
+	}
+	trainList.clear();
+	trainMap.clear();
+	int n= 0;
+	f.io(n);
+	std::unordered_set<Train*> restored;
+	for (int i=0; i<n && f.good(); i++) {
+		int id= -1;
+		bool listed= false;
+		f.io(id);
+		f.io(listed);
+		Train* t= Train::findTrain(id);
+		if (t == NULL)
+			t= new Train(id);
+		snapshotTrain(f,t);
+		restored.insert(t);
+		if (listed)
+			trainList.push_back(t);
+	}
+	f.io(n);
+	for (int i=0; i<n && f.good(); i++) {
+		std::string name;
+		Train* t= NULL;
+		f.io(name);
+		f.io(t);
+		if (t != NULL)
+			trainMap[name]= t;
+	}
+	for (int i=0; i<oldTrains.size(); i++)
+		if (restored.find(oldTrains[i]) == restored.end())
+			delete oldTrains[i];
+	selectedTrain= NULL;
+	selectedRailCar= NULL;
+	f.io(myTrain);
+	f.io(following);
+	f.io(riding);
+	f.io(myRailCar);
+	snapshotTrack(f);
+	for (TrackMap::iterator i=trackMap.begin(); i!=trackMap.end(); ++i) {
+		Track* track= i->second;
+		for (Track::EdgeList::iterator j=track->edgeList.begin();
+		  j!=track->edgeList.end(); ++j)
+			(*j)->occupied= 0;
+		for (Track::VertexList::iterator j=track->vertexList.begin();
+		  j!=track->vertexList.end(); ++j)
+			(*j)->occupied= 0;
+	}
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i) {
+		Train* t= *i;
+		t->setOccupied();
+		t->updateEdgeIndex();
+		t->setModelsOn();
+		listener.addTrain(t);
+	}
+	for (std::unordered_set<Train*>::iterator i=restored.begin();
+	  i!=restored.end(); ++i)
+		if (find(trainList.begin(),trainList.end(),*i) ==
+		  trainList.end())
+			(*i)->setModelsOff();
+	for (SignalMap::iterator i=signalMap.begin(); i!=signalMap.end(); ++i)
+		i->second->update();
+	snapshotEvents(f);
+	f.section("TTOS");
+	ttoSim.snapshot(f);
+	f.section("END ");
+	double t= std::chrono::duration<double>(
+	  std::chrono::steady_clock::now()-startTime).count();
+	fprintf(stderr,"loaded %s %d trains %.3fms\n",
+	  path,(int)restored.size(),1000*t);
+	return f.good();
+}
@@ -0,0 +1,91 @@
+//	binary snapshots of the simulation state
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "track.h"
+
+struct Train;
+struct RailCarInst;
+class Signal;
+
+//	reads or writes a snapshot file
+//	state is moved with io() so the same code saves and restores it
+//	pointers to track, trains, cars and signals are stored as indexes,
+//	ids or names and are looked up again when restoring
+//	file format: "VTSS", version, simulation time, then sections each
+//	starting with a four character tag and the section's length
+class SnapshotFile {
+	FILE* file;
+	bool writing;
+	bool ok;
+	long sectionStart;
+	void endSection();
+	std::vector<std::vector<Track::Edge*> > edges;
+	std::vector<std::vector<Track::Vertex*> > vertices;
+	std::unordered_map<Track::Edge*,std::pair<int,int> > edgeIndex;
+	std::unordered_map<Track::Vertex*,std::pair<int,int> > vertexIndex;
+	std::unordered_map<Track::Path*,std::vector<Track::Path::Node*> >
+	  pathNodes;
+	std::vector<Track::Path::Node*>& getPathNodes(Track::Path* path);
+ public:
+	std::unordered_map<int,RailCarInst*> cars;
+	SnapshotFile();
+	~SnapshotFile();
+	bool open(const char* path, bool write);
+	bool isWriting() { return writing; };
+	bool good() { return ok; };
+	void fail(const char* message);
+	template <class T> void io(T& value) {
+		if (!ok)
+			return;
+		if (writing)
+			ok= fwrite(&value,sizeof(T),1,file)==1;
+		else
+			ok= fread(&value,sizeof(T),1,file)==1;
+	};
+	void io(std::string& s);
+	void io(Track::Location& loc);
+	void io(Track::Edge*& edge);
+	void io(Track::Vertex*& vertex);
+	void io(Track::SwVertex*& sw);
+	void io(Track::Path* path, Track::Path::Node*& node);
+	void io(Train*& train);
+	void io(RailCarInst*& car);
+	void io(Signal*& signal);
+	bool section(const char* tag);
+	bool checkSections(const char** tags);
+};
+
+extern std::string snapshotPath;
+bool saveSnapshot(const char* path);
+bool loadSnapshot(const char* path);
+
+#endif
@@ -31,18 +31,62 @@ template <class T> class Spline {
 	std::vector<T> x;
 	std::vector<T> y;
 	std::vector<T> y2;
+	std::vector<T> table;	// uniform samples used after bake
+	T tableX0;
+	T tableScale;
+	T tableError;		// largest error allowed by bake
 	int loIndex;
+	T exact(T vx) {
+		int i= 0;
+		int j= x.size()-1;
+		if (j < i)
+			return 0;
+		if (j == i)
+			return y[0];
+		while (j-i > 1) {
+			int k= (i+j)/2;
+			if (x[k] > vx)
+				j= k;
+			else
+				i= k;
+		}
+		T d= x[j]-x[i];
+		T a= (x[j]-vx)/d;
+		T b= (vx-x[i])/d;
+		T vy= a*y[i] + b*y[j];
+		if (y2.size()>0 && a>=0 && b>=0)
+			vy+= ((a*a*a-a)*y2[i] + (b*b*b-b)*y2[j])*(d*d)/6;
+		return vy;
+	}
+	T lookup(T vx) {
+		if (vx<x[0] || vx>x[x.size()-1])
+			return exact(vx);
+		T u= (vx-tableX0)*tableScale;
+		int n= table.size()-1;
+		if (u < 0)
+			u= 0;
+		else if (u > n)
+			u= n;
+		int i= (int)u;
+		if (i >= n)
+			i= n-1;
+		T f= u-i;
+		return table[i] + f*(table[i+1]-table[i]);
+	}
  public:
-	Spline() { loIndex= 0; }
+	Spline() { loIndex= 0; tableError= 0; }
 	void clear() {
 		x.clear();
 		y.clear();
+		table.clear();
 	}
 	void add(T nx, T ny) {
 		x.push_back(nx);
 		y.push_back(ny);
+		table.clear();
 	}
 	void compute(T yp1=1e30, T yp2=1e30) {
+		table.clear();
 		int n= x.size();
 		if (n <= 0)
 			return;
@@ -78,27 +122,81 @@ template <class T> class Spline {
 	T getMinX() { return x[0]; }
 	T getMaxX() { return x[x.size()-1]; }
 	T operator()(T vx) {
-		int i= 0;
-		int j= x.size()-1;
-		if (j < i)
-			return 0;
-		if (j == i)
-			return y[0];
-		while (j-i > 1) {
-			int k= (i+j)/2;
-			if (x[k] > vx)
-				j= k;
-			else
-				i= k;
+		if (table.size() > 0)
+			return lookup(vx);
+		return exact(vx);
+	}
+	//	evaluates the spline at n points
+	//	the baked loop has no branches or searches so it can vectorize,
+	//	points outside the table are evaluated exactly afterwards
+	void evaluate(const T* vx, T* vy, int n) {
+		if (table.size() == 0) {
+			for (int i=0; i<n; i++)
+				vy[i]= exact(vx[i]);
+			return;
 		}
-		T d= x[j]-x[i];
-		T a= (x[j]-vx)/d;
-		T b= (vx-x[i])/d;
-		T vy= a*y[i] + b*y[j];
-		if (y2.size()>0 && a>=0 && b>=0)
-			vy+= ((a*a*a-a)*y2[i] + (b*b*b-b)*y2[j])*(d*d)/6;
-		return vy;
+		int m= table.size()-1;
+		const T* tab= &table[0];
+		for (int i=0; i<n; i++) {
+			T u= (vx[i]-tableX0)*tableScale;
+			T uc= u<0 ? 0 : u>m ? m : u;
+			int j= (int)uc;
+			j= j<m ? j : m-1;
+			T f= uc-j;
+			vy[i]= tab[j] + f*(tab[j+1]-tab[j]);
+		}
+		for (int i=0; i<n; i++)
+			if (vx[i]<x[0] || vx[i]>x[x.size()-1])
+				vy[i]= exact(vx[i]);
+	}
+	//	replaces the search and cubic evaluation with linear
+	//	interpolation in a uniform table of samples
+	//	the table is doubled until the error at points between samples
+	//	is less than half of maxError times the largest y value, which
+	//	leaves room for larger errors between the points checked
+	//	returns false and keeps the exact evaluation if maxSize samples
+	//	are not enough
+	bool bake(T maxError=1e-3, int maxSize=4096) {
+		table.clear();
+		int np= x.size();
+		if (np<2 || x[np-1]<=x[0])
+			return false;
+		T ymax= 0;
+		for (int i=0; i<np; i++)
+			if (ymax < (y[i]<0?-y[i]:y[i]))
+				ymax= y[i]<0?-y[i]:y[i];
+		T tol= maxError*(ymax>0?ymax:1);
+		std::vector<T> samples;
+		for (int n=4*np; n<=maxSize; n*=2) {
+			T dx= (x[np-1]-x[0])/n;
+			samples.resize(n+1);
+			for (int i=0; i<=n; i++)
+				samples[i]= exact(x[0]+i*dx);
+			bool ok= true;
+			for (int i=0; i<n && ok; i++) {
+				for (int j=1; j<4; j++) {
+					T f= .25*j;
+					T e= exact(x[0]+(i+f)*dx) -
+					  (samples[i]+f*(samples[i+1]-samples[i]));
+					if (e>.5*tol || e<-.5*tol) {
+						ok= false;
+						break;
+					}
+				}
+			}
+			if (ok) {
+				table.swap(samples);
+				tableX0= x[0];
+				tableScale= n/(x[np-1]-x[0]);
+				tableError= tol;
+				return true;
+			}
+		}
+		return false;
 	}
+	bool isBaked() { return table.size() > 0; }
+	T getBakeError() { return table.size()>0 ? tableError : 0; }
+	void unbake() { table.clear(); }
 	void copy(Spline<T>& from, T xMult, T yMult) { 
 		int n= from.x.size();
 		x.reserve(n);
@@ -125,12 +223,14 @@ template <class T> class Spline {
 	void scaleX(T m) {
 		for (int i=0; i<x.size(); i++)
 			x[i]*= m;
+		table.clear();
 	}
 	void scaleY(T m) {
 		for (int i=0; i<y.size(); i++)
 			y[i]*= m;
 		for (int i=0; i<y2.size(); i++)
 			y2[i]*= m;
+		table.clear();
 	}
 };
 
@@ -32,6 +32,12 @@ void Switcher::update()
 	if (train==NULL || train->speed!=0 ||
 	  train->tControl>0 || train->bControl<1)
 		return;
+	if (plan == NULL) {
+		plan= new SwitchPlan;
+		plan->plan(this);
+	}
+	if (targetCar == NULL)
+		findPlannedCar();
 	if (targetCar == NULL)
 		findSetoutCar();
 	if (targetCar == NULL)
@@ -313,6 +319,29 @@ void Switcher::findSPT(Track::Vertex* avoid, bool fix)
 	}
 }
 
+//	takes the next car from the switching plan
+//	steps that no longer apply because the car was already delivered
+//	or can't be reached are skipped
+void Switcher::findPlannedCar()
+{
+	targetCar= NULL;
+	targetTrain= NULL;
+	while (plan->next < plan->steps.size()) {
+		SwitchPlan::Step& step= plan->steps[plan->next++];
+		if (step.destination.edge==NULL || step.car->waybill==NULL)
+			continue;
+		Train* t= findTrain(step.car);
+		if (t==NULL || findCarDist(step.destination,step.car,t)<0)
+			continue;
+		targetCar= step.car;
+		targetTrain= t;
+		destination= step.destination;
+		fprintf(stderr,"planned step %d %s\n",plan->next,
+		  targetCar->waybill->destination.c_str());
+		return;
+	}
+}
+
 void Switcher::findSetoutCar()
 {
 	targetCar= NULL;
@@ -24,6 +24,8 @@ THE SOFTWARE.
 
 #include <string>
 
+#include "switchplan.h"
+
 struct Switcher {
 	Track* track;
 	Train* train;
@@ -32,14 +34,20 @@ struct Switcher {
 	Track::Location destination;
 	int moves;
 	float targetSpeed;
+	SwitchPlan* plan;
 	Switcher(Train* t) {
 		moves= 0;
 		train= t;
 		track= t->location.edge->track;
 		targetCar= NULL;
 		targetSpeed= t->targetSpeed;
+		plan= NULL;
+	};
+	~Switcher() {
+		delete plan;
 	};
 	void update();
+	void findPlannedCar();
 	void findSetoutCar();
 	void findPickupCar();
 	float uncoupledLength();
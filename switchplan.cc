@@ -0,0 +1,399 @@
+//	search based switching move planner
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <map>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+
+#include "train.h"
+#include "switcher.h"
+#include "switchplan.h"
+
+//	fixed cost of a coupling or uncoupling stop in meters of travel
+#define STOPCOST 100
+
+std::string SwitchPlan::State::key()
+{
+	std::string k;
+	k.reserve(2*(consist.size()+carTrack.size()+tracks.size()+2));
+	k.append((char*)&loco,sizeof(short));
+	k.append((char*)consist.data(),consist.size()*sizeof(short));
+	short sep= -1;
+	for (int i=0; i<tracks.size(); i++) {
+		k.append((char*)&sep,sizeof(short));
+		k.append((char*)tracks[i].data(),tracks[i].size()*sizeof(short));
+	}
+	return k;
+}
+
+int SwitchPlan::addTrack(Track::SSEdge* sse)
+{
+	for (int i=0; i<trackList.size(); i++)
+		if (trackList[i] == sse)
+			return i;
+	trackList.push_back(sse);
+	capacity.push_back(1e10);
+	goalLocation.push_back(Track::Location());
+	return trackList.size()-1;
+}
+
+//	finds the travel distance between every pair of model tracks
+//	using a shortest path search over the switch to switch edges
+//	run once per plan instead of once per move
+void SwitchPlan::findMoveCosts()
+{
+	int n= trackList.size();
+	moveCost.resize(n*n);
+	typedef std::pair<float,Track::Vertex*> QueueEntry;
+	for (int i=0; i<n; i++) {
+		std::map<Track::Vertex*,float> dist;
+		std::priority_queue<QueueEntry,std::vector<QueueEntry>,
+		  std::greater<QueueEntry> > queue;
+		Track::SSEdge* sse= trackList[i];
+		dist[sse->v1]= 0;
+		dist[sse->v2]= 0;
+		queue.push(QueueEntry(0,sse->v1));
+		queue.push(QueueEntry(0,sse->v2));
+		while (queue.size() > 0) {
+			float d= queue.top().first;
+			Track::Vertex* v= queue.top().second;
+			queue.pop();
+			if (d>dist[v] || v->type!=Track::VT_SWITCH)
+				continue;
+			Track::SwVertex* sw= (Track::SwVertex*)v;
+			for (int j=0; j<3; j++) {
+				Track::SSEdge* e= sw->ssEdges[j];
+				if (e == NULL)
+					continue;
+				Track::Vertex* v2= e->otherV(v);
+				float d2= d+e->length;
+				std::map<Track::Vertex*,float>::iterator k=
+				  dist.find(v2);
+				if (k!=dist.end() && k->second<=d2)
+					continue;
+				dist[v2]= d2;
+				queue.push(QueueEntry(d2,v2));
+			}
+		}
+		for (int j=0; j<n; j++) {
+			float d= 1e10;
+			if (i == j) {
+				d= 0;
+			} else {
+				Track::SSEdge* e= trackList[j];
+				std::map<Track::Vertex*,float>::iterator k=
+				  dist.find(e->v1);
+				if (k != dist.end())
+					d= k->second;
+				k= dist.find(e->v2);
+				if (k!=dist.end() && d>k->second)
+					d= k->second;
+				if (d < 1e10)
+					d+= (sse->length+e->length)/2;
+			}
+			moveCost[i*n+j]= d;
+		}
+	}
+}
+
+//	lower bound on the remaining cost
+//	each track that has to receive cars needs a setout stop and each
+//	track that still holds misplaced cars needs a pickup stop
+float SwitchPlan::estimate(State& s)
+{
+	std::vector<char> setout(trackList.size(),0);
+	std::vector<char> pickup(trackList.size(),0);
+	int n= 0;
+	for (int i=0; i<carList.size(); i++) {
+		if (!misplaced(s,i))
+			continue;
+		if (!setout[carGoal[i]]) {
+			setout[carGoal[i]]= 1;
+			n++;
+		}
+		int t= s.carTrack[i];
+		if (t>=0 && !pickup[t]) {
+			pickup[t]= 1;
+			n++;
+		}
+	}
+	return n*STOPCOST;
+}
+
+//	moves car to its goal track along with any cars next to it that
+//	go to the same track
+//	the car's track is coupled first if needed and any cars behind
+//	it that go elsewhere are left on the track the loco is on
+//	returns false if the move isn't possible
+bool SwitchPlan::move(State& s, int car, State& r)
+{
+	int goal= carGoal[car];
+	r= s;
+	r.car= car;
+	r.goal= goal;
+	float c= 0;
+	int at= s.loco;
+	if (r.carTrack[car] >= 0) {
+		int t= r.carTrack[car];
+		c+= cost(at,t)+STOPCOST;
+		for (int i=0; i<r.tracks[t].size(); i++) {
+			int j= r.tracks[t][i];
+			r.consist.push_back(j);
+			r.carTrack[j]= -1;
+			r.used[t]-= carLength[j];
+		}
+		r.tracks[t].clear();
+		at= t;
+	}
+	int pos= 0;
+	while (r.consist[pos] != car)
+		pos++;
+	int n= r.consist.size();
+	int end= pos+1;
+	while (end<n && carGoal[r.consist[end]]==goal)
+		end++;
+	if (end < n) {
+		float len= 0;
+		for (int i=end; i<n; i++)
+			len+= carLength[r.consist[i]];
+		if (r.used[at]+len > capacity[at])
+			return false;
+		for (int i=end; i<n; i++) {
+			int j= r.consist[i];
+			r.tracks[at].push_back(j);
+			r.carTrack[j]= at;
+		}
+		r.used[at]+= len;
+		r.consist.resize(end);
+		c+= STOPCOST;
+	}
+	int start= pos;
+	while (start>0 && carGoal[r.consist[start-1]]==goal)
+		start--;
+	float len= 0;
+	for (int i=start; i<end; i++)
+		len+= carLength[r.consist[i]];
+	if (cost(at,goal)>=1e10 || r.used[goal]+len>capacity[goal])
+		return false;
+	c+= cost(at,goal)+STOPCOST;
+	for (int i=start; i<end; i++) {
+		int j= r.consist[i];
+		r.tracks[goal].push_back(j);
+		r.carTrack[j]= goal;
+	}
+	r.used[goal]+= len;
+	r.consist.resize(start);
+	r.loco= goal;
+	r.cost= s.cost+c;
+	return true;
+}
+
+//	builds the yard model from the current train list and searches
+//	for the lowest cost order of moves
+//	the beam keeps the beamWidth best states at each depth ranked by
+//	cost plus estimate, and states already reached at a lower cost
+//	are dropped
+//	only the beam's states are kept whole, earlier moves are kept in
+//	history
+void SwitchPlan::plan(Switcher* switcher)
+{
+	auto startTime= std::chrono::steady_clock::now();
+	Train* train= switcher->train;
+	Track* track= switcher->track;
+	steps.clear();
+	next= 0;
+	nStates= 0;
+	trackList.clear();
+	carList.clear();
+	carGoal.clear();
+	carLength.clear();
+	capacity.clear();
+	goalLocation.clear();
+	Track::Location anchor;
+	anchor.edge= NULL;
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i)
+		for (RailCarInst* car=(*i)->firstCar; car!=NULL; car=car->next)
+			if (car->waybill!=NULL && car->waybill->priority==0 &&
+			  car->waybill->destination==train->name)
+				anchor= car->wheels[0].location;
+	int loco= addTrack(train->location.edge->ssEdge);
+	std::vector<short> carTrack;
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i) {
+		Train* t= *i;
+		bool hasEngine= false;
+		for (RailCarInst* car=t->firstCar; car!=NULL; car=car->next)
+			if (t!=train && switcher->isEngine(car))
+				hasEngine= true;
+		if (hasEngine)
+			continue;
+		int tt= t==train ? -1 : addTrack(t->location.edge->ssEdge);
+		for (RailCarInst* car=t->firstCar; car!=NULL; car=car->next) {
+			if (t==train && switcher->isEngine(car))
+				continue;
+			int goal= -1;
+			Waybill* wb= car->waybill;
+			Track::Location loc;
+			loc.edge= NULL;
+			if (wb!=NULL && wb->priority==0) {
+				goal= tt;
+				loc= car->wheels[0].location;
+			} else if (wb!=NULL && wb->destination==train->name) {
+				if (anchor.edge != NULL)
+					goal= addTrack(anchor.edge->ssEdge);
+				loc= anchor;
+			} else if (wb!=NULL &&
+			  track->findLocation(wb->destination,&loc)) {
+				goal= addTrack(loc.edge->ssEdge);
+				Track::Location loc1;
+				Track::Location loc2;
+				if (track->findLocation(wb->destination,0,&loc1) &&
+				  track->findLocation(wb->destination,1,&loc2))
+					capacity[goal]= fabs(loc1.dDistance(&loc2));
+			}
+			if (goal>=0 && goalLocation[goal].edge==NULL)
+				goalLocation[goal]= loc;
+			carList.push_back(car);
+			carGoal.push_back(goal);
+			carLength.push_back(car->def->length);
+			carTrack.push_back(tt);
+		}
+	}
+	int nTracks= trackList.size();
+	int nCars= carList.size();
+	findMoveCosts();
+	history.clear();
+	State s0;
+	s0.loco= loco;
+	s0.carTrack= carTrack;
+	s0.tracks.resize(nTracks);
+	s0.used.resize(nTracks,0);
+	for (int i=0; i<nCars; i++) {
+		if (carTrack[i] < 0) {
+			s0.consist.push_back(i);
+		} else {
+			s0.tracks[carTrack[i]].push_back(i);
+			s0.used[carTrack[i]]+= carLength[i];
+		}
+	}
+	for (int i=0; i<nTracks; i++)
+		if (capacity[i] < s0.used[i])
+			capacity[i]= s0.used[i];
+	s0.cost= 0;
+	s0.node= -1;
+	s0.car= -1;
+	s0.goal= -1;
+	int nMisplaced= 0;
+	for (int i=0; i<nCars; i++)
+		if (misplaced(s0,i))
+			nMisplaced++;
+	//	states are remembered by a hash of their key
+	std::hash<std::string> hashKey;
+	std::unordered_map<size_t,float> seen;
+	seen[hashKey(s0.key())]= 0;
+	std::vector<State> beam;
+	beam.push_back(s0);
+	int best= -1;
+	float bestCost= 0;
+	int bestPartial= -1;
+	float bestPartialEst= estimate(s0);
+	float bestPartialCost= 0;
+	//	candidates are ranked by cost plus estimate and identified by
+	//	beam index times nCars plus car, the survivors' states are made
+	//	again from their parents in the beam
+	typedef std::pair<float,int> Candidate;
+	std::vector<Candidate> candidates;
+	State r;
+	for (int depth=0; depth<2*nMisplaced+4 && beam.size()>0; depth++) {
+		candidates.clear();
+		for (int b=0; b<beam.size(); b++) {
+			for (int i=0; i<nCars; i++) {
+				if (!misplaced(beam[b],i))
+					continue;
+				if (!move(beam[b],i,r))
+					continue;
+				size_t k= hashKey(r.key());
+				std::unordered_map<size_t,float>::iterator
+				  j= seen.find(k);
+				if (j!=seen.end() && j->second<=r.cost)
+					continue;
+				seen[k]= r.cost;
+				nStates++;
+				float est= estimate(r);
+				if (est == 0) {
+					if (best<0 || r.cost<bestCost) {
+						history.push_back(Node{beam[b].node,
+						  r.car,r.goal});
+						best= history.size()-1;
+						bestCost= r.cost;
+					}
+					continue;
+				}
+				if (est<bestPartialEst || (est==bestPartialEst &&
+				  r.cost<bestPartialCost)) {
+					history.push_back(Node{beam[b].node,
+					  r.car,r.goal});
+					bestPartial= history.size()-1;
+					bestPartialEst= est;
+					bestPartialCost= r.cost;
+				}
+				candidates.push_back(
+				  Candidate(r.cost+est,b*nCars+i));
+			}
+		}
+		if (candidates.size() > beamWidth) {
+			std::partial_sort(candidates.begin(),
+			  candidates.begin()+beamWidth,candidates.end());
+			candidates.resize(beamWidth);
+		} else {
+			std::sort(candidates.begin(),candidates.end());
+		}
+		std::vector<State> next;
+		for (int i=0; i<candidates.size(); i++) {
+			if (best>=0 && candidates[i].first>=bestCost)
+				continue;
+			State& parent= beam[candidates[i].second/nCars];
+			next.push_back(State());
+			move(parent,candidates[i].second%nCars,next.back());
+			history.push_back(Node{parent.node,next.back().car,
+			  next.back().goal});
+			next.back().node= history.size()-1;
+		}
+		beam.swap(next);
+	}
+	for (int i=best>=0?best:bestPartial; i>=0; i=history[i].parent) {
+		Step step;
+		step.car= carList[history[i].car];
+		step.destination= goalLocation[history[i].goal];
+		steps.push_back(step);
+	}
+	std::reverse(steps.begin(),steps.end());
+	double t= std::chrono::duration<double>(
+	  std::chrono::steady_clock::now()-startTime).count();
+	fprintf(stderr,"switch plan %d cars %d tracks %d steps %d states"
+	  " %.3fms %s\n",nCars,nTracks,(int)steps.size(),nStates,1000*t,
+	  best>=0?"complete":"partial");
+}
@@ -0,0 +1,97 @@
+//	search based switching move planner
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef SWITCHPLAN_H
+#define SWITCHPLAN_H
+
+#include <string>
+#include <vector>
+
+#include "track.h"
+
+struct RailCarInst;
+struct Switcher;
+
+//	plans the order in which a switcher handles cars
+//	the yard is modeled as the cars on each track plus the cars
+//	coupled to the locomotive and the track it is on.
+//	a beam search over car moves, using track to track costs
+//	computed once from the switch graph, finds a low cost order for
+//	the whole job which Switcher::update then replays.
+struct SwitchPlan {
+	struct Step {
+		RailCarInst* car;
+		Track::Location destination;
+	};
+	std::vector<Step> steps;
+	int next;
+	int beamWidth;
+	int nStates;
+	SwitchPlan() {
+		next= 0;
+		beamWidth= 32;
+		nStates= 0;
+	};
+	void plan(Switcher* switcher);
+ private:
+	struct State {
+		short loco;
+		std::vector<short> consist;
+		std::vector<std::vector<short> > tracks;
+		std::vector<short> carTrack;	// -1 if coupled to loco
+		std::vector<float> used;
+		float cost;
+		int node;		// index in history or -1 for the start
+		short car;
+		short goal;
+		std::string key();
+	};
+	//	the move that led to a state, only kept for states that enter
+	//	the beam or end the search, so plans are rebuilt by following
+	//	parent links without keeping every state
+	struct Node {
+		int parent;
+		short car;
+		short goal;
+	};
+	std::vector<Node> history;
+	std::vector<Track::SSEdge*> trackList;
+	std::vector<RailCarInst*> carList;
+	std::vector<short> carGoal;
+	std::vector<float> carLength;
+	std::vector<float> capacity;
+	std::vector<Track::Location> goalLocation;
+	std::vector<float> moveCost;
+	int addTrack(Track::SSEdge* sse);
+	void findMoveCosts();
+	float cost(int from, int to) {
+		return moveCost[from*trackList.size()+to];
+	};
+	float estimate(State& s);
+	bool misplaced(State& s, int car) {
+		return carGoal[car]>=0 && s.carTrack[car]!=carGoal[car];
+	};
+	bool move(State& s, int car, State& result);
+};
+
+#endif
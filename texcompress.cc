@@ -0,0 +1,209 @@
+//	CPU block compression of textures
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+//	Simple range fit encoders, the endpoints are the corners of the
+//	color bounding box inset a little to reduce the error at the ends.
+//	Good enough for MSTS textures and fast enough to run while loading.
+
+#include <string.h>
+#include "texcompress.h"
+
+static uint16_t to565(int r, int g, int b)
+{
+	return ((r*31+127)/255)<<11 | ((g*63+127)/255)<<5 | (b*31+127)/255;
+}
+
+static void from565(uint16_t c, int* rgb)
+{
+	int r= (c>>11)&31;
+	int g= (c>>5)&63;
+	int b= c&31;
+	rgb[0]= (r<<3) | (r>>2);
+	rgb[1]= (g<<2) | (g>>4);
+	rgb[2]= (b<<3) | (b>>2);
+}
+
+//	encodes the color part of one block
+//	pixels are 16 rgba values, alpha<128 is transparent if alphaMask
+//	fourColor forces the opaque 4 color mode used by BC3
+static void encodeColorBlock(const uint8_t* pixels, bool alphaMask,
+  bool fourColor, uint8_t* out)
+{
+	int min[3]= { 255, 255, 255 };
+	int max[3]= { 0, 0, 0 };
+	bool transparent= false;
+	for (int i=0; i<16; i++) {
+		const uint8_t* p= pixels+4*i;
+		if (alphaMask && p[3]<128) {
+			transparent= true;
+			continue;
+		}
+		for (int j=0; j<3; j++) {
+			if (min[j] > p[j])
+				min[j]= p[j];
+			if (max[j] < p[j])
+				max[j]= p[j];
+		}
+	}
+	if (min[0] > max[0]) {
+		for (int j=0; j<3; j++)
+			min[j]= max[j]= 0;
+	}
+	for (int j=0; j<3; j++) {
+		int inset= (max[j]-min[j])/16;
+		min[j]+= inset;
+		max[j]-= inset;
+	}
+	uint16_t c0= to565(max[0],max[1],max[2]);
+	uint16_t c1= to565(min[0],min[1],min[2]);
+	bool threeColor= transparent && !fourColor;
+	if (threeColor ? c0>c1 : c0<c1) {
+		uint16_t t= c0;
+		c0= c1;
+		c1= t;
+	}
+	int palette[4][3];
+	from565(c0,palette[0]);
+	from565(c1,palette[1]);
+	int nColors= 4;
+	for (int j=0; j<3; j++) {
+		if (threeColor) {
+			palette[2][j]= (palette[0][j]+palette[1][j])/2;
+			nColors= 3;
+		} else {
+			palette[2][j]= (2*palette[0][j]+palette[1][j])/3;
+			palette[3][j]= (palette[0][j]+2*palette[1][j])/3;
+		}
+	}
+	if (c0 == c1)
+		nColors= 1;
+	uint32_t indices= 0;
+	for (int i=0; i<16; i++) {
+		const uint8_t* p= pixels+4*i;
+		int best= 0;
+		if (threeColor && p[3]<128) {
+			best= 3;
+		} else {
+			int bestd= 1<<30;
+			for (int k=0; k<nColors; k++) {
+				int dr= p[0]-palette[k][0];
+				int dg= p[1]-palette[k][1];
+				int db= p[2]-palette[k][2];
+				int d= dr*dr + dg*dg + db*db;
+				if (bestd > d) {
+					bestd= d;
+					best= k;
+				}
+			}
+		}
+		indices|= best<<(2*i);
+	}
+	out[0]= c0&0xff;
+	out[1]= c0>>8;
+	out[2]= c1&0xff;
+	out[3]= c1>>8;
+	for (int i=0; i<4; i++)
+		out[4+i]= (indices>>(8*i))&0xff;
+}
+
+//	encodes the alpha part of a BC3 block
+static void encodeAlphaBlock(const uint8_t* pixels, uint8_t* out)
+{
+	int a0= 0;
+	int a1= 255;
+	for (int i=0; i<16; i++) {
+		int a= pixels[4*i+3];
+		if (a0 < a)
+			a0= a;
+		if (a1 > a)
+			a1= a;
+	}
+	int palette[8];
+	palette[0]= a0;
+	palette[1]= a1;
+	for (int i=1; i<7; i++)
+		palette[i+1]= ((7-i)*a0 + i*a1)/7;
+	uint64_t indices= 0;
+	if (a0 > a1) {
+		for (int i=0; i<16; i++) {
+			int a= pixels[4*i+3];
+			int best= 0;
+			int bestd= 256;
+			for (int k=0; k<8; k++) {
+				int d= a>palette[k] ? a-palette[k] : palette[k]-a;
+				if (bestd > d) {
+					bestd= d;
+					best= k;
+				}
+			}
+			indices|= (uint64_t)best<<(3*i);
+		}
+	}
+	out[0]= a0;
+	out[1]= a1;
+	for (int i=0; i<6; i++)
+		out[2+i]= (indices>>(8*i))&0xff;
+}
+
+//	copies a 4x4 block to rgba
+static void getBlock(const uint8_t* pixels, int pixelSize, int w,
+  int x, int y, uint8_t* block)
+{
+	for (int j=0; j<4; j++) {
+		const uint8_t* p= pixels + ((y+j)*w+x)*pixelSize;
+		for (int i=0; i<4; i++, p+=pixelSize) {
+			uint8_t* b= block+4*(4*j+i);
+			b[0]= p[0];
+			b[1]= p[1];
+			b[2]= p[2];
+			b[3]= pixelSize>3 ? p[3] : 255;
+		}
+	}
+}
+
+void encodeBC1(const uint8_t* pixels, int pixelSize, int w, int h,
+  bool alphaMask, uint8_t* out)
+{
+	uint8_t block[64];
+	for (int y=0; y<h; y+=4) {
+		for (int x=0; x<w; x+=4) {
+			getBlock(pixels,pixelSize,w,x,y,block);
+			encodeColorBlock(block,alphaMask,false,out);
+			out+= 8;
+		}
+	}
+}
+
+void encodeBC3(const uint8_t* pixels, int w, int h, uint8_t* out)
+{
+	uint8_t block[64];
+	for (int y=0; y<h; y+=4) {
+		for (int x=0; x<w; x+=4) {
+			getBlock(pixels,4,w,x,y,block);
+			encodeAlphaBlock(block,out);
+			encodeColorBlock(block,false,true,out+8);
+			out+= 16;
+		}
+	}
+}
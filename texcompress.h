@@ -0,0 +1,37 @@
+//	CPU block compression of textures
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef TEXCOMPRESS_H
+#define TEXCOMPRESS_H
+
+#include <stdint.h>
+
+//	compress a w by h image with pixelSize (3 or 4) bytes per pixel
+//	w and h must be multiples of 4
+//	BC1 writes 8 bytes per 4x4 block, BC3 writes 16
+//	alphaMask selects BC1 punch through alpha for 1 bit masks
+void encodeBC1(const uint8_t* pixels, int pixelSize, int w, int h,
+  bool alphaMask, uint8_t* out);
+void encodeBC3(const uint8_t* pixels, int w, int h, uint8_t* out);
+
+#endif
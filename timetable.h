@@ -150,6 +150,9 @@ class Train {
 	  std::string* reason);
 	std::string& getName() { return name; };
 	int getRow() { return row; };
+	void setRow(int r) { row= r; };
+	void setActive(bool a) { active= a; };
+	std::vector<TrainTime>& getTimes() { return times; };
 	Station* getRow(int idx);
 	TimeTable* getTimeTable() { return timeTable; };
 	bool hasBlock(int fromRow, int toRow);
@@ -235,6 +238,8 @@ class TimeTable {
 	bool addMeet(Train* t1, Train* t2, Station* s);
 	Block* getBlockFor(Train* train, int time);
 	Block* findBlock(int row1, int row2);
+	int getNumBlocks() { return blocks.size(); }
+	Block* getBlock(int idx) { return blocks[idx]; }
 };
 
 }
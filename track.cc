@@ -25,6 +25,7 @@ THE SOFTWARE.
 */
 
 #include <vsg/all.h>
+#include <mutex>
 
 #include "track.h"
 #include "spline.h"
@@ -33,6 +34,11 @@ using namespace std;
 
 TrackMap trackMap;
 
+//	switches thrown since their models were last checked, may be added to
+//	by the database pager threads when switch models are loaded
+static std::mutex switchAnimationMutex;
+static Track::SwVertexList pendingSwitchAnimations;
+
 Track::Track()
 {
 	vQueue= NULL;
@@ -65,6 +71,7 @@ Track::Vertex* Track::addVertex(int type, double x, double y, float z)
 		break;
 	 case VT_SWITCH:
 		v= (Vertex*) new SwVertex;
+		swVertexList.push_back((SwVertex*)v);
 		break;
 	 default:
 		throw "unknown vertex type";
@@ -303,13 +310,9 @@ Track::SwVertex* Track::findSwitch(double x, double y, double z, double tol)
 {
 	double bestd= tol;
 	SwVertex* bestsw= NULL;
-	for (VertexList::iterator i=vertexList.begin();
-	  i!=vertexList.end(); ++i) {
-		Vertex* v= *i;
-		if (v->type != VT_SWITCH)
-			continue;
+	for (auto sw: swVertexList) {
+		Vertex* v= sw;
 		WLocation loc= v->location;
-		SwVertex* sw= (SwVertex*) v;
 		Edge* e0= sw->swEdges[0];
 		Edge* e1= sw->swEdges[1];
 		if (e0->type==ET_STRAIGHT && e1->type==ET_STRAIGHT) {
@@ -627,6 +630,7 @@ void Track::SwVertex::throwSwitch(Track::Edge* edge, bool force)
 	if (hasInterlocking && !force)
 		return;
 	edge2= edge2==swEdges[0] ? swEdges[1] : swEdges[0];
+	queueSwitchAnimation(this);
 //	ChangeLog::instance()->addThrow(this);
 //	fprintf(stderr,"throw0 %p %p %p %p %f %f %f\n",
 //	  this,edge2,swEdges[0],swEdges[1],
@@ -893,6 +897,22 @@ Track::SwVertex* findTrackSwitch(vsg::dvec3 loc, double tol)
 	return NULL;
 }
 
+//	adds a switch to the list of switches whose models need to be checked
+void queueSwitchAnimation(Track::SwVertex* sw)
+{
+	scoped_lock lock {switchAnimationMutex};
+	pendingSwitchAnimations.push_back(sw);
+}
+
+//	moves the queued switches to the end of list
+void takeSwitchAnimations(Track::SwVertexList& list)
+{
+	scoped_lock lock {switchAnimationMutex};
+	list.insert(list.end(),pendingSwitchAnimations.begin(),
+	  pendingSwitchAnimations.end());
+	pendingSwitchAnimations.clear();
+}
+
 Track::SSEdge* findTrackSSEdge(int id)
 {
 	for (TrackMap::iterator i=trackMap.begin(); i!=trackMap.end(); ++i) {
@@ -1953,6 +1973,14 @@ void Track::split(std::string& newName, double x1, double y1,
 		Vertex* v= *i;
 		vertexList.remove(v);
 	}
+	SwVertexList swList;
+	for (auto sw: swVertexList) {
+		if (sw->inEdge)
+			newTrack->swVertexList.push_back(sw);
+		else
+			swList.push_back(sw);
+	}
+	swVertexList.swap(swList);
 	for (EdgeList::iterator i=edgeList.begin(); i!=edgeList.end(); ++i) {
 		Edge* e= *i;
 		if (e->v1->inEdge && e->v2->inEdge) {
@@ -27,9 +27,11 @@ THE SOFTWARE.
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 #include <vsg/all.h>
 
 class TrackShape;
+struct TrackMesh;
 
 //	world location information
 struct WLocation {
@@ -85,6 +87,7 @@ struct Track {
 		float dist;
 		float grade;
 		float elevation;
+		int meshIndex;	// set by makeMesh
 		inline Edge* nextEdge(Edge* e) {
 			if (e == edge1)
 				return edge2;
@@ -170,11 +173,13 @@ struct Track {
 	};
 	typedef std::list<Edge*> EdgeList;
 	typedef std::list<Vertex*> VertexList;
+	typedef std::vector<SwVertex*> SwVertexList;
 	typedef std::multimap<std::string,Track::Location> LocationMap;
 	typedef std::map<int,SwVertex*> SwitchMap;
 	typedef std::map<int,SSEdge*> SSEdgeMap;
 	LocationMap locations;
 	VertexList vertexList;
+	SwVertexList swVertexList;
 	EdgeList edgeList;
 	SwitchMap switchMap;
 	SSEdgeMap ssEdgeMap;
@@ -210,6 +215,7 @@ struct Track {
 	void translate(double dx, double dy, double dz);
 	void rotate(double angle);
 	vsg::ref_ptr<vsg::StateGroup> makeGeometry(vsg::ref_ptr<vsg::Options> vsgOptions);
+	void makeMesh(TrackMesh& mesh);
 	void makeMovable() {
 		matrix= new vsg::dmat4();
 	};
@@ -250,6 +256,8 @@ extern void findTrackLocation(double x, double y, double z,
 extern Track::SwVertex* findTrackSwitch(int id);
 extern Track::SwVertex* findTrackSwitch(vsg::dvec3 loc, double tol=1000);
 extern Track::SSEdge* findTrackSSEdge(int id);
+extern void queueSwitchAnimation(Track::SwVertex* sw);
+extern void takeSwitchAnimations(Track::SwVertexList& list);
 extern void printTrackLocations();
 extern vsg::Switch* addTrackLabels();
 
@@ -0,0 +1,462 @@
+//	saves and restores the track network built from MSTS route files
+//
+/*
+Copyright © 2026 Doug Jones
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include "mstsroute.h"
+#include "track.h"
+
+using namespace std;
+
+//	The cache is a header followed by arrays of fixed size records and
+//	a string table so it can be used directly from a single read or mmap.
+//	Pointers are stored as indexes into the arrays, -1 for NULL.
+
+static const int trackCacheVersion= 1;
+
+struct CacheHeader {
+	char magic[4];
+	int32_t version;
+	uint64_t key;
+	int32_t centerTX;
+	int32_t centerTZ;
+	int32_t nVertices;
+	int32_t nEdges;
+	int32_t nSSEdges;
+	int32_t nLocations;
+	int32_t stringSize;
+	int32_t pad;
+};
+
+struct CacheVertex {
+	double coord[3];
+	float up[3];
+	float grade;
+	float elevation;
+	int32_t type;
+	int32_t edge1;
+	int32_t edge2;
+	// switch only
+	int32_t id;
+	int32_t swEdges[2];
+	int32_t ssEdges[3];
+	int32_t mainEdge;
+	int32_t hasInterlocking;
+	int32_t tileX;
+	int32_t tileZ;
+	int32_t nodeID;		// key in tile swVertexMap or -1
+};
+
+struct CacheEdge {
+	int32_t type;
+	int32_t v1;
+	int32_t v2;
+	int32_t ssEdge;
+	float length;
+	float ssOffset;
+	float curvature;
+	float dd1[3];
+	float dd2[3];
+	float splineMult;
+	float angle;
+};
+
+struct CacheSSEdge {
+	int32_t block;
+	int32_t v1;
+	int32_t v2;
+	float length;
+};
+
+struct CacheLocation {
+	int32_t name;		// offset in string table
+	int32_t edge;
+	float offset;
+	int32_t rev;
+};
+
+//	returns an FNV-1a hash of the contents of the files that the track
+//	is made from and the route center, which all coordinates depend on
+uint64_t MSTSRoute::hashTrackFiles(vector<string> paths)
+{
+	uint64_t hash= 14695981039346656037ull;
+	auto add= [&hash](const unsigned char* p, int n) {
+		for (int i=0; i<n; i++) {
+			hash^= p[i];
+			hash*= 1099511628211ull;
+		}
+	};
+	add((const unsigned char*)&trackCacheVersion,sizeof(int));
+	add((const unsigned char*)&centerTX,sizeof(centerTX));
+	add((const unsigned char*)&centerTZ,sizeof(centerTZ));
+	add((const unsigned char*)&centerLat,sizeof(centerLat));
+	add((const unsigned char*)&centerLong,sizeof(centerLong));
+	unsigned char buf[65536];
+	for (auto& path: paths) {
+		add((const unsigned char*)path.c_str(),path.size()+1);
+		FILE* in= fopen(path.c_str(),"rb");
+		if (!in)
+			continue;
+		int n;
+		while ((n=fread(buf,1,sizeof(buf),in)) > 0)
+			add(buf,n);
+		fclose(in);
+	}
+	return hash;
+}
+
+//	saves the route track in the cache file
+void MSTSRoute::writeTrackCache(string& path, uint64_t key)
+{
+	Track* track= trackMap[routeID];
+	if (!track)
+		return;
+	map<Track::Vertex*,int> vIndex;
+	map<Track::Edge*,int> eIndex;
+	map<Track::SSEdge*,int> sseIndex;
+	vIndex[NULL]= -1;
+	eIndex[NULL]= -1;
+	sseIndex[NULL]= -1;
+	//	a switch edge missing from ssEdgeMap can't be saved
+	bool ok= true;
+	auto ssi= [&sseIndex,&ok](Track::SSEdge* e) {
+		auto i= sseIndex.find(e);
+		if (i == sseIndex.end()) {
+			ok= false;
+			return -1;
+		}
+		return i->second;
+	};
+	int n= 0;
+	for (auto v: track->vertexList)
+		vIndex[v]= n++;
+	n= 0;
+	for (auto e: track->edgeList)
+		eIndex[e]= n++;
+	vector<CacheSSEdge> ssEdges;
+	for (auto& i: track->ssEdgeMap) {
+		sseIndex[i.second]= ssEdges.size();
+		CacheSSEdge r;
+		r.block= i.second->block;
+		r.v1= vIndex[i.second->v1];
+		r.v2= vIndex[i.second->v2];
+		r.length= i.second->length;
+		ssEdges.push_back(r);
+	}
+	map<Track::SwVertex*,pair<Tile*,int>> swTiles;
+	for (auto& i: tileMap)
+		for (auto& j: i.second->swVertexMap)
+			swTiles[j.second]= make_pair(i.second,j.first);
+	vector<CacheVertex> vertices;
+	for (auto v: track->vertexList) {
+		CacheVertex r;
+		memset(&r,0,sizeof(r));
+		for (int i=0; i<3; i++) {
+			r.coord[i]= v->location.coord[i];
+			r.up[i]= v->location.up[i];
+		}
+		r.grade= v->grade;
+		r.elevation= v->elevation;
+		r.type= v->type;
+		r.edge1= eIndex[v->edge1];
+		r.edge2= eIndex[v->edge2];
+		r.nodeID= -1;
+		if (v->type == Track::VT_SWITCH) {
+			Track::SwVertex* sw= (Track::SwVertex*)v;
+			r.id= sw->id;
+			for (int i=0; i<2; i++)
+				r.swEdges[i]= eIndex[sw->swEdges[i]];
+			for (int i=0; i<3; i++)
+				r.ssEdges[i]= ssi(sw->ssEdges[i]);
+			r.mainEdge= sw->mainEdge;
+			r.hasInterlocking= sw->hasInterlocking;
+			auto i= swTiles.find(sw);
+			if (i != swTiles.end()) {
+				r.tileX= i->second.first->x;
+				r.tileZ= i->second.first->z;
+				r.nodeID= i->second.second;
+			}
+		}
+		vertices.push_back(r);
+	}
+	vector<CacheEdge> edges;
+	for (auto e: track->edgeList) {
+		CacheEdge r;
+		memset(&r,0,sizeof(r));
+		r.type= e->type;
+		r.v1= vIndex[e->v1];
+		r.v2= vIndex[e->v2];
+		r.ssEdge= ssi(e->ssEdge);
+		r.length= e->length;
+		r.ssOffset= e->ssOffset;
+		r.curvature= e->curvature;
+		if (e->type == Track::ET_SPLINE) {
+			Track::SplineEdge* s= (Track::SplineEdge*)e;
+			for (int i=0; i<3; i++) {
+				r.dd1[i]= s->dd1[i];
+				r.dd2[i]= s->dd2[i];
+			}
+			r.splineMult= s->splineMult;
+			r.angle= s->angle;
+		}
+		edges.push_back(r);
+	}
+	vector<CacheLocation> locations;
+	string strings;
+	for (auto& i: track->locations) {
+		CacheLocation r;
+		r.name= strings.size();
+		strings+= i.first;
+		strings+= '\0';
+		r.edge= eIndex[i.second.edge];
+		r.offset= i.second.offset;
+		r.rev= i.second.rev;
+		locations.push_back(r);
+	}
+	if (!ok) {
+		fprintf(stderr,"track cache not written,"
+		  " switch edge missing from ssEdgeMap\n");
+		return;
+	}
+	CacheHeader header;
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,"VTRK",4);
+	header.version= trackCacheVersion;
+	header.key= key;
+	header.centerTX= centerTX;
+	header.centerTZ= centerTZ;
+	header.nVertices= vertices.size();
+	header.nEdges= edges.size();
+	header.nSSEdges= ssEdges.size();
+	header.nLocations= locations.size();
+	header.stringSize= strings.size();
+	string tmpPath= path+".tmp";
+	FILE* out= fopen(tmpPath.c_str(),"wb");
+	if (!out) {
+//		fprintf(stderr,"cannot write track cache %s\n",path.c_str());
+		return;
+	}
+	fwrite(&header,sizeof(header),1,out);
+	fwrite(vertices.data(),sizeof(CacheVertex),vertices.size(),out);
+	fwrite(edges.data(),sizeof(CacheEdge),edges.size(),out);
+	fwrite(ssEdges.data(),sizeof(CacheSSEdge),ssEdges.size(),out);
+	fwrite(locations.data(),sizeof(CacheLocation),locations.size(),out);
+	fwrite(strings.data(),1,strings.size(),out);
+	ok= ferror(out) == 0;
+	fclose(out);
+	if (ok)
+		rename(tmpPath.c_str(),path.c_str());
+	else
+		remove(tmpPath.c_str());
+}
+
+//	checks that every index in the cache is in range and every location
+//	name ends inside the string table
+//	so a damaged cache is rebuilt instead of crashing
+static bool checkTrackCache(const CacheHeader* header,
+  const CacheVertex* cVertices, const CacheEdge* cEdges,
+  const CacheSSEdge* cSSEdges, const CacheLocation* cLocations,
+  const char* strings)
+{
+	int nv= header->nVertices;
+	int ne= header->nEdges;
+	int nss= header->nSSEdges;
+	auto in= [](int32_t i, int n) { return i>=-1 && i<n; };
+	for (int i=0; i<nv; i++) {
+		const CacheVertex& r= cVertices[i];
+		if (r.type!=Track::VT_SIMPLE && r.type!=Track::VT_SWITCH)
+			return false;
+		if (!in(r.edge1,ne) || !in(r.edge2,ne))
+			return false;
+		if (r.type != Track::VT_SWITCH)
+			continue;
+		if (!in(r.swEdges[0],ne) || !in(r.swEdges[1],ne) ||
+		  r.mainEdge<0 || r.mainEdge>1)
+			return false;
+		for (int j=0; j<3; j++)
+			if (!in(r.ssEdges[j],nss))
+				return false;
+	}
+	for (int i=0; i<ne; i++) {
+		const CacheEdge& r= cEdges[i];
+		if (r.type!=Track::ET_STRAIGHT && r.type!=Track::ET_SPLINE)
+			return false;
+		if (!in(r.v1,nv) || !in(r.v2,nv) || !in(r.ssEdge,nss))
+			return false;
+	}
+	for (int i=0; i<nss; i++)
+		if (!in(cSSEdges[i].v1,nv) || !in(cSSEdges[i].v2,nv))
+			return false;
+	for (int i=0; i<header->nLocations; i++) {
+		const CacheLocation& r= cLocations[i];
+		if (!in(r.edge,ne) || r.name<0 || r.name>=header->stringSize ||
+		  memchr(strings+r.name,0,header->stringSize-r.name)==NULL)
+			return false;
+	}
+	return true;
+}
+
+//	rebuilds the route track from the cache file
+//	returns false if the file is missing or was made from other files
+bool MSTSRoute::readTrackCache(string& path, uint64_t key)
+{
+	FILE* in= fopen(path.c_str(),"rb");
+	if (!in)
+		return false;
+	fseek(in,0,SEEK_END);
+	long size= ftell(in);
+	fseek(in,0,SEEK_SET);
+	vector<char> data(size>0?size:0);
+	bool ok= size>=sizeof(CacheHeader) &&
+	  fread(data.data(),1,size,in)==size;
+	fclose(in);
+	if (!ok)
+		return false;
+	const CacheHeader* header= (const CacheHeader*)data.data();
+	if (strncmp(header->magic,"VTRK",4)!=0 ||
+	  header->version!=trackCacheVersion || header->key!=key)
+		return false;
+	if (header->nVertices<0 || header->nEdges<0 || header->nSSEdges<0 ||
+	  header->nLocations<0 || header->stringSize<0)
+		return false;
+	long expected= sizeof(CacheHeader) +
+	  header->nVertices*sizeof(CacheVertex) +
+	  header->nEdges*sizeof(CacheEdge) +
+	  header->nSSEdges*sizeof(CacheSSEdge) +
+	  header->nLocations*sizeof(CacheLocation) + header->stringSize;
+	if (expected != size)
+		return false;
+	const CacheVertex* cVertices= (const CacheVertex*)(header+1);
+	const CacheEdge* cEdges= (const CacheEdge*)(cVertices+header->nVertices);
+	const CacheSSEdge* cSSEdges= (const CacheSSEdge*)(cEdges+header->nEdges);
+	const CacheLocation* cLocations=
+	  (const CacheLocation*)(cSSEdges+header->nSSEdges);
+	const char* strings= (const char*)(cLocations+header->nLocations);
+	if (!checkTrackCache(header,cVertices,cEdges,cSSEdges,cLocations,
+	  strings)) {
+		fprintf(stderr,"ignoring damaged track cache %s\n",path.c_str());
+		return false;
+	}
+	centerTX= header->centerTX;
+	centerTZ= header->centerTZ;
+	if (centerLat!=0 || centerLong!=0)
+		cosCenterLat= cos(centerLat/(180*3.14159));
+	Track* track= new Track;
+	trackMap[routeID]= track;
+	track->updateSignals= createSignals;
+	//	allocate everything first so indexes can be resolved
+	vector<Track::Vertex*> vertices(header->nVertices);
+	vector<Track::Edge*> edges(header->nEdges);
+	vector<Track::SSEdge*> ssEdges(header->nSSEdges);
+	for (int i=0; i<header->nVertices; i++) {
+		const CacheVertex& r= cVertices[i];
+		vertices[i]= track->addVertex(r.type,
+		  r.coord[0],r.coord[1],r.coord[2]);
+	}
+	for (int i=0; i<header->nEdges; i++)
+		edges[i]= cEdges[i].type==Track::ET_SPLINE ?
+		  new Track::SplineEdge : new Track::Edge;
+	for (int i=0; i<header->nSSEdges; i++)
+		ssEdges[i]= new Track::SSEdge;
+	auto vp= [&](int i) { return i<0 ? NULL : vertices[i]; };
+	auto ep= [&](int i) { return i<0 ? NULL : edges[i]; };
+	auto ssep= [&](int i) { return i<0 ? NULL : ssEdges[i]; };
+	for (int i=0; i<header->nEdges; i++) {
+		const CacheEdge& r= cEdges[i];
+		Track::Edge* e= edges[i];
+		e->type= r.type;
+		e->occupied= 0;
+		e->track= track;
+		e->v1= vp(r.v1);
+		e->v2= vp(r.v2);
+		e->ssEdge= ssep(r.ssEdge);
+		e->length= r.length;
+		e->ssOffset= r.ssOffset;
+		e->curvature= r.curvature;
+		if (r.type == Track::ET_SPLINE) {
+			Track::SplineEdge* s= (Track::SplineEdge*)e;
+			for (int j=0; j<3; j++) {
+				s->dd1[j]= r.dd1[j];
+				s->dd2[j]= r.dd2[j];
+			}
+			s->splineMult= r.splineMult;
+			s->angle= r.angle;
+		}
+		track->edgeList.push_back(e);
+	}
+	for (int i=0; i<header->nSSEdges; i++) {
+		const CacheSSEdge& r= cSSEdges[i];
+		Track::SSEdge* sse= ssEdges[i];
+		sse->type= Track::ET_STRAIGHT;
+		sse->occupied= 0;
+		sse->track= track;
+		sse->block= r.block;
+		sse->v1= vp(r.v1);
+		sse->v2= vp(r.v2);
+		sse->length= r.length;
+		sse->ssEdge= NULL;
+		sse->ssOffset= 0;
+		sse->curvature= 0;
+		track->ssEdgeMap[sse->block]= sse;
+	}
+	for (int i=0; i<header->nVertices; i++) {
+		const CacheVertex& r= cVertices[i];
+		Track::Vertex* v= vertices[i];
+		for (int j=0; j<3; j++)
+			v->location.up[j]= r.up[j];
+		v->grade= r.grade;
+		v->elevation= r.elevation;
+		v->edge1= ep(r.edge1);
+		v->edge2= ep(r.edge2);
+		if (v->type != Track::VT_SWITCH)
+			continue;
+		Track::SwVertex* sw= (Track::SwVertex*)v;
+		sw->id= r.id;
+		for (int j=0; j<2; j++)
+			sw->swEdges[j]= ep(r.swEdges[j]);
+		for (int j=0; j<3; j++)
+			sw->ssEdges[j]= ssep(r.ssEdges[j]);
+		sw->mainEdge= r.mainEdge;
+		sw->hasInterlocking= r.hasInterlocking;
+		track->switchMap[sw->id]= sw;
+		if (r.nodeID >= 0) {
+			Tile* tile= findTile(r.tileX,r.tileZ);
+			if (tile)
+				tile->swVertexMap[r.nodeID]= sw;
+		}
+	}
+	for (int i=0; i<header->nLocations; i++) {
+		const CacheLocation& r= cLocations[i];
+		Track::Location loc;
+		loc.edge= ep(r.edge);
+		loc.offset= r.offset;
+		loc.rev= r.rev;
+		track->locations.insert(make_pair(string(strings+r.name),loc));
+	}
+	return true;
+}
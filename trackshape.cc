@@ -29,21 +29,19 @@ using namespace std;
 
 #include "trackshape.h"
 #include "track.h"
+#include "jobs.h"
 
 TrackShapeMap trackShapeMap;
 
 struct VInfo {
-	int id;
 	vsg::vec3 normal;
 	int nEdges;
-	VInfo(int i) {
-		id= i;
+	VInfo() {
 		normal= vsg::vec3(0,0,0);
 		nEdges= 0;
 	};
 	void addNormal(float dx, float dy);
 };
-typedef map<Track::Vertex*,VInfo> VInfoMap;
 
 int sameDirection(float x1, float y1, float x2, float y2)
 {
@@ -65,185 +63,246 @@ void VInfo::addNormal(float dx, float dy)
 	nEdges++;
 }
 
-vsg::ref_ptr<vsg::StateGroup> Track::makeGeometry(vsg::ref_ptr<vsg::Options> vsgOptions)
+//	appends triangles for shape along all of the track's edges to mesh
+//	vertices are numbered once so everything after that is indexed by
+//	meshIndex, and the number of triangle vertices each edge and track
+//	end makes is counted first so they can be filled in parallel
+void Track::makeMesh(TrackMesh& mesh)
 {
-	if (shape == NULL)
-		return NULL;
-	VInfoMap vInfoMap;
-	int nv= 0;
-	for (VertexList::iterator i=vertexList.begin(); i!=vertexList.end();
-	  ++i) {
-		Vertex* v= *i;
-		vInfoMap.insert(make_pair(v,VInfo(nv++)));
-	}
-	for (EdgeList::iterator i=edgeList.begin(); i!=edgeList.end();
-	  ++i) {
-		Edge* e= *i;
+	vector<Vertex*> vertices(vertexList.begin(),vertexList.end());
+	vector<Edge*> edges(edgeList.begin(),edgeList.end());
+	int nv= vertices.size();
+	int ne= edges.size();
+	for (int i=0; i<nv; i++)
+		vertices[i]->meshIndex= i;
+	vector<VInfo> vInfo(nv);
+	for (int i=0; i<ne; i++) {
+		Edge* e= edges[i];
 		float dx= (e->v1->location.coord[0]-e->v2->location.coord[0]) /
 		  e->length;
 		float dy= (e->v1->location.coord[1]-e->v2->location.coord[1]) /
 		  e->length;
-		VInfoMap::iterator vi= vInfoMap.find(e->v1);
-		vi->second.addNormal(dx,dy);
-		vi= vInfoMap.find(e->v2);
-		vi->second.addNormal(dx,dy);
+		vInfo[e->v1->meshIndex].addNormal(dx,dy);
+		vInfo[e->v2->meshIndex].addNormal(dx,dy);
 	}
 	int no= shape->offsets.size();
-	vector<vsg::vec3> vertv;
-	for (VertexList::iterator i=vertexList.begin(); i!=vertexList.end();
-	  ++i) {
-		Vertex* v= *i;
-		VInfoMap::iterator vi= vInfoMap.find(v);
-//		if (vi->second.nEdges == 0)
-//			continue;
-		vi->second.normal= normalize(vi->second.normal);
-		if (v->occupied)
-		fprintf(stderr,"v %d %d %lf %lf %lf\n",
-		  vi->second.id,vi->second.nEdges,vi->second.normal[0],
-		  vi->second.normal[1],vi->second.normal[2]);
-		float nx= vi->second.normal[0];
-		float ny= vi->second.normal[1];
-		for (int j=0; j<shape->offsets.size(); j++) {
-			int j1= j;
-			if (v->occupied && j%2==1)
-				j1--;
-			vsg::dvec3 p= v->location.coord+
-			  vsg::dvec3(nx*shape->offsets[j1].x,
-			  ny*shape->offsets[j1].x,-shape->offsets[j1].y);
+	vector<vsg::vec3> vertv(nv*no);
+	jobSystem.parallelFor(0,nv,256,[&](int begin, int end) {
+		for (int i=begin; i<end; i++) {
+			Vertex* v= vertices[i];
+			VInfo& vi= vInfo[i];
+//			if (vi.nEdges == 0)
+//				continue;
+			vi.normal= normalize(vi.normal);
 			if (v->occupied)
-			fprintf(stderr,"%d %f %f %f\n",
-			  vi->second.id*no+j,p[0],p[1],p[2]);
-			vertv.push_back(vsg::vec3(p.x,p.y,p.z));
+			fprintf(stderr,"v %d %d %lf %lf %lf\n",
+			  i,vi.nEdges,vi.normal[0],vi.normal[1],vi.normal[2]);
+			float nx= vi.normal[0];
+			float ny= vi.normal[1];
+			for (int j=0; j<no; j++) {
+				int j1= j;
+				if (v->occupied && j%2==1)
+					j1--;
+				vsg::dvec3 p= v->location.coord+
+				  vsg::dvec3(nx*shape->offsets[j1].x,
+				  ny*shape->offsets[j1].x,-shape->offsets[j1].y);
+				if (v->occupied)
+				fprintf(stderr,"%d %f %f %f\n",
+				  i*no+j,p[0],p[1],p[2]);
+				vertv[i*no+j]= vsg::vec3(p.x,p.y,p.z);
+			}
 		}
-	}
-//	static bool firstTime= true;
-	nv= edgeList.size()*shape->surfaces.size()*6 +
-	  shape->endVerts.size()*vertexList.size()*3;
-	vsg::ref_ptr<vsg::vec3Array> verts(new vsg::vec3Array(nv));
-	vsg::ref_ptr<vsg::vec2Array> texCoords(new vsg::vec2Array(nv));
-	vsg::ref_ptr<vsg::vec3Array> normals(new vsg::vec3Array(nv));
-	vsg::ref_ptr<vsg::vec4Array> colors= vsg::vec4Array::create({vsg::vec4(1,1,1,1)});
-	int nvi= 0;
-	for (EdgeList::iterator i=edgeList.begin(); i!=edgeList.end();
-	  ++i) {
-		Edge* e= *i;
-		float edx= (e->v1->location.coord[0]-e->v2->location.coord[0])
-		  / e->length;
-		float edy= (e->v1->location.coord[1]-e->v2->location.coord[1])
-		  / e->length;
-//		if (firstTime)
-//			fprintf(stderr,"%f %f\n",edx,edy);
-		VInfoMap::iterator vi1= vInfoMap.find(e->v1);
-		VInfoMap::iterator vi2= vInfoMap.find(e->v2);
-		int v1o= vi1->second.id*no;
-		int flip1= !sameDirection(vi1->second.normal[1],
-		  vi1->second.normal[0],edx,-edy);
-		int v2o= vi2->second.id*no;
-		int flip2= !sameDirection(vi2->second.normal[1],
-		  vi2->second.normal[0],edx,-edy);
+	});
+	vector<int> edgeStart(ne+1);
+	int n= 0;
+	for (int i=0; i<ne; i++) {
+		edgeStart[i]= n;
+		Edge* e= edges[i];
 		for (int j=0; j<shape->surfaces.size(); j++) {
 			int flags= shape->surfaces[j].flags;
 			if (e->occupied && flags && (e->occupied&flags)==0)
 				continue;
-			int i1= shape->surfaces[j].vo1;
-			int o1= shape->offsets[i1].other;
-			int i2= shape->surfaces[j].vo2;
-			int o2= shape->offsets[i2].other;
-			if (flip1) {
-				verts->at(nvi)= vertv[v1o+o1];
-				verts->at(nvi+1)= vertv[v1o+o2];
-			} else {
-				verts->at(nvi)= vertv[v1o+i1];
-				verts->at(nvi+1)= vertv[v1o+i2];
-			}
-			if (flip2) {
-				verts->at(nvi+2)= vertv[v2o+o2];
-				verts->at(nvi+3)= vertv[v2o+o2];
-				verts->at(nvi+4)= vertv[v2o+o1];
-			} else {
-				verts->at(nvi+2)= vertv[v2o+i2];
-				verts->at(nvi+3)= vertv[v2o+i2];
-				verts->at(nvi+4)= vertv[v2o+i1];
-			}
-			if (flip1) {
-				verts->at(nvi+5)= vertv[v1o+o1];
-			} else {
-				verts->at(nvi+5)= vertv[v1o+i1];
-			}
-			float dx= shape->offsets[i2].x-shape->offsets[i1].x;
-			float dy= shape->offsets[i2].y-shape->offsets[i1].y;
-			vsg::vec3 normal= vsg::cross(vsg::normalize(vsg::vec3(dx,0,-dy)),
-			  vsg::normalize(vsg::vec3(edx,-edy,0)));
-			for (int k=0; k<6; k++)
-				normals->at(nvi+k)= normal;
-//			if (firstTime)
-//			fprintf(stderr,
-//			  "%p %f %f %f %d %d %d %d %d %d %d %d %d %d\n",e,
-//			  normal.x,normal.y,normal.z,
-//			  v1o,i1,v2o,i2,
-//			  v1o+i1,v1o+i2,v2o+i2,v2o+i2,v2o+i1,v1o+i1);
-			if (shape->image) {
-				float top= e->length/shape->surfaces[j].meters;
-				float u1= shape->surfaces[j].u1;
-				float u2= shape->surfaces[j].u2;
-//				fprintf(stderr,"%f %f %f\n",u1,u2,top);
-				if (top < 0) {
-					texCoords->at(nvi)= vsg::vec2(0,u1);
-					texCoords->at(nvi+1)= vsg::vec2(0,u2);
-					texCoords->at(nvi+2)= vsg::vec2(top,u2);
-					texCoords->at(nvi+3)= vsg::vec2(top,u2);
-					texCoords->at(nvi+4)= vsg::vec2(top,u1);
-					texCoords->at(nvi+5)= vsg::vec2(0,u1);
-				} else {
-					texCoords->at(nvi)= vsg::vec2(u1,0);
-					texCoords->at(nvi+1)= vsg::vec2(u2,0);
-					texCoords->at(nvi+2)= vsg::vec2(u2,top);
-					texCoords->at(nvi+3)= vsg::vec2(u2,top);
-					texCoords->at(nvi+4)= vsg::vec2(u1,top);
-					texCoords->at(nvi+5)= vsg::vec2(u1,0);
-				}
-			}
-			nvi+= 6;
+			n+= 6;
 		}
-//		firstTime= false;
 	}
-	if (shape->endVerts.size() > 0) {
-		int eo0= shape->endVerts[0].offset;
-		float u0= shape->endVerts[0].u;
-		float v0= shape->endVerts[0].v;
-		for (VertexList::iterator i=vertexList.begin();
-		  i!=vertexList.end(); ++i) {
-			Vertex* v= *i;
-			VInfoMap::iterator vi= vInfoMap.find(v);
-			if (vi->second.nEdges != 1)
-				continue;
-			int vo= vi->second.id*no;
-			int flip= vi->second.id>0;
-			for (int j=2; j<shape->endVerts.size(); j++) {
-				int eo1= shape->endVerts[j-1].offset;
-				int eo2= shape->endVerts[j].offset;
-				float u1= shape->endVerts[j-1].u;
-				float v1= shape->endVerts[j-1].v;
-				float u2= shape->endVerts[j].u;
-				float v2= shape->endVerts[j].v;
-				verts->at(nvi)= vertv[vo+eo0];
-				texCoords->at(nvi)= vsg::vec2(u0,v0);
-				if (flip) {
-					verts->at(nvi+1)= vertv[vo+eo2];
-					verts->at(nvi+2)= vertv[vo+eo1];
-					texCoords->at(nvi+1)= vsg::vec2(u2,v2);
-					texCoords->at(nvi+2)= vsg::vec2(u1,v1);
+	edgeStart[ne]= n;
+	int nEndTris= shape->endVerts.size()>2 ? shape->endVerts.size()-2 : 0;
+	vector<int> endStart(nv+1);
+	for (int i=0; i<nv; i++) {
+		endStart[i]= n;
+		if (vInfo[i].nEdges == 1)
+			n+= 3*nEndTris;
+	}
+	endStart[nv]= n;
+	int nvi0= mesh.verts.size();
+	mesh.verts.resize(nvi0+n);
+	mesh.texCoords.resize(nvi0+n);
+	mesh.normals.resize(nvi0+n);
+	vsg::vec3* verts= mesh.verts.data()+nvi0;
+	vsg::vec2* texCoords= mesh.texCoords.data()+nvi0;
+	vsg::vec3* normals= mesh.normals.data()+nvi0;
+	jobSystem.parallelFor(0,ne,256,[&](int begin, int end) {
+		for (int i=begin; i<end; i++) {
+			Edge* e= edges[i];
+			int nvi= edgeStart[i];
+			float edx= (e->v1->location.coord[0]-e->v2->location.coord[0])
+			  / e->length;
+			float edy= (e->v1->location.coord[1]-e->v2->location.coord[1])
+			  / e->length;
+			VInfo& vi1= vInfo[e->v1->meshIndex];
+			VInfo& vi2= vInfo[e->v2->meshIndex];
+			int v1o= e->v1->meshIndex*no;
+			int flip1= !sameDirection(vi1.normal[1],vi1.normal[0],edx,-edy);
+			int v2o= e->v2->meshIndex*no;
+			int flip2= !sameDirection(vi2.normal[1],vi2.normal[0],edx,-edy);
+			for (int j=0; j<shape->surfaces.size(); j++) {
+				int flags= shape->surfaces[j].flags;
+				if (e->occupied && flags && (e->occupied&flags)==0)
+					continue;
+				int i1= shape->surfaces[j].vo1;
+				int o1= shape->offsets[i1].other;
+				int i2= shape->surfaces[j].vo2;
+				int o2= shape->offsets[i2].other;
+				if (flip1) {
+					verts[nvi]= vertv[v1o+o1];
+					verts[nvi+1]= vertv[v1o+o2];
+				} else {
+					verts[nvi]= vertv[v1o+i1];
+					verts[nvi+1]= vertv[v1o+i2];
+				}
+				if (flip2) {
+					verts[nvi+2]= vertv[v2o+o2];
+					verts[nvi+3]= vertv[v2o+o2];
+					verts[nvi+4]= vertv[v2o+o1];
+				} else {
+					verts[nvi+2]= vertv[v2o+i2];
+					verts[nvi+3]= vertv[v2o+i2];
+					verts[nvi+4]= vertv[v2o+i1];
+				}
+				if (flip1) {
+					verts[nvi+5]= vertv[v1o+o1];
 				} else {
-					verts->at(nvi+1)= vertv[vo+eo1];
-					verts->at(nvi+2)= vertv[vo+eo2];
-					texCoords->at(nvi+1)= vsg::vec2(u1,v1);
-					texCoords->at(nvi+2)= vsg::vec2(u2,v2);
+					verts[nvi+5]= vertv[v1o+i1];
 				}
-				nvi+= 3;
+				float dx= shape->offsets[i2].x-shape->offsets[i1].x;
+				float dy= shape->offsets[i2].y-shape->offsets[i1].y;
+				vsg::vec3 normal= vsg::cross(vsg::normalize(vsg::vec3(dx,0,-dy)),
+				  vsg::normalize(vsg::vec3(edx,-edy,0)));
+				for (int k=0; k<6; k++)
+					normals[nvi+k]= normal;
+				if (shape->image) {
+					float top= e->length/shape->surfaces[j].meters;
+					float u1= shape->surfaces[j].u1;
+					float u2= shape->surfaces[j].u2;
+					if (top < 0) {
+						texCoords[nvi]= vsg::vec2(0,u1);
+						texCoords[nvi+1]= vsg::vec2(0,u2);
+						texCoords[nvi+2]= vsg::vec2(top,u2);
+						texCoords[nvi+3]= vsg::vec2(top,u2);
+						texCoords[nvi+4]= vsg::vec2(top,u1);
+						texCoords[nvi+5]= vsg::vec2(0,u1);
+					} else {
+						texCoords[nvi]= vsg::vec2(u1,0);
+						texCoords[nvi+1]= vsg::vec2(u2,0);
+						texCoords[nvi+2]= vsg::vec2(u2,top);
+						texCoords[nvi+3]= vsg::vec2(u2,top);
+						texCoords[nvi+4]= vsg::vec2(u1,top);
+						texCoords[nvi+5]= vsg::vec2(u1,0);
+					}
+				}
+				nvi+= 6;
+			}
+		}
+	});
+	if (nEndTris == 0)
+		return;
+	int eo0= shape->endVerts[0].offset;
+	float u0= shape->endVerts[0].u;
+	float v0= shape->endVerts[0].v;
+	for (int i=0; i<nv; i++) {
+		if (vInfo[i].nEdges != 1)
+			continue;
+		int nvi= endStart[i];
+		int vo= i*no;
+		int flip= i>0;
+		for (int j=2; j<shape->endVerts.size(); j++) {
+			int eo1= shape->endVerts[j-1].offset;
+			int eo2= shape->endVerts[j].offset;
+			float u1= shape->endVerts[j-1].u;
+			float v1= shape->endVerts[j-1].v;
+			float u2= shape->endVerts[j].u;
+			float v2= shape->endVerts[j].v;
+			verts[nvi]= vertv[vo+eo0];
+			texCoords[nvi]= vsg::vec2(u0,v0);
+			if (flip) {
+				verts[nvi+1]= vertv[vo+eo2];
+				verts[nvi+2]= vertv[vo+eo1];
+				texCoords[nvi+1]= vsg::vec2(u2,v2);
+				texCoords[nvi+2]= vsg::vec2(u1,v1);
+			} else {
+				verts[nvi+1]= vertv[vo+eo1];
+				verts[nvi+2]= vertv[vo+eo2];
+				texCoords[nvi+1]= vsg::vec2(u1,v1);
+				texCoords[nvi+2]= vsg::vec2(u2,v2);
 			}
+			nvi+= 3;
 		}
 	}
-	auto attributeArrays= vsg::DataList{verts,normals,texCoords,colors};
+}
+
+vsg::ref_ptr<vsg::StateGroup> Track::makeGeometry(vsg::ref_ptr<vsg::Options> vsgOptions)
+{
+	if (shape == NULL)
+		return NULL;
+	TrackMesh mesh;
+	makeMesh(mesh);
+	return mesh.makeStateGroup(shape,vsgOptions);
+}
+
+//	adds other's triangles to this mesh after transforming them by matrix
+void TrackMesh::append(const TrackMesh& other, const vsg::dmat4& matrix)
+{
+	int n= verts.size();
+	int m= other.verts.size();
+	verts.resize(n+m);
+	normals.resize(n+m);
+	texCoords.insert(texCoords.end(),other.texCoords.begin(),
+	  other.texCoords.end());
+	for (int i=0; i<m; i++) {
+		const vsg::vec3& v= other.verts[i];
+		vsg::dvec4 p= matrix*vsg::dvec4(v.x,v.y,v.z,1);
+		verts[n+i]= vsg::vec3(p.x,p.y,p.z);
+		const vsg::vec3& nv= other.normals[i];
+		vsg::dvec4 q= matrix*vsg::dvec4(nv.x,nv.y,nv.z,0);
+		normals[n+i]= vsg::vec3(q.x,q.y,q.z);
+	}
+}
+
+//	returns the mesh for shape in list, adding an empty one if needed
+TrackMesh& findTrackMesh(TrackMeshList& list, TrackShape* shape)
+{
+	for (auto& i: list)
+		if (i.first == shape)
+			return i.second;
+	list.push_back(make_pair(shape,TrackMesh()));
+	return list.back().second;
+}
+
+vsg::ref_ptr<vsg::StateGroup> TrackMesh::makeStateGroup(TrackShape* shape,
+  vsg::ref_ptr<vsg::Options> vsgOptions)
+{
+	int nv= verts.size();
+	auto vertArray= vsg::vec3Array::create(nv);
+	auto normalArray= vsg::vec3Array::create(nv);
+	auto texCoordArray= vsg::vec2Array::create(nv);
+	auto colors= vsg::vec4Array::create({vsg::vec4(1,1,1,1)});
+	for (int i=0; i<nv; i++) {
+		vertArray->at(i)= verts[i];
+		normalArray->at(i)= normals[i];
+		texCoordArray->at(i)= texCoords[i];
+	}
+	auto attributeArrays=
+	  vsg::DataList{vertArray,normalArray,texCoordArray,colors};
 	auto vd= vsg::VertexDraw::create();
 	vd->assignArrays(attributeArrays);
 	vd->vertexCount= nv;
@@ -82,6 +82,19 @@ struct TrackShape {
 	}
 	void matchOffsets();
 };
+
+//	triangle vertex data for one TrackShape, possibly from many tracks
+struct TrackMesh {
+	std::vector<vsg::vec3> verts;
+	std::vector<vsg::vec3> normals;
+	std::vector<vsg::vec2> texCoords;
+	void append(const TrackMesh& other, const vsg::dmat4& matrix);
+	vsg::ref_ptr<vsg::StateGroup> makeStateGroup(TrackShape* shape,
+	  vsg::ref_ptr<vsg::Options> vsgOptions);
+};
+typedef std::vector<std::pair<TrackShape*,TrackMesh>> TrackMeshList;
+TrackMesh& findTrackMesh(TrackMeshList& list, TrackShape* shape);
+
 typedef std::map<std::string,TrackShape*> TrackShapeMap;
 extern TrackShapeMap trackShapeMap;
 
@@ -32,10 +32,15 @@ using namespace std;
 #include "listener.h"
 #include "timetable.h"
 #include "ttosim.h"
+#include "jobs.h"
+#include "replay.h"
 
 TrainMap trainMap;
 TrainList trainList;
 TrainList oldTrainList;
+EdgeTrainMap edgeTrainMap;
+float simLODDistance= 2000;
+float simLODInterval= .25;
 Train* myTrain= nullptr;
 Train* following= nullptr;
 Train* riding= nullptr;
@@ -65,6 +70,8 @@ Train::Train(int id)
 	firstCar= nullptr;
 	lastCar= nullptr;
 	otherTrain= nullptr;
+	indexedHead= nullptr;
+	indexedTail= nullptr;
 	engAirBrake= nullptr;
 	speed= 0;
 	accel= 0;
@@ -88,11 +95,15 @@ Train::Train(int id)
 	accelMult= .1;
 	nextStopDist= 0;
 	nextStopTime= 0;
+	simLevel= 0;
+	simDt= 0;
+	airBControl= 0;
 };
 
 Train::~Train()
 {
 	trainIDMap.erase(id);
+	removeFromEdgeIndex();
 	while (firstCar != nullptr) {
 		RailCarInst* t= firstCar;
 		firstCar= t->next;
@@ -451,7 +462,7 @@ void Train::move(float dt)
 //	  tControl,bControl,dControl,speed,accel,nextStopDist);
 	if (remoteControl)
 		calcRemoteControlAccel(dt);
-	else if (modelCouplerSlack && nextStopDist==0)
+	else if (modelCouplerSlack && nextStopDist==0 && simLevel==0)
 		calcAccel2(dt);
 	else
 		calcAccel1(dt);
@@ -571,14 +582,115 @@ void Train::move(float dt)
 	}
 }
 
+//	decides how closely a train needs to be simulated
+//	trains near the camera, the user's train and trains sharing an
+//	edge with another train get full physics
+//	others are moved as a point mass every simLODInterval seconds
+//	the camera eye isn't saved in replays, so everything gets full
+//	physics while recording or replaying to keep the results the same
+int Train::findSimLevel()
+{
+	if (sessionReplay.isRecording() || sessionReplay.isReplaying())
+		return 0;
+	if (simLODDistance<=0 || !poseView.valid || this==myTrain ||
+	  remoteControl || location.edge->occupied>1 ||
+	  endLocation.edge->occupied>1)
+		return 0;
+	if (speed==0 && accel==0 && tControl==0 && nextStopDist==0)
+		return 1;
+	double d1= vsg::length(firstCar->getPosition()-poseView.eye);
+	double d2= vsg::length(lastCar->getPosition()-poseView.eye);
+	return d1>simLODDistance && d2>simLODDistance ? 1 : 0;
+}
+
+//	switches a train between full and reduced simulation
+//	while reduced the air brakes are frozen and their cylinder
+//	pressure is applied as an equivalent simple brake setting
+//	when promoted the brake handle is restored, any remaining time
+//	is simulated and the cars start out at the train speed so the
+//	coupler solve begins from a consistent state
+void Train::setSimLevel(int level)
+{
+	if (level == simLevel)
+		return;
+	if (level>0 && modelCouplerSlack && nextStopDist==0) {
+		airBControl= bControl;
+		float cyl= 0;
+		int n= 0;
+		for (RailCarInst* car=firstCar; car!=NULL; car=car->next) {
+			if (car->airBrake != NULL) {
+				cyl+= car->airBrake->getCylPressure();
+				n++;
+			}
+		}
+		float max= engAirBrake!=NULL ?
+		  engAirBrake->getMaxEqResPressure() : 0;
+		bControl= n>0 && max>0 ? cyl/n/(5*max/7) : 0;
+		if (bControl > 1)
+			bControl= 1;
+		float s= 0;
+		n= 0;
+		for (RailCarInst* car=firstCar; car!=NULL; car=car->next) {
+			s+= car->speed;
+			n++;
+		}
+		speed= n>0 ? s/n : 0;
+	} else if (level==0 && simLevel>0) {
+		if (simDt > 0)
+			move(simDt);
+		simDt= 0;
+		if (modelCouplerSlack && nextStopDist==0) {
+			bControl= airBControl;
+			for (RailCarInst* car=firstCar; car!=NULL;
+			  car=car->next) {
+				car->speed= speed;
+				car->force= 0;
+			}
+		}
+	}
+//	fprintf(stderr,"simLevel %s %d %d\n",name.c_str(),simLevel,level);
+	simLevel= level;
+}
+
 //	moves all trains and cleans up if any coupling
 void updateTrains(double dt)
 {
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i)
+		(*i)->updateEdgeIndex();
+	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i) {
+		Train* t= *i;
+		if (t->firstCar!=NULL && (t==myTrain || t->moving>0)) {
+			t->setSimLevel(t->findSimLevel());
+			if (t->simLevel > 0) {
+				t->simDt+= dt;
+				if (t->simDt < simLODInterval)
+					continue;
+				t->move(t->simDt);
+				t->simDt= 0;
+			} else {
+				t->move(dt);
+			}
+			t->updateEdgeIndex();
+		}
+	}
+	//	only cars the camera might see need their parts positioned now
+	//	others are updated when they come into view or are used
+	//	cars are positioned in parallel since each only writes its own
+	//	part transforms
+	static vector<RailCarInst*> poseCars;
+	poseCars.clear();
 	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i) {
 		Train* t= *i;
-		if (t->firstCar!=NULL && (t==myTrain || t->moving>0))
-			t->move(dt);
+		for (RailCarInst* car=t->firstCar; car!=NULL; car=car->next) {
+			if (car->poseValid || !poseView.isVisible(car))
+				continue;
+			poseCars.push_back(car);
+		}
 	}
+	jobSystem.parallelFor(0,poseCars.size(),8,[](int begin, int end) {
+		for (int i=begin; i<end; i++)
+			poseCars[i]->updatePose();
+	},JOB_HIGH);
 	if (oldTrainList.size() > 0) {
 		for (TrainList::iterator i=oldTrainList.begin();
 		  i!=oldTrainList.end(); ++i) {
@@ -632,8 +744,16 @@ Train* findTrain(double x, double y)
 }
 
 //	finds train containing specified car
+//	checks the trains indexed on the car's edge before trying them all
 Train* findTrain(RailCarInst* car)
 {
+	EdgeTrainMap::iterator j= edgeTrainMap.find(car->location.edge);
+	if (j != edgeTrainMap.end()) {
+		for (Train* t: j->second)
+			for (RailCarInst* c=t->firstCar; c!=NULL; c=c->next)
+				if (c == car)
+					return t;
+	}
 	for (TrainList::iterator i=trainList.begin(); i!=trainList.end(); ++i) {
 		Train* t= *i;
 		for (RailCarInst* c=t->firstCar; c!=NULL; c=c->next)
@@ -804,6 +924,8 @@ void Train::uncouple(RailCarInst* car, bool keepRear, int newID)
 	}
 	calcPerf();
 	newt->calcPerf();
+	updateEdgeIndex();
+	newt->updateEdgeIndex();
 	if (myTrain != NULL) {
 		newt->dControl= myTrain->dControl;
 		newt->tControl= myTrain->tControl;
@@ -1009,9 +1131,10 @@ float Train::otherDist(Track::Location* loc)
 	}
 	if (bestd < 1e30)
 		return bestd;
-	for (TrainList::iterator i=trainList.begin();
-	  i!=trainList.end(); ++i) {
-		Train* t= *i;
+	EdgeTrainMap::iterator i= edgeTrainMap.find(loc->edge);
+	if (i == edgeTrainMap.end())
+		return bestd;
+	for (Train* t: i->second) {
 		if (t == this)
 			continue;
 		float d= loc->distance(&t->location);
@@ -1030,6 +1153,56 @@ float Train::otherDist(Track::Location* loc)
 	return bestd;
 }
 
+//	adds the train to the index of trains on each edge it occupies
+//	the edges are only found again when an end moves to a new edge
+void Train::updateEdgeIndex()
+{
+	if (location.edge==indexedHead && endLocation.edge==indexedTail)
+		return;
+	removeFromEdgeIndex();
+	if (location.edge==NULL || endLocation.edge==NULL)
+		return;
+	indexedHead= location.edge;
+	indexedTail= endLocation.edge;
+	Track::Edge* e= endLocation.edge;
+	int rev= endLocation.rev;
+	for (int n=0; n<10000; n++) {
+		edgeTrainMap[e].push_back(this);
+		indexedEdges.push_back(e);
+		if (e == location.edge)
+			break;
+		Track::Vertex* v= rev ? e->v1 : e->v2;
+		Track::Edge* next= e!=v->edge1 ? v->edge1 : v->edge2;
+		if (next == NULL)
+			break;
+		rev= v==next->v1 ? 0 : 1;
+		e= next;
+	}
+}
+
+//	removes the train from the edge index
+void Train::removeFromEdgeIndex()
+{
+	for (Track::Edge* e: indexedEdges) {
+		EdgeTrainMap::iterator i= edgeTrainMap.find(e);
+		if (i == edgeTrainMap.end())
+			continue;
+		std::vector<Train*>& trains= i->second;
+		for (int j=0; j<trains.size(); j++) {
+			if (trains[j] == this) {
+				trains[j]= trains.back();
+				trains.pop_back();
+				break;
+			}
+		}
+		if (trains.size() == 0)
+			edgeTrainMap.erase(i);
+	}
+	indexedEdges.clear();
+	indexedHead= nullptr;
+	indexedTail= nullptr;
+}
+
 //	reverses a train so that the other end is the forward end
 void Train::reverse()
 {
@@ -28,6 +28,8 @@ THE SOFTWARE.
 #include <list>
 #include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "track.h"
 #include "railcar.h"
@@ -44,6 +46,9 @@ struct Train {
 	RailCarInst* firstCar;
 	RailCarInst* lastCar;
 	Train* otherTrain;
+	std::vector<Track::Edge*> indexedEdges;
+	Track::Edge* indexedHead;
+	Track::Edge* indexedTail;
 	float speed;
 	float accel;
 	float positionError;
@@ -70,6 +75,9 @@ struct Train {
 	float maxDecel;
 	float nextStopDist;
 	float nextStopTime;
+	int simLevel;		// 0 full physics, 1 reduced
+	float simDt;		// time not yet simulated at reduced level
+	float airBControl;	// brake handle saved while reduced
 	SigDistList signalList;
 	Train(int id= -1);
 	~Train();
@@ -79,6 +87,8 @@ struct Train {
 	void calcAccel2(float dt);
 	void calcRemoteControlAccel(float dt);
 	void adjustControls(float dt);
+	int findSimLevel();
+	void setSimLevel(int level);
 	void convertToAirBrakes();
 	void convertFromAirBrakes();
 	void setMaxEqResPressure(float maxEqRes);
@@ -88,6 +98,8 @@ struct Train {
 	void setOccupied();
 	void clearOccupied();
 	float otherDist(Track::Location* other);
+	void updateEdgeIndex();
+	void removeFromEdgeIndex();
 	void selectRandomCars(int min, int max, int nEng, int nCab);
 	void selectCars(int nEng, int nCab, std::list<int>& carList);
 	void positionCars();
@@ -184,7 +196,11 @@ typedef std::map<std::string,Train*> TrainMap;
 extern TrainMap trainMap;
 typedef std::list<Train*> TrainList;
 extern TrainList trainList;
+typedef std::unordered_map<Track::Edge*,std::vector<Train*>> EdgeTrainMap;
+extern EdgeTrainMap edgeTrainMap;
 extern TrainList oldTrainList;
+extern float simLODDistance;
+extern float simLODInterval;
 extern Train *following;
 extern Train *riding;
 extern Train *myTrain;
@@ -34,6 +34,8 @@ THE SOFTWARE.
 #include "tsgui.h"
 #include "camerac.h"
 #include "ttosim.h"
+#include "replay.h"
+#include "snapshot.h"
 
 TrainController::TrainController()
 {
@@ -43,79 +45,113 @@ void TrainController::apply(vsg::KeyPressEvent& keyPress)
 {
 	if (keyPress.handled)
 		return;
-	if (keyPress.keyBase=='c' && (keyPress.keyModifier&vsg::MODKEY_Shift)!=0) {
-		myTrain= selectedTrain;
-		myRailCar= selectedRailCar;
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == vsg::KEY_F5) {
+	if (keyPress.keyBase == vsg::KEY_F5) {
 		TSGuiData::instance().showStatus= !TSGuiData::instance().showStatus;
 		keyPress.handled= true;
-	} else if (keyPress.keyBase == 'z') {
-		timeMult/= 2;
+	} else if (keyPress.keyBase == vsg::KEY_F6) {
+		TSGuiData::instance().showProfile= !TSGuiData::instance().showProfile;
+		keyPress.handled= true;
+	} else if (keyPress.keyBase == vsg::KEY_F7) {
+		if (saveSnapshot(snapshotPath.c_str()))
+			TSGuiData::instance().displayMessage("saved "+snapshotPath);
+		keyPress.handled= true;
+	} else if (keyPress.keyBase == vsg::KEY_F8) {
+		//	a restore isn't part of a recorded session
+		if (sessionReplay.isRecording() || sessionReplay.isReplaying())
+			TSGuiData::instance().displayMessage(
+			  "cannot restore while recording or replaying");
+		else if (loadSnapshot(snapshotPath.c_str()))
+			TSGuiData::instance().displayMessage(
+			  "restored "+snapshotPath);
+		else
+			TSGuiData::instance().displayMessage(
+			  "cannot restore "+snapshotPath);
 		keyPress.handled= true;
-	} else if (keyPress.keyBase == 'x') {
+	}
+	//	simulation input comes from the session file when replaying
+	if (keyPress.handled || sessionReplay.isReplaying())
+		return;
+	if (handleKey(keyPress.keyBase,keyPress.keyModifier)) {
+		sessionReplay.recordKey(keyPress.keyBase,keyPress.keyModifier);
+		keyPress.handled= true;
+	}
+}
+
+//	changes the simulation state for a key
+//	returns true if the key was used
+bool TrainController::handleKey(int keyBase, int keyModifier)
+{
+	bool handled= false;
+	if (keyBase=='c' && (keyModifier&vsg::MODKEY_Shift)!=0) {
+		myTrain= selectedTrain;
+		myRailCar= selectedRailCar;
+		handled= true;
+	} else if (keyBase == 'z') {
+		timeMult/= 2;
+		handled= true;
+	} else if (keyBase == 'x') {
 		if (timeMult == 0)
 			timeMult= 1;
 		else if (timeMult < 1000)
 			timeMult*= 2;
-		keyPress.handled= true;
+		handled= true;
 	}
-	if (keyPress.handled || !myTrain)
-		return;
-	if (keyPress.keyBase == 'a') {
+	if (handled || !myTrain)
+		return handled;
+	if (keyBase == 'a') {
 		myTrain->decThrottle();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == 'd') {
+		handled= true;
+	} else if (keyBase == 'd') {
 		myTrain->incThrottle();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == 's') {
+		handled= true;
+	} else if (keyBase == 's') {
 		myTrain->decReverser();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == 'w') {
+		handled= true;
+	} else if (keyBase == 'w') {
 		myTrain->incReverser();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == ';') {
+		handled= true;
+	} else if (keyBase == ';') {
 		myTrain->decBrakes();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == '\'') {
+		handled= true;
+	} else if (keyBase == '\'') {
 		myTrain->incBrakes();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == '[') {
-		if ((keyPress.keyModifier&vsg::MODKEY_Shift) == 0) {
+		handled= true;
+	} else if (keyBase == '[') {
+		if ((keyModifier&vsg::MODKEY_Shift) == 0) {
 			myTrain->decEngBrakes();
-			keyPress.handled= true;
+			handled= true;
 		} else if (selectedRailCar) {
 			selectedRailCar->decHandBrakes();
-			keyPress.handled= true;
+			handled= true;
 		}
-	} else if (keyPress.keyBase == ']') {
-		if ((keyPress.keyModifier&vsg::MODKEY_Shift) == 0) {
+	} else if (keyBase == ']') {
+		if ((keyModifier&vsg::MODKEY_Shift) == 0) {
 			myTrain->incEngBrakes();
-			keyPress.handled= true;
+			handled= true;
 		} else if (selectedRailCar) {
 			selectedRailCar->incHandBrakes();
-			keyPress.handled= true;
+			handled= true;
 		}
-	} else if (keyPress.keyBase == '/') {
+	} else if (keyBase == '/') {
 		myTrain->bailOff();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == '<') {
+		handled= true;
+	} else if (keyBase == '<') {
 		myTrain->nextStopDist= myTrain->coupleDistance(true);
 		if (myTrain->targetSpeed < -myTrain->speed)
 			myTrain->targetSpeed= -myTrain->speed;
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == '>') {
+		handled= true;
+	} else if (keyBase == '>') {
 		myTrain->nextStopDist= myTrain->coupleDistance(false);
 		if (myTrain->targetSpeed < myTrain->speed)
 			myTrain->targetSpeed= myTrain->speed;
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == '^') {
+		handled= true;
+	} else if (keyBase == '^') {
 		myTrain->targetSpeed*= 1.4;
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == ',') {
+		handled= true;
+	} else if (keyBase == ',') {
 		myTrain->targetSpeed/= 1.4;
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == '.') {
+		handled= true;
+	} else if (keyBase == '.') {
 		float d= .5*myTrain->speed*myTrain->speed/(myTrain->decelMult*myTrain->decelMult);
 		float mind= .5*myTrain->speed*myTrain->speed/myTrain->maxDecel;
 		if (myTrain->speed < 0) {
@@ -129,15 +165,16 @@ void TrainController::apply(vsg::KeyPressEvent& keyPress)
 				myTrain->nextStopDist= d;
 		}
 		myTrain->targetSpeed/= 1.4;
-		keyPress.handled= true;
-	} else if (keyPress.keyBase == 'g') {
-		myTrain->throwSwitch((keyPress.keyModifier&vsg::MODKEY_Shift));
-		keyPress.handled= true;
-	} else if (keyPress.keyBase=='c' && (keyPress.keyModifier&vsg::MODKEY_Shift)==0) {
+		handled= true;
+	} else if (keyBase == 'g') {
+		myTrain->throwSwitch((keyModifier&vsg::MODKEY_Shift));
+		handled= true;
+	} else if (keyBase=='c' && (keyModifier&vsg::MODKEY_Shift)==0) {
 		myTrain->connectAirHoses();
-		keyPress.handled= true;
-	} else if (keyPress.keyBase=='u' && myLookAt) {
+		handled= true;
+	} else if (keyBase=='u' && myLookAt) {
 		myTrain->uncouple(myLookAt->center);
-		keyPress.handled= true;
+		handled= true;
 	}
+	return handled;
 }
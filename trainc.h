@@ -30,4 +30,5 @@ class TrainController : public vsg::Inherit<vsg::Visitor, TrainController>
  public:
 	TrainController();
 	void apply(vsg::KeyPressEvent& keyPress) override;
+	bool handleKey(int keyBase, int keyModifier);
 };
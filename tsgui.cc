@@ -27,6 +27,7 @@ THE SOFTWARE.
 #include <vsgImGui/imgui.h>
 #include <string>
 #include <filesystem>
+#include <map>
 
 using namespace std;
 using namespace filesystem;
@@ -34,9 +35,13 @@ using namespace filesystem;
 #include "tsgui.h"
 #include "mstsroute.h"
 #include "mstsfile.h"
+#include "mstsace.h"
 #include "train.h"
 #include "ttosim.h"
 #include "camerac.h"
+#include "profiler.h"
+#include "residency.h"
+#include "catalog.h"
 
 void TSGui::record(vsg::CommandBuffer& cb) const
 {
@@ -45,6 +50,11 @@ void TSGui::record(vsg::CommandBuffer& cb) const
 		ImGui::Begin("Train Status",&data.showStatus);
 		int t= (int)simTime;
 		ImGui::Text("Time: %d:%2.2d:%2.2d Time Mult: %d fps %.1lf",t/3600,t/60%60,t%60,timeMult,data.fps);
+		size_t texLoaded,texUncompressed;
+		getACEMemory(texLoaded,texUncompressed);
+		ImGui::Text("Textures: %.1f MB (%.1f MB uncompressed)",texLoaded/1048576.,texUncompressed/1048576.);
+		ResidencyManager& rm= residencyManager;
+		ImGui::Text("Tiles: %d terrain %d terrain models %d models %.1f MB",rm.nTerrain,rm.nTerrModels,rm.nModels,rm.totalBytes()/1048576.);
 		if (myTrain) {
 			ImGui::Text("Speed: %.1f mph",myTrain->speed*2.23693);
 			ImGui::Text("Accel: %6.3f g  %6.3f%%",myTrain->accel/9.8,-100*myTrain->location.grade());
@@ -105,6 +115,8 @@ void TSGui::record(vsg::CommandBuffer& cb) const
 		ImGui::End();
 	}
 	if (data.showSelect) {
+		if (!mstsRoute)
+			data.updateRouteList();
 		ImGui::Begin("Select",&data.showSelect);
 		if (ImGui::BeginCombo("",data.selected.c_str())) {
 			for (auto s: data.listItems) {
@@ -129,39 +141,86 @@ void TSGui::record(vsg::CommandBuffer& cb) const
 			ImGui::TextWrapped("%s",s.c_str());
 		ImGui::End();
 	}
+	if (data.showProfile) {
+		ImGui::Begin("Profile",&data.showProfile);
+		bool enabled= profiler.enabled;
+		if (ImGui::Checkbox("Enabled",&enabled))
+			profiler.enabled= enabled;
+		ImGui::SameLine();
+		if (ImGui::Button("Save Trace") &&
+		  profiler.saveTrace("vsgts-trace.json"))
+			data.displayMessage("trace saved in vsgts-trace.json");
+		//	recent durations of each phase in ms, oldest first
+		vector<ProfileEvent> events;
+		vector<int> threadIDs;
+		profiler.getEvents(events,threadIDs);
+		map<string,vector<float>> phases;
+		for (auto& e: events)
+			phases[e.name].push_back(.001*(e.end-e.start));
+		for (auto& p: phases) {
+			vector<float>& times= p.second;
+			int n= times.size()<120 ? times.size() : 120;
+			const float* t= &times[times.size()-n];
+			float sum= 0;
+			float max= 0;
+			for (int i=0; i<n; i++) {
+				sum+= t[i];
+				if (max < t[i])
+					max= t[i];
+			}
+			char label[100];
+			snprintf(label,sizeof(label),"%s\navg %.2f max %.2f ms",
+			  p.first.c_str(),sum/n,max);
+			ImGui::PlotHistogram(label,t,n,0,nullptr,0,max,
+			  ImVec2(0,40));
+		}
+		ImGui::End();
+	}
 }
 
+//	fills the list with the routes in the catalog and starts a catalog
+//	refresh, updateRouteList replaces the list if the refresh finds
+//	changes
 void TSGuiData::loadRouteList()
 {
 	listItems.clear();
 	auto paths= vsg::getEnvPaths("MSTSDIRS");
-	for (auto p: paths) {
-		path mstsDir= p.string();
-		for (const directory_entry& d: recursive_directory_iterator(mstsDir)) {
-			const path& f= d;
-			if (f.extension() == ".tdb") {
-				path tdbFile= mstsDir;
-				tdbFile/= f;
-				listItems.push_back(tdbFile);
-			}
-		}
-	}
+	vector<string> roots;
+	for (auto p: paths)
+		roots.push_back(p.string());
+	routeCatalog.start(roots);
+	routeCatalog.getFiles(".tdb",listItems);
 	sort(listItems.begin(),listItems.end());
 	selected= "Select a route";
 	showSelect= true;
 }
 
+void TSGuiData::updateRouteList()
+{
+	if (!routeCatalog.takeUpdate())
+		return;
+	listItems.clear();
+	routeCatalog.getFiles(".tdb",listItems);
+	sort(listItems.begin(),listItems.end());
+}
+
 void TSGuiData::loadActivityList()
 {
 	listItems.clear();
 	path p { fixFilenameCase(mstsRoute->routeDir+mstsRoute->dirSep+"ACTIVITIES") };
-	for (const directory_entry& d: directory_iterator(p)) {
-		const path& f= d;
-		if (f.extension() == ".act")
-			listItems.push_back(f.stem());
-		sort(listItems.begin(),listItems.end());
-		selected= "Select an activity";
+	vector<string> files;
+	if (routeCatalog.getFiles(p.string(),".act",files)) {
+		for (auto& f: files)
+			listItems.push_back(path(f).stem());
+	} else {
+		for (const directory_entry& d: directory_iterator(p)) {
+			const path& f= d;
+			if (f.extension() == ".act")
+				listItems.push_back(f.stem());
+		}
 	}
+	sort(listItems.begin(),listItems.end());
+	selected= "Select an activity";
 	showSelect= true;
 }
 
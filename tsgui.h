@@ -43,10 +43,12 @@ public:
 	bool showMessage;
 	bool showStatus;
 	bool showSelect;
+	bool showProfile;
 	double fps;
 	std::vector<std::string> listItems;
 	std::string selected;
 	void loadRouteList();
+	void updateRouteList();
 	void loadActivityList();
 	void displayMessage(std::string message);
 	void updateFPS(double dt) {
@@ -57,6 +59,7 @@ private:
 		showMessage= false;
 		showStatus= false;
 		showSelect= false;
+		showProfile= false;
 		fps= 0;
 	}
 };
@@ -62,6 +62,7 @@ int main(int argc, char** argv)
 	arguments.read("--display", windowTraits->display);
 	if (arguments.errors())
 		return arguments.writeErrorMessages(std::cerr);
+	aceCacheDir= defaultACECacheDir();
 	options->add(vsgXchange::all::create());
 	options->add(MstsAceReaderWriter::create());
 	options->add(MstsShapeReaderWriter::create());
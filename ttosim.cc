@@ -45,6 +45,7 @@ THE SOFTWARE.
 #include "switcher.h"
 #include "listener.h"
 #include "signal.h"
+#include "snapshot.h"
 
 double simTime;
 int timeMult= 1;
@@ -55,6 +56,8 @@ using namespace std;
 struct AIEvent : public tt::Event<double> {
 	AITrain* train;
  public:
+	enum { CREATETRAIN, PATHSTART, DEPARTURE, STOPPED, TAKESIDING,
+	  LEAVESIDING, LOCALSWITCHING };
 	AIEvent(double time, AITrain* train) :
 	  tt::Event<double>(time) {
 		this->train= train;
@@ -62,6 +65,9 @@ struct AIEvent : public tt::Event<double> {
 	};
 	void handle(tt::EventSim<double>* sim);
 	virtual void handleAI(tt::EventSim<double>* sim)=0;
+	virtual int getType()=0;
+	virtual int getRow() { return -1; };
+	virtual bool getFlag() { return false; };
 };
 
 void AIEvent::handle(tt::EventSim<double>* sim)
@@ -79,6 +85,8 @@ class CreateTrain : public AIEvent {
 	  AIEvent(time,train) {
 		this->row= row;
 	};
+	int getType() { return CREATETRAIN; };
+	int getRow() { return row; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
@@ -91,6 +99,9 @@ class PathStart : public AIEvent {
 		this->row= row;
 		checkLastRow= checkLast;
 	};
+	int getType() { return PATHSTART; };
+	int getRow() { return row; };
+	bool getFlag() { return checkLastRow; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
@@ -101,6 +112,8 @@ class Departure : public AIEvent {
 	  AIEvent(time,train) {
 		this->row= row;
 	};
+	int getType() { return DEPARTURE; };
+	int getRow() { return row; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
@@ -109,6 +122,7 @@ class Stopped : public AIEvent {
 	Stopped(double time, AITrain* train) :
 	  AIEvent(time,train) {
 	};
+	int getType() { return STOPPED; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
@@ -119,6 +133,8 @@ class TakeSiding : public AIEvent {
 	  AIEvent(time,train) {
 		this->row= row;
 	};
+	int getType() { return TAKESIDING; };
+	int getRow() { return row; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
@@ -129,6 +145,8 @@ class LeaveSiding : public AIEvent {
 	  AIEvent(time,train) {
 		this->row= row;
 	};
+	int getType() { return LEAVESIDING; };
+	int getRow() { return row; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
@@ -139,9 +157,35 @@ class LocalSwitching : public AIEvent {
 	  AIEvent(time,train) {
 		this->row= row;
 	};
+	int getType() { return LOCALSWITCHING; };
+	int getRow() { return row; };
 	void handleAI(tt::EventSim<double>* sim);
 };
 
+//	recreates an event saved in a snapshot
+static AIEvent* makeAIEvent(int type, double time, AITrain* train, int row,
+  bool flag)
+{
+	switch (type) {
+	 case AIEvent::CREATETRAIN:
+		return new CreateTrain(time,train,row);
+	 case AIEvent::PATHSTART:
+		return new PathStart(time,train,row,flag);
+	 case AIEvent::DEPARTURE:
+		return new Departure(time,train,row);
+	 case AIEvent::STOPPED:
+		return new Stopped(time,train);
+	 case AIEvent::TAKESIDING:
+		return new TakeSiding(time,train,row);
+	 case AIEvent::LEAVESIDING:
+		return new LeaveSiding(time,train,row);
+	 case AIEvent::LOCALSWITCHING:
+		return new LocalSwitching(time,train,row);
+	 default:
+		return NULL;
+	}
+}
+
 //	calculates estimated time when train will arrival at station nextRow
 double calcETA(double time, AITrain* train, int row, int nextRow)
 {
@@ -1357,3 +1401,150 @@ void AITrain::recordOnSheet(int row, int time, bool autoOS)
 	msg+= "  ";
 	listener.playMorse(msg.c_str());
 }
+
+//	saves or restores AI train progress, the train sheet, block times,
+//	dispatcher state and pending events
+//	switching moves are planned again after a restore
+void TTOSim::snapshot(SnapshotFile& f)
+{
+	bool hasTimeTable= timeTable!=NULL;
+	f.io(hasTimeTable);
+	if (hasTimeTable != (timeTable!=NULL)) {
+		f.fail("timetable");
+		return;
+	}
+	if (!hasTimeTable)
+		return;
+	dispatcher.snapshot(f);
+	int n= timeTable->getNumTrains();
+	f.io(n);
+	if (n != timeTable->getNumTrains()) {
+		f.fail("timetable train count");
+		return;
+	}
+	if (!f.isWriting())
+		movingTrains.clear();
+	for (int i=0; i<n && f.good(); i++) {
+		AITrain* t= (AITrain*) timeTable->getTrain(i);
+		f.io(t->consist);
+		f.io(t->approachTest);
+		f.io(t->takeSiding);
+		f.io(t->osDist);
+		f.io(t->targetSpeed);
+		f.io(t->sidingSwitch);
+		f.io(t->moveAuth.distance);
+		f.io(t->moveAuth.updateDistance);
+		f.io(t->moveAuth.waitTime);
+		f.io(t->path,t->moveAuth.nextNode);
+		f.io(t->moveAuth.farVertex);
+		f.io(t->message);
+		int row= t->getCurrentRow();
+		bool active= t->getActive();
+		bool moving= movingTrains.find(t)!=movingTrains.end();
+		f.io(row);
+		f.io(active);
+		f.io(moving);
+		std::vector<tt::TrainTime>& times= t->getTimes();
+		int m= times.size();
+		f.io(m);
+		if (m != times.size()) {
+			f.fail("timetable rows");
+			return;
+		}
+		for (int j=0; j<m; j++) {
+			f.io(times[j].actualAr);
+			f.io(times[j].actualLv);
+			f.io(times[j].wait);
+		}
+		if (f.isWriting())
+			continue;
+		t->setRow(row);
+		t->setActive(active);
+		if (moving && t->consist!=NULL)
+			movingTrains.insert(t);
+		if (t->switcher != NULL) {
+			delete t->switcher;
+			t->switcher= NULL;
+		}
+		t->event= NULL;
+	}
+	n= timeTable->getNumBlocks();
+	f.io(n);
+	if (n != timeTable->getNumBlocks()) {
+		f.fail("timetable block count");
+		return;
+	}
+	for (int i=0; i<n && f.good(); i++) {
+		tt::Block* b= timeTable->getBlock(i);
+		int m= b->trainTimes.size();
+		f.io(m);
+		if (!f.isWriting())
+			b->trainTimes.clear();
+		for (int j=0; j<m && f.good(); j++) {
+			tt::BlockTimes bt(NULL,-1);
+			if (f.isWriting())
+				bt= b->trainTimes[j];
+			int k= -1;
+			for (int l=0; f.isWriting() &&
+			  l<timeTable->getNumTrains(); l++)
+				if (timeTable->getTrain(l) == bt.train)
+					k= l;
+			f.io(k);
+			f.io(bt.timeGiven);
+			f.io(bt.timeEntered);
+			f.io(bt.timeCleared);
+			if (f.isWriting())
+				continue;
+			if (k>=0 && k<timeTable->getNumTrains())
+				bt.train= timeTable->getTrain(k);
+			b->trainTimes.push_back(bt);
+		}
+	}
+	//	only events that are still current for their train are saved
+	std::vector<tt::Event<double>*> events;
+	if (f.isWriting())
+		getEvents(events);
+	else
+		clearEvents();
+	n= 0;
+	for (int i=0; i<events.size(); i++) {
+		AIEvent* e= (AIEvent*) events[i];
+		if (e->train->event == e)
+			n++;
+	}
+	f.io(n);
+	for (int i=0, j=0; i<n && f.good(); i++) {
+		AIEvent* e= NULL;
+		if (f.isWriting()) {
+			do {
+				e= (AIEvent*) events[j++];
+			} while (e->train->event != e);
+		}
+		int type= e ? e->getType() : -1;
+		double time= e ? e->time : 0;
+		int k= -1;
+		for (int l=0; e!=NULL && l<timeTable->getNumTrains(); l++)
+			if (timeTable->getTrain(l) == e->train)
+				k= l;
+		int row= e ? e->getRow() : -1;
+		bool flag= e ? e->getFlag() : false;
+		f.io(type);
+		f.io(time);
+		f.io(k);
+		f.io(row);
+		f.io(flag);
+		if (f.isWriting())
+			continue;
+		if (k<0 || k>=timeTable->getNumTrains()) {
+			f.fail("event train");
+			return;
+		}
+		AITrain* t= (AITrain*) timeTable->getTrain(k);
+		e= makeAIEvent(type,time,t,row,flag);
+		if (e == NULL) {
+			f.fail("event type");
+			return;
+		}
+		schedule(e);
+	}
+}
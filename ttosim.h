@@ -36,6 +36,7 @@ THE SOFTWARE.
 typedef Train Consist;
 
 struct Switcher;
+class SnapshotFile;
 
 struct AIEvent;
 
@@ -90,6 +91,7 @@ struct TTOSim : public tt::EventSim<double> {
 	bool takeControlOfAI(Consist* train);
 	bool convertToAI(Consist* train);
 	bool osUserTrain(Consist* train, double time);
+	void snapshot(SnapshotFile& f);
 };
 extern TTOSim ttoSim;
 extern double simTime;
@@ -28,6 +28,7 @@ THE SOFTWARE.
 #include <vsgImGui/SendEventsToImGui.h>
 #include <iostream>
 #include <chrono>
+#include <time.h>
 
 #include "parser.h"
 #include "mstsace.h"
@@ -42,9 +43,28 @@ THE SOFTWARE.
 #include "ttosim.h"
 #include "timetable.h"
 #include "activity.h"
+#include "profiler.h"
+#include "replay.h"
+#include "residency.h"
+#include "snapshot.h"
+#include "jobs.h"
 
 vsg::AmbientLight* ambLight;
 vsg::DirectionalLight* dirLight;
+std::string restoreFile;
+
+//	applies --restore-state once the trains it refers to are loaded
+void restoreState()
+{
+	if (restoreFile.size() == 0)
+		return;
+	if (loadSnapshot(restoreFile.c_str()))
+		TSGuiData::instance().displayMessage("restored "+restoreFile);
+	else
+		TSGuiData::instance().displayMessage("cannot restore "+
+		  restoreFile);
+	restoreFile.clear();
+}
 
 void initSim(vsg::ref_ptr<vsg::Group>& root)
 {
@@ -124,56 +144,49 @@ void updateLightDirection()
 	}
 }
 
+//	starts animations for switches thrown since the last call,
+//	switches stay in the list until any running animation finishes
+Track::SwVertexList animatedSwitches;
 void startSwitchAnimation(vsg::ref_ptr<vsg::AnimationManager> manager)
 {
-	for (auto i: trackMap) {
-		for (auto v: i.second->vertexList) {
-			if (v->type == Track::VT_SWITCH) {
-				auto sw= (Track::SwVertex*)v;
-				if (!sw->animation || sw->animation->active())
-					continue;
-				if (sw->edge2==sw->swEdges[sw->mainEdge] && sw->animation->time>.5) {
-					sw->animation->speed= -.1;
-					manager->play(sw->animation,sw->animation->time);
-				}
-				if (sw->edge2!=sw->swEdges[sw->mainEdge] && sw->animation->time<.5) {
-					sw->animation->speed= .1;
-					manager->play(sw->animation,sw->animation->time);
-				}
-			}
+	takeSwitchAnimations(animatedSwitches);
+	int n= 0;
+	for (auto sw: animatedSwitches) {
+		if (!sw->animation)
+			continue;
+		if (sw->animation->active()) {
+			animatedSwitches[n++]= sw;
+			continue;
+		}
+		if (sw->edge2==sw->swEdges[sw->mainEdge] && sw->animation->time>.5) {
+			sw->animation->speed= -.1;
+			manager->play(sw->animation,sw->animation->time);
+		}
+		if (sw->edge2!=sw->swEdges[sw->mainEdge] && sw->animation->time<.5) {
+			sw->animation->speed= .1;
+			manager->play(sw->animation,sw->animation->time);
 		}
 	}
+	animatedSwitches.resize(n);
 }
 
 void updateActivityEvents()
 {
-	if (!mstsRoute)
+	if (!mstsRoute || activityEvents.size()==0)
 		return;
-	for (auto i=mstsRoute->eventMap.begin(); i!=mstsRoute->eventMap.end(); i++) {
-		auto event= i->second;
-		if (event->time>0 && event->time<simTime) {
-			TSGuiData::instance().displayMessage(event->message);
-			mstsRoute->eventMap.erase(i);
-			return;
-		}
+	std::vector<Event*> fired;
+	if (myTrain) {
+		WLocation loc;
+		myTrain->location.getWLocation(&loc);
+		double position[2]= { loc.coord[0], loc.coord[1] };
+		activityEvents.update(simTime,position,myTrain->speed==0,
+		  fired);
+	} else {
+		activityEvents.update(simTime,NULL,false,fired);
 	}
-	if (!myTrain)
-		return;
-	WLocation loc;
-	myTrain->location.getWLocation(&loc);
-	for (auto i=mstsRoute->eventMap.begin(); i!=mstsRoute->eventMap.end(); i++) {
-		auto event= i->second;
-		if (event->time>0)
-			continue;
-		auto dx= mstsRoute->convX(event->tx,event->x) - loc.coord[0];
-		auto dy= mstsRoute->convZ(event->tz,event->z) - loc.coord[1];
-		if (event->radius*event->radius < dx*dx+dy*dy)
-			continue;
-		if (event->onStop && myTrain->speed != 0)
-			continue;
+	for (auto event: fired) {
 		TSGuiData::instance().displayMessage(event->message);
-		mstsRoute->eventMap.erase(i);
-		return;
+		mstsRoute->eventMap.erase(event->id);
 	}
 }
 
@@ -184,8 +197,14 @@ void updateSim(double dt, vsg::ref_ptr<vsg::Group>& root, vsg::ref_ptr<vsg::View
 		if (timeMult > 0) {
 			dt*= timeMult;
 			simTime+= dt;
-			updateTrains(dt);
-			ttoSim.processEvents(simTime);
+			{
+				ProfileScope ps("updateTrains");
+				updateTrains(dt);
+			}
+			{
+				ProfileScope ps("processEvents");
+				ttoSim.processEvents(simTime);
+			}
 			startSwitchAnimation(viewer->animationManager);
 			updateActivityEvents();
 			updateLightDirection();
@@ -197,6 +216,7 @@ void updateSim(double dt, vsg::ref_ptr<vsg::Group>& root, vsg::ref_ptr<vsg::View
 		}
 	} else if (mstsRoute && mstsRoute->activityName.size()>0) {
 		auto railCars= vsg::Group::create();
+		sessionReplay.recordActivity(mstsRoute->activityName);
 		mstsRoute->activityName+= ".act";
 		mstsRoute->loadActivity(railCars.get(),-1);
 		mstsRoute->activityName.clear();
@@ -206,12 +226,14 @@ void updateSim(double dt, vsg::ref_ptr<vsg::Group>& root, vsg::ref_ptr<vsg::View
 		ttoSim.init(false);
 		for (auto t: trainList)
 			listener.addTrain(t);
+		restoreState();
 		listener.setGain(1);
 	} else if (!mstsRoute && !TSGuiData::instance().showSelect && TSGuiData::instance().selected.find(".tdb")) {
 		auto options= vsg::Options::create();
 		options->add(MstsRouteReader::create());
 		options->add(MstsTerrainReader::create());
 		vsg::Path filename= TSGuiData::instance().selected;
+		sessionReplay.recordRoute(TSGuiData::instance().selected);
 		auto object= vsg::read(filename, options);
 		if (auto node= object.cast<vsg::Node>()) {
 			auto cr= viewer->compileManager->compile(node);
@@ -223,6 +245,38 @@ void updateSim(double dt, vsg::ref_ptr<vsg::Group>& root, vsg::ref_ptr<vsg::View
 	}
 }
 
+//	applies the input recorded for one frame
+void replayFrame(ReplayFrame& frame, vsg::ref_ptr<TrainController> controller)
+{
+	if (frame.route.size() > 0) {
+		TSGuiData::instance().selected= frame.route;
+		TSGuiData::instance().showSelect= false;
+	}
+	if (frame.activity.size()>0 && mstsRoute) {
+		mstsRoute->activityName= frame.activity;
+		TSGuiData::instance().showSelect= false;
+	}
+	for (auto& key: frame.keys) {
+		selectedTrain= Train::findTrain(key.selectedTrain);
+		selectedRailCar= nullptr;
+		if (selectedTrain) {
+			RailCarInst* car= selectedTrain->firstCar;
+			for (int i=0; car && i<key.selectedCar; i++)
+				car= car->next;
+			if (key.selectedCar >= 0)
+				selectedRailCar= car;
+		}
+		vsg::dvec3 center;
+		if (myLookAt) {
+			center= myLookAt->center;
+			myLookAt->center= key.center;
+		}
+		controller->handleKey(key.keyBase,key.keyModifier);
+		if (myLookAt)
+			myLookAt->center= center;
+	}
+}
+
 int main(int argc, char** argv)
 {
 	auto options= vsg::Options::create();
@@ -239,8 +293,43 @@ int main(int argc, char** argv)
 	}
 	arguments.read("--screen", windowTraits->screenNum);
 	arguments.read("--display", windowTraits->display);
+	arguments.read("--car-detail-range", poseView.range);
+	arguments.read("--sim-lod-distance", simLODDistance);
+	arguments.read("--sim-lod-interval", simLODInterval);
+	if (arguments.read("--no-texture-compression"))
+		aceCompression= false;
+	if (arguments.read("--no-mipmap-generation"))
+		aceMipmaps= false;
+	if (!arguments.read("--texture-cache", aceCacheDir))
+		aceCacheDir= defaultACECacheDir();
+	int tileBudget= 0;
+	if (arguments.read("--tile-budget",tileBudget))
+		residencyManager.budget= (size_t)tileBudget*1024*1024;
+	if (arguments.read("--profile"))
+		profiler.enabled= true;
+	int hashInterval= 60;
+	if (arguments.read("--hash-interval",hashInterval))
+		sessionReplay.setHashInterval(hashInterval);
+	std::string recordFile,replayFile;
+	arguments.read("--record",recordFile);
+	arguments.read("--replay",replayFile);
+	arguments.read("--save-state",snapshotPath);
+	arguments.read("--restore-state",restoreFile);
+	int nJobThreads= -1;
+	arguments.read("--jobs",nJobThreads);
 	if (arguments.errors())
 		return arguments.writeErrorMessages(std::cerr);
+	jobSystem.start(nJobThreads);
+	long seed= time(NULL);
+	if (replayFile.size() > 0) {
+		if (!sessionReplay.startReplay(replayFile.c_str()))
+			return 1;
+		seed= sessionReplay.getSeed();
+	} else if (recordFile.size() > 0) {
+		if (!sessionReplay.startRecording(recordFile.c_str(),seed))
+			return 1;
+	}
+	srand48(seed);
 	options->add(vsgXchange::all::create());
 	options->add(MstsAceReaderWriter::create());
 	options->add(MstsShapeReaderWriter::create());
@@ -259,6 +348,8 @@ int main(int argc, char** argv)
 	if (scene->children.empty())
 		TSGuiData::instance().loadRouteList();
 	initSim(scene);
+	if (trainList.size() > 0)
+		restoreState();
 
 	auto viewer= vsg::Viewer::create();
 	vsg::ref_ptr<vsg::Window> window(vsg::Window::create(windowTraits));
@@ -296,7 +387,8 @@ int main(int argc, char** argv)
 	viewer->addEventHandler(vsg::WindowResizeHandler::create());
         viewer->addEventHandler(vsgImGui::SendEventsToImGui::create());
 	viewer->addEventHandler(CameraController::create(camera,scene));
-	viewer->addEventHandler(TrainController::create());
+	auto trainController= TrainController::create();
+	viewer->addEventHandler(trainController);
 
         auto commandGraph= vsg::CommandGraph::create(window);
         auto renderGraph= vsg::RenderGraph::create(window);
@@ -321,14 +413,37 @@ int main(int argc, char** argv)
 
 	auto prevTime= std::chrono::system_clock::now();
 	while (viewer->advanceToNextFrame()) {
-		viewer->handleEvents();
-		viewer->update();
-		viewer->recordAndSubmit();
-		viewer->present();
+		{
+			ProfileScope ps("handleEvents");
+			viewer->handleEvents();
+		}
+		{
+			ProfileScope ps("update");
+			viewer->update();
+		}
+		{
+			ProfileScope ps("recordAndSubmit");
+			viewer->recordAndSubmit();
+		}
+		{
+			ProfileScope ps("present");
+			viewer->present();
+		}
 		auto now= std::chrono::system_clock::now();
 		double dt= std::chrono::duration<double,std::chrono::seconds::period>(now-prevTime).count();
 		prevTime= now;
+		if (sessionReplay.isReplaying()) {
+			ReplayFrame frame;
+			if (!sessionReplay.readFrame(frame))
+				break;
+			replayFrame(frame,trainController);
+			dt= frame.dt;
+		}
 		updateSim(dt,scene,viewer);
+		sessionReplay.endFrame(dt);
+		residencyManager.update(mstsRoute);
 	}
+	if (sessionReplay.isReplaying())
+		sessionReplay.printSummary();
 	return 0;
 }